@@ -0,0 +1,187 @@
+#include "Curvature.h"
+#include <math.h>
+#include <algorithm>
+#include "macro.h"
+
+namespace hj
+{
+  // below this many faces or vertices a pass stays on one thread
+  static const int kParallelCurvature = 4096;
+
+  Curvature::Curvature(const TriMesh* mesh)
+    : mesh_(mesh)
+  {
+  }
+
+  void Curvature::resize()
+  {
+    size_t nv = mesh_->n_vertices(), nh = mesh_->n_halfedges();
+    cot_.assign(nh, 0.0f);
+    angle_.assign(nh, 0.0f);
+    area_.assign(nh, 0.0f);
+    mean_normal_.assign(nv, Vec(0, 0, 0));
+    dir_.assign(nv, Vec(0, 0, 0));
+    mean_.assign(nv, 0.0f);
+    gauss_.assign(nv, 0.0f);
+    kmax_.assign(nv, 0.0f);
+    kmin_.assign(nv, 0.0f);
+    face_mark_.assign(mesh_->n_faces(), 0);
+    vertex_mark_.assign(nv, 0);
+  }
+
+  void Curvature::compute()
+  {
+    resize();
+    std::vector<TriMesh::FaceHandle> faces(mesh_->n_faces());
+    for (size_t i = 0; i < faces.size(); i++)
+      faces[i] = TriMesh::FaceHandle((int)i);
+    std::vector<TriMesh::VertexHandle> verts(mesh_->n_vertices());
+    for (size_t i = 0; i < verts.size(); i++)
+      verts[i] = TriMesh::VertexHandle((int)i);
+    computeFaces(faces);
+    computeVertices(verts);
+  }
+
+  void Curvature::update(const std::vector<TriMesh::VertexHandle>& moved)
+  {
+    if (cot_.size() != mesh_->n_halfedges() || mean_.size() != mesh_->n_vertices()) {
+      compute();
+      return;
+    }
+    // the faces around the moved vertices change, and so does every vertex of those faces
+    std::vector<TriMesh::FaceHandle> faces;
+    std::vector<TriMesh::VertexHandle> verts;
+    for (size_t i = 0; i < moved.size(); i++) {
+      for (TriMesh::ConstVertexFaceIter vf_it = mesh_->cvf_iter(moved[i]); vf_it.is_valid(); ++vf_it) {
+        TriMesh::FaceHandle fh = vf_it.handle();
+        if (face_mark_[fh.idx()])
+          continue;
+        face_mark_[fh.idx()] = 1;
+        faces.push_back(fh);
+        for (TriMesh::ConstFaceVertexIter fv_it = mesh_->cfv_iter(fh); fv_it.is_valid(); ++fv_it) {
+          if (!vertex_mark_[fv_it.handle().idx()]) {
+            vertex_mark_[fv_it.handle().idx()] = 1;
+            verts.push_back(fv_it.handle());
+          }
+        }
+      }
+    }
+    computeFaces(faces);
+    computeVertices(verts);
+    for (size_t i = 0; i < faces.size(); i++)
+      face_mark_[faces[i].idx()] = 0;
+    for (size_t i = 0; i < verts.size(); i++)
+      vertex_mark_[verts[i].idx()] = 0;
+  }
+
+  void Curvature::computeFaces(const std::vector<TriMesh::FaceHandle>& faces)
+  {
+    int n = (int)faces.size();
+#pragma omp parallel for if (n > kParallelCurvature)
+    for (int i = 0; i < n; i++) {
+      // corner k is the from vertex of h[k], edge k runs from corner k to corner k + 1
+      TriMesh::HalfedgeHandle h[3];
+      h[0] = mesh_->halfedge_handle(faces[i]);
+      h[1] = mesh_->next_halfedge_handle(h[0]);
+      h[2] = mesh_->next_halfedge_handle(h[1]);
+      Point p[3];
+      for (int k = 0; k < 3; k++)
+        p[k] = mesh_->point(mesh_->from_vertex_handle(h[k]));
+      float cot[3], angle[3], len2[3];
+      int obtuse = -1;
+      for (int k = 0; k < 3; k++) {
+        Vec a = p[(k + 1) % 3] - p[k], b = p[(k + 2) % 3] - p[k];
+        float dot = a | b, cross = (a % b).norm();
+        cot[k] = cross > 0 ? dot / cross : 0.0f;
+        angle[k] = atan2f(cross, dot);
+        len2[k] = a.sqrnorm();
+        if (dot < 0)
+          obtuse = k;
+      }
+      float area = ((p[1] - p[0]) % (p[2] - p[0])).norm() / 2;
+      for (int k = 0; k < 3; k++) {
+        int k1 = (k + 1) % 3, k2 = (k + 2) % 3;
+        int he = h[k].idx();
+        cot_[he] = cot[k2];
+        angle_[he] = angle[k];
+        // mixed Voronoi area: the Voronoi region of the corner, or a fixed share
+        // of the triangle if it is obtuse
+        if (obtuse < 0)
+          area_[he] = (len2[k] * cot[k2] + len2[k2] * cot[k1]) / 8;
+        else
+          area_[he] = (obtuse == k) ? area / 2 : area / 4;
+      }
+    }
+  }
+
+  void Curvature::computeVertices(const std::vector<TriMesh::VertexHandle>& verts)
+  {
+    int n = (int)verts.size();
+#pragma omp parallel for if (n > kParallelCurvature)
+    for (int i = 0; i < n; i++) {
+      TriMesh::VertexHandle vh = verts[i];
+      int v = vh.idx();
+      const Point& pi = mesh_->point(vh);
+      Normal nrm = mesh_->vertexNormal(vh);
+
+      // tangent frame for the curvature tensor
+      Vec t1 = nrm % (fabs(nrm[0]) < 0.9f ? Vec(1, 0, 0) : Vec(0, 1, 0));
+      float t1len = t1.norm();
+      if (t1len > 0)
+        t1 /= t1len;
+      Vec t2 = nrm % t1;
+
+      Vec hn(0, 0, 0);
+      float area = 0, theta = 0, m00 = 0, m01 = 0, m11 = 0;
+      for (TriMesh::ConstVertexOHalfedgeIter voh_it = mesh_->cvoh_iter(vh); voh_it.is_valid(); ++voh_it) {
+        TriMesh::HalfedgeHandle he = voh_it.handle(), opp = mesh_->opposite_halfedge_handle(he);
+        Vec d = mesh_->point(mesh_->to_vertex_handle(he)) - pi;
+        hn += (cot_[he.idx()] + cot_[opp.idx()]) * d;
+        area += area_[he.idx()];
+        theta += angle_[he.idx()];
+
+        // Taubin: normal curvature along the edge, weighted by the area of its corners at v
+        float dn = d | nrm, l2 = d.sqrnorm();
+        Vec t = d - dn * nrm;
+        float tl = t.norm();
+        if (l2 > 0 && tl > 0) {
+          float w = (area_[he.idx()] + area_[mesh_->next_halfedge_handle(opp).idx()]) * 2 * dn / l2;
+          float x = (t | t1) / tl, y = (t | t2) / tl;
+          m00 += w * x * x;
+          m01 += w * x * y;
+          m11 += w * y * y;
+        }
+      }
+      if (area <= 0) {
+        mean_normal_[v] = dir_[v] = Vec(0, 0, 0);
+        mean_[v] = gauss_[v] = kmax_[v] = kmin_[v] = 0;
+        continue;
+      }
+      mean_normal_[v] = hn / (2 * area);
+      float h = mean_normal_[v].norm() / 2;
+      mean_[v] = (mean_normal_[v] | nrm) > 0 ? -h : h;
+      gauss_[v] = ((mesh_->is_boundary(vh) ? kPI : 2 * kPI) - theta) / area;
+      float disc = sqrtf(MAX(mean_[v] * mean_[v] - gauss_[v], 0.0f));
+      kmax_[v] = mean_[v] + disc;
+      kmin_[v] = mean_[v] - disc;
+
+      // the tensor measures curvature towards the normal, so kmax is along the
+      // eigenvector of its smaller eigenvalue
+      float phi = 0.5f * atan2f(2 * m01, m00 - m11) + kPI / 2;
+      dir_[v] = t1len > 0 ? cosf(phi) * t1 + sinf(phi) * t2 : Vec(0, 0, 0);
+    }
+  }
+
+  float Curvature::magnitudePercentile(double fraction) const
+  {
+    size_t n = mean_normal_.size();
+    if (!n)
+      return 0;
+    std::vector<float> lens(n);
+    for (size_t i = 0; i < n; i++)
+      lens[i] = mean_normal_[i].norm();
+    size_t k = MIN((size_t)ceil(fraction * n), n - 1);
+    std::nth_element(lens.begin(), lens.begin() + k, lens.end());
+    return lens[k];
+  }
+}
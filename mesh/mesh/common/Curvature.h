@@ -0,0 +1,77 @@
+#ifndef HJ_Curvature_h__
+#define HJ_Curvature_h__
+
+#include <vector>
+#include "TriMesh.h"
+
+namespace hj
+{
+  /**
+  * Discrete curvature of a triangle mesh (Meyer et al., "Discrete Differential-Geometry
+  * Operators for Triangulated 2-Manifolds"): mean curvature normal from cotangent
+  * weights over the mixed Voronoi area, Gaussian curvature from the angle defect,
+  * principal curvatures from both and the principal directions from Taubin's
+  * curvature tensor. The cotangents, corner angles and mixed areas are cached per
+  * halfedge, so after a deformation only the faces around the moved vertices and the
+  * vertices of those faces are computed again. Both passes run in parallel.
+  */
+  class Curvature
+  {
+  public:
+    /**
+    * @param mesh: mesh with vertex normals, which must outlive the engine.
+    */
+    explicit Curvature(const TriMesh* mesh);
+
+    /**
+    * Computes everything for the whole mesh.
+    */
+    void compute();
+
+    /**
+    * Recomputes after the given vertices moved, once their vertex normals are up to date.
+    */
+    void update(const std::vector<TriMesh::VertexHandle>& moved);
+
+    /** sum of wij * (pj - pi) over 2 * area per vertex, about -2H times the normal. */
+    const std::vector<Vec>& meanCurvatureNormal() const { return mean_normal_; }
+
+    /** signed mean curvature per vertex, positive where the surface bends away from its normal. */
+    const std::vector<float>& meanCurvature() const { return mean_; }
+
+    /** Gaussian curvature per vertex. */
+    const std::vector<float>& gaussianCurvature() const { return gauss_; }
+
+    /** principal curvatures per vertex, kmax >= kmin. */
+    const std::vector<float>& maxCurvature() const { return kmax_; }
+    const std::vector<float>& minCurvature() const { return kmin_; }
+
+    /** unit tangent direction of kmax per vertex; kmin's is normal x this. */
+    const std::vector<Vec>& maxDirection() const { return dir_; }
+
+    /**
+    * @return: the length of the mean curvature normal that the given fraction of
+    * the vertices do not exceed, found by selection instead of sorting.
+    */
+    float magnitudePercentile(double fraction) const;
+
+  private:
+    void computeFaces(const std::vector<TriMesh::FaceHandle>& faces);
+    void computeVertices(const std::vector<TriMesh::VertexHandle>& verts);
+    void resize();
+
+    const TriMesh* mesh_;
+
+    // per halfedge h in a face: cotangent of the angle opposite h, and the angle and
+    // mixed Voronoi area of the corner at h's from vertex; 0 on the boundary
+    std::vector<float> cot_, angle_, area_;
+
+    std::vector<Vec> mean_normal_, dir_;
+    std::vector<float> mean_, gauss_, kmax_, kmin_;
+
+    // scratch marks of update(), all zero between calls
+    std::vector<unsigned char> face_mark_, vertex_mark_;
+  };
+}
+
+#endif // HJ_Curvature_h__
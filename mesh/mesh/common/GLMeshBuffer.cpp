@@ -0,0 +1,275 @@
+#include "GLMeshBuffer.h"
+#include "TriMesh.h"
+#include <string.h>
+
+namespace hj
+{
+  /**
+  * address of data at offset in buffer, or in the client array without buffers
+  */
+  static const GLvoid* Address(GLuint buffer, const void* client, size_t offset)
+  {
+    if (buffer)
+      return (const GLvoid*)offset;
+    return client ? (const GLvoid*)((const char*)client + offset) : NULL;
+  }
+
+  /**
+  * creates a buffer holding size bytes of data
+  */
+  static GLuint CreateBuffer(GLenum target, size_t size, const void* data, GLenum usage)
+  {
+    GLuint id = 0;
+    glGenBuffers(1, &id);
+    glBindBuffer(target, id);
+    glBufferData(target, (GLsizeiptr)size, size ? data : NULL, usage);
+    glBindBuffer(target, 0);
+    return id;
+  }
+
+  GLMeshBuffer::GLMeshBuffer()
+    : mesh_(NULL)
+    , vao_(0)
+    , positions_(0)
+    , normals_(0)
+    , texcoords_(0)
+    , indices_(0)
+    , selection_(0)
+    , oct_normal_attrib_(0)
+    , unorm_texcoord_attrib_(0)
+    , selection_attrib_(0)
+  {
+
+  }
+
+  GLMeshBuffer::~GLMeshBuffer()
+  {
+    Release();
+  }
+
+  void GLMeshBuffer::Create(const TriMesh* mesh, GLuint oct_normal_attrib, GLuint unorm_texcoord_attrib,
+    GLuint selection_attrib)
+  {
+    Release();
+    mesh_ = mesh;
+    oct_normal_attrib_ = oct_normal_attrib;
+    unorm_texcoord_attrib_ = unorm_texcoord_attrib;
+    selection_attrib_ = selection_attrib;
+    size_t nv = mesh->n_vertices();
+    selection_bytes_.assign(nv, 0);
+    if (!GLEW_VERSION_1_5)
+      return;
+
+    // points and normals change with deformation, the rest stays
+    positions_ = CreateBuffer(GL_ARRAY_BUFFER, nv * sizeof(Point), mesh->points(), GL_DYNAMIC_DRAW);
+    if (mesh->has_vertex_normals())
+      normals_ = CreateBuffer(GL_ARRAY_BUFFER, nv * sizeof(Normal), mesh->vertex_normals(), GL_DYNAMIC_DRAW);
+    else if (mesh->octNormals())
+      normals_ = CreateBuffer(GL_ARRAY_BUFFER, nv * 2 * sizeof(short), mesh->octNormals(), GL_DYNAMIC_DRAW);
+    if (mesh->has_vertex_texcoords2D())
+      texcoords_ = CreateBuffer(GL_ARRAY_BUFFER, nv * sizeof(TriMesh::TexCoord2D), mesh->texcoords2D(), GL_STATIC_DRAW);
+    else if (mesh->unormTexCoords())
+      texcoords_ = CreateBuffer(GL_ARRAY_BUFFER, nv * 2 * sizeof(unsigned short), mesh->unormTexCoords(), GL_STATIC_DRAW);
+    const std::vector<unsigned int>& triangles = mesh->triangleIndices();
+    indices_ = CreateBuffer(GL_ELEMENT_ARRAY_BUFFER, triangles.size() * sizeof(unsigned int),
+      triangles.empty() ? NULL : &triangles[0], GL_STATIC_DRAW);
+    selection_ = CreateBuffer(GL_ARRAY_BUFFER, nv, nv ? &selection_bytes_[0] : NULL, GL_DYNAMIC_DRAW);
+
+    if (GLEW_VERSION_3_0 || GLEW_ARB_vertex_array_object)
+    {
+      glGenVertexArrays(1, &vao_);
+      glBindVertexArray(vao_);
+      SetArrays();
+      glBindVertexArray(0);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+  }
+
+  void GLMeshBuffer::Release()
+  {
+    if (vao_)
+      glDeleteVertexArrays(1, &vao_);
+    GLuint buffers[5] = { positions_, normals_, texcoords_, indices_, selection_ };
+    for (int i = 0; i < 5; i++)
+    {
+      if (buffers[i])
+        glDeleteBuffers(1, &buffers[i]);
+    }
+    vao_ = positions_ = normals_ = texcoords_ = indices_ = selection_ = 0;
+    selection_bytes_.clear();
+    selection_first_.clear();
+    selection_count_.clear();
+    mesh_ = NULL;
+  }
+
+  void GLMeshBuffer::Update(int first, int last)
+  {
+    if (!positions_ || first >= last)
+      return;
+    glBindBuffer(GL_ARRAY_BUFFER, positions_);
+    glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Point), (last - first) * sizeof(Point),
+      mesh_->points() + first);
+    if (normals_ && mesh_->has_vertex_normals())
+    {
+      glBindBuffer(GL_ARRAY_BUFFER, normals_);
+      glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(Normal), (last - first) * sizeof(Normal),
+        mesh_->vertex_normals() + first);
+    }
+    else if (normals_)
+    {
+      glBindBuffer(GL_ARRAY_BUFFER, normals_);
+      glBufferSubData(GL_ARRAY_BUFFER, first * 2 * sizeof(short), (last - first) * 2 * sizeof(short),
+        mesh_->octNormals() + 2 * first);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  void GLMeshBuffer::SetSelection(const std::vector<int>& first, const std::vector<int>& count)
+  {
+    if (first == selection_first_ && count == selection_count_)
+      return;
+    selection_first_ = first;
+    selection_count_ = count;
+    if (selection_bytes_.empty())
+      return;
+
+    const std::vector<unsigned int>& triangles = mesh_->triangleIndices();
+    memset(&selection_bytes_[0], 0, selection_bytes_.size());
+    for (size_t i = 0; i < first.size(); i++)
+    {
+      const unsigned int* t = &triangles[3 * first[i]];
+      for (int k = 0; k < 3 * count[i]; k++)
+        selection_bytes_[t[k]] = 255;
+    }
+    if (selection_)
+    {
+      glBindBuffer(GL_ARRAY_BUFFER, selection_);
+      glBufferSubData(GL_ARRAY_BUFFER, 0, (GLsizeiptr)selection_bytes_.size(), &selection_bytes_[0]);
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+  }
+
+  void GLMeshBuffer::SetArrays()
+  {
+    bool buffers = positions_ != 0;
+    if (buffers)
+      glBindBuffer(GL_ARRAY_BUFFER, positions_);
+    glVertexPointer(3, GL_FLOAT, 0, Address(positions_, mesh_->points(), 0));
+    glEnableClientState(GL_VERTEX_ARRAY);
+
+    if (buffers && normals_)
+      glBindBuffer(GL_ARRAY_BUFFER, normals_);
+    if (mesh_->has_vertex_normals())
+    {
+      glNormalPointer(GL_FLOAT, 0, Address(normals_, mesh_->vertex_normals(), 0));
+      glEnableClientState(GL_NORMAL_ARRAY);
+    }
+    else if (mesh_->octNormals() && GLEW_VERSION_2_0)
+    {
+      glVertexAttribPointer(oct_normal_attrib_, 2, GL_SHORT, GL_TRUE, 0,
+        Address(normals_, mesh_->octNormals(), 0));
+      glEnableVertexAttribArray(oct_normal_attrib_);
+    }
+
+    // texture coordinates are enabled by Bind()
+    if (buffers && texcoords_)
+      glBindBuffer(GL_ARRAY_BUFFER, texcoords_);
+    if (mesh_->has_vertex_texcoords2D())
+      glTexCoordPointer(2, GL_FLOAT, 0, Address(texcoords_, mesh_->texcoords2D(), 0));
+    else if (mesh_->unormTexCoords() && GLEW_VERSION_2_0)
+      glVertexAttribPointer(unorm_texcoord_attrib_, 2, GL_UNSIGNED_SHORT, GL_TRUE, 0,
+        Address(texcoords_, mesh_->unormTexCoords(), 0));
+
+    if (GLEW_VERSION_2_0 && !selection_bytes_.empty())
+    {
+      if (buffers)
+        glBindBuffer(GL_ARRAY_BUFFER, selection_);
+      glVertexAttribPointer(selection_attrib_, 1, GL_UNSIGNED_BYTE, GL_TRUE, 0,
+        Address(selection_, &selection_bytes_[0], 0));
+      glEnableVertexAttribArray(selection_attrib_);
+    }
+
+    if (buffers)
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices_);
+  }
+
+  void GLMeshBuffer::Bind(bool textured)
+  {
+    if (vao_)
+      glBindVertexArray(vao_);
+    else
+      SetArrays();
+    if (mesh_->has_vertex_texcoords2D())
+    {
+      if (textured)
+        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+      else
+        glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    }
+    else if (mesh_->unormTexCoords() && GLEW_VERSION_2_0)
+    {
+      if (textured)
+        glEnableVertexAttribArray(unorm_texcoord_attrib_);
+      else
+        glDisableVertexAttribArray(unorm_texcoord_attrib_);
+    }
+  }
+
+  void GLMeshBuffer::Unbind()
+  {
+    if (vao_)
+    {
+      glBindVertexArray(0);
+    }
+    else
+    {
+      glDisableClientState(GL_VERTEX_ARRAY);
+      glDisableClientState(GL_NORMAL_ARRAY);
+      glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+      if (GLEW_VERSION_2_0)
+      {
+        glDisableVertexAttribArray(oct_normal_attrib_);
+        glDisableVertexAttribArray(unorm_texcoord_attrib_);
+        glDisableVertexAttribArray(selection_attrib_);
+      }
+    }
+    if (positions_)
+    {
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
+      glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    }
+  }
+
+  void GLMeshBuffer::Draw()
+  {
+    const std::vector<unsigned int>& triangles = mesh_->triangleIndices();
+    if (!triangles.empty())
+      glDrawElements(GL_TRIANGLES, (GLsizei)triangles.size(), GL_UNSIGNED_INT,
+        Address(indices_, &triangles[0], 0));
+  }
+
+  void GLMeshBuffer::DrawRanges(const std::vector<int>& first, const std::vector<int>& count)
+  {
+    const std::vector<unsigned int>& triangles = mesh_->triangleIndices();
+    if (first.empty() || triangles.empty())
+      return;
+    range_offsets_.resize(first.size());
+    range_counts_.resize(first.size());
+    for (size_t i = 0; i < first.size(); i++)
+    {
+      range_offsets_[i] = Address(indices_, &triangles[0], 3 * first[i] * sizeof(unsigned int));
+      range_counts_[i] = 3 * count[i];
+    }
+    if (GLEW_VERSION_1_4)
+    {
+      glMultiDrawElements(GL_TRIANGLES, &range_counts_[0], GL_UNSIGNED_INT,
+        &range_offsets_[0], (GLsizei)first.size());
+    }
+    else
+    {
+      for (size_t i = 0; i < first.size(); i++)
+        glDrawElements(GL_TRIANGLES, range_counts_[i], GL_UNSIGNED_INT, range_offsets_[i]);
+    }
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef HJ_GLMeshBuffer_h__
+#define HJ_GLMeshBuffer_h__
+
+#include <GL/glew.h>
+#include <vector>
+
+namespace hj
+{
+  class TriMesh;
+
+  /**
+  * GPU copies of the vertex attributes and triangle indices of a TriMesh, kept in
+  * buffer objects between frames, with the array setup recorded once in a vertex
+  * array object where supported. Drawing the mesh several times a frame copies
+  * nothing from client memory, and after a deformation only the changed range of
+  * the points and normals is uploaded. Without buffer objects (before OpenGL 1.5)
+  * the same calls draw from the client arrays of the mesh.
+  * A byte per vertex flags the vertices of selected faces for shaders that
+  * highlight the selection in the same pass as the rest of the mesh.
+  */
+  class GLMeshBuffer
+  {
+  public:
+    GLMeshBuffer();
+
+    ~GLMeshBuffer();
+
+    /**
+    * Uploads the points, normals, texture coordinates and indices of mesh, which
+    * must outlive the buffers.
+    * @param oct_normal_attrib: generic attribute of quantized normals, if kept.
+    * @param unorm_texcoord_attrib: generic attribute of quantized texture coordinates, if kept.
+    * @param selection_attrib: generic attribute of the selection flags, 1 for selected.
+    */
+    void Create(const TriMesh* mesh, GLuint oct_normal_attrib, GLuint unorm_texcoord_attrib,
+      GLuint selection_attrib);
+
+    void Release();
+
+    /**
+    * Uploads the points and normals of vertices [first, last).
+    */
+    void Update(int first, int last);
+
+    /**
+    * Flags the vertices of the faces [first[i], first[i] + count[i]) as selected and
+    * the others not, uploading the flags only if the ranges changed.
+    */
+    void SetSelection(const std::vector<int>& first, const std::vector<int>& count);
+
+    /**
+    * Binds the arrays for drawing, the texture coordinates only if textured.
+    */
+    void Bind(bool textured);
+
+    void Unbind();
+
+    /** draws all faces, between Bind() and Unbind(). */
+    void Draw();
+
+    /**
+    * Draws the faces [first[i], first[i] + count[i]) out of the same index buffer,
+    * with one call.
+    */
+    void DrawRanges(const std::vector<int>& first, const std::vector<int>& count);
+
+  private:
+    /** array pointers and enables, recorded in vao_ if there is one. */
+    void SetArrays();
+
+    const TriMesh* mesh_;
+    GLuint vao_;
+    GLuint positions_, normals_, texcoords_, indices_, selection_;
+    GLuint oct_normal_attrib_, unorm_texcoord_attrib_, selection_attrib_;
+
+    /** selection flag per vertex, and the face ranges it was built from. */
+    std::vector<unsigned char> selection_bytes_;
+    std::vector<int> selection_first_, selection_count_;
+
+    /** index offsets and counts of DrawRanges(). */
+    std::vector<const GLvoid*> range_offsets_;
+    std::vector<GLsizei> range_counts_;
+  };
+}
+
+#endif // HJ_GLMeshBuffer_h__
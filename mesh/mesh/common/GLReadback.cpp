@@ -0,0 +1,164 @@
+#include "GLReadback.h"
+#include "GLFramebuffer.h"
+#include "GLTexture.h"
+#include <string.h>
+#include <assert.h>
+
+namespace hj
+{
+  GLReadback::GLReadback()
+    : newest_(-1)
+    , mapped_(-1)
+    , fbo_(NULL)
+    , attachment_(GL_COLOR_ATTACHMENT0)
+    , format_(GL_RGB)
+    , type_(GL_UNSIGNED_BYTE)
+    , size_(0)
+  {
+
+  }
+
+  GLReadback::~GLReadback()
+  {
+    Release();
+  }
+
+  bool GLReadback::IsSupported()
+  {
+    return (GLEW_VERSION_2_1 || GLEW_ARB_pixel_buffer_object) &&
+      (GLEW_VERSION_3_2 || GLEW_ARB_sync);
+  }
+
+  bool GLReadback::Create(GLFramebuffer* fbo, GLenum attachment, int count)
+  {
+    Release();
+    GLTexture* texture = fbo->GetTexture2D(attachment);
+    if (!IsSupported() || !texture || count < 1)
+      return false;
+
+    fbo_ = fbo;
+    attachment_ = attachment;
+    format_ = texture->GetFormat();
+    type_ = texture->GetDataType();
+    size_ = (size_t)fbo->GetWidth() * fbo->GetHeight() * texture->GetBpp();
+    buffers_.resize(count);
+    fences_.assign(count, (GLsync)NULL);
+    glGenBuffers(count, &buffers_[0]);
+    for (int i = 0; i < count; i++)
+    {
+      glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers_[i]);
+      glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)size_, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+  }
+
+  void GLReadback::Release()
+  {
+    Unmap();
+    for (size_t i = 0; i < fences_.size(); i++)
+    {
+      if (fences_[i])
+        glDeleteSync(fences_[i]);
+    }
+    if (!buffers_.empty())
+      glDeleteBuffers((GLsizei)buffers_.size(), &buffers_[0]);
+    buffers_.clear();
+    fences_.clear();
+    newest_ = -1;
+    fbo_ = NULL;
+    size_ = 0;
+  }
+
+  void GLReadback::Queue()
+  {
+    if (buffers_.empty())
+      return;
+    Unmap();
+    int slot = (newest_ + 1) % (int)buffers_.size();
+    if (fences_[slot])
+      glDeleteSync(fences_[slot]);
+
+    fbo_->Bind();
+    glReadBuffer(attachment_);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers_[slot]);
+    glReadPixels(0, 0, fbo_->GetWidth(), fbo_->GetHeight(), format_, type_, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    fbo_->Unbind();
+
+    fences_[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    newest_ = slot;
+  }
+
+  bool GLReadback::IsComplete(int slot, bool wait)
+  {
+    if (!fences_[slot])
+      return false;
+    // a second at most, for a frame that is waited for
+    GLuint64 timeout = wait ? 1000000000 : 0;
+    GLenum status = glClientWaitSync(fences_[slot], GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+    return status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+  }
+
+  const GLubyte* GLReadback::Map()
+  {
+    if (newest_ < 0)
+      return NULL;
+    Unmap();
+
+    // newest first; fences signal in order, so the first completed one is the newest
+    int count = (int)buffers_.size();
+    int slot = -1;
+    for (int i = 0; i < count && slot < 0; i++)
+    {
+      int s = (newest_ - i + count) % count;
+      if (IsComplete(s, false))
+        slot = s;
+    }
+    // none yet: the first frame, or the GPU is a whole ring behind
+    for (int i = count - 1; i >= 0 && slot < 0; i--)
+    {
+      int s = (newest_ - i + count) % count;
+      if (fences_[s] && IsComplete(s, true))
+        slot = s;
+    }
+    if (slot < 0)
+      return NULL;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers_[slot]);
+    const GLubyte* pixels = (const GLubyte*)glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!pixels)
+      return NULL;
+    mapped_ = slot;
+    return pixels;
+  }
+
+  void GLReadback::Unmap()
+  {
+    if (mapped_ < 0)
+      return;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers_[mapped_]);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    mapped_ = -1;
+  }
+
+  bool GLReadback::Read(GLubyte* pixels, size_t numBytesAllocated)
+  {
+    if (numBytesAllocated < size_)
+    {
+      assert(0);
+      return false;
+    }
+    const GLubyte* mapped = Map();
+    if (!mapped)
+      return false;
+    memcpy(pixels, mapped, size_);
+    Unmap();
+    return true;
+  }
+}
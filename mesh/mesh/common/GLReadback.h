@@ -0,0 +1,82 @@
+#ifndef HJ_GLReadback_h__
+#define HJ_GLReadback_h__
+
+#include <GL/glew.h>
+#include <vector>
+
+namespace hj
+{
+  class GLFramebuffer;
+
+  /**
+  * Reads frames back from a framebuffer through a ring of pixel buffer objects.
+  * Queue() starts the copy of a frame into the next buffer and sets a fence after
+  * it, so the CPU goes on while the GPU finishes drawing and copying. Map() hands
+  * out the newest frame whose fence has signaled, without waiting for the frames
+  * queued after it; the pixels can be read through the mapped pointer in place.
+  * Needs pixel buffer objects and sync objects, see IsSupported().
+  */
+  class GLReadback
+  {
+  public:
+    GLReadback();
+
+    ~GLReadback();
+
+    /** @return: true if the context has pixel buffer objects and fences. */
+    static bool IsSupported();
+
+    /**
+    * Creates count buffers for frames of the color texture at attachment of fbo,
+    * read in the format and type of the texture. fbo must outlive the buffers.
+    */
+    bool Create(GLFramebuffer* fbo, GLenum attachment, int count);
+
+    void Release();
+
+    /** bytes of a frame. */
+    size_t GetSize() const { return size_; }
+
+    /**
+    * Starts reading the current contents of the attachment into the next buffer of
+    * the ring, taking the place of the oldest frame. Unmaps a mapped frame first.
+    */
+    void Queue();
+
+    /**
+    * Maps the newest completed frame for reading, until Unmap() or Queue(). If no
+    * frame completed, which happens for the first one or when the GPU is a whole
+    * ring behind, the oldest one queued is waited for.
+    * @return: the pixels, NULL if no frame was queued or mapping failed.
+    */
+    const GLubyte* Map();
+
+    void Unmap();
+
+    /**
+    * Copies the newest completed frame to pixels, see Map().
+    * @return: false if there is no frame or the buffer is too small.
+    */
+    bool Read(GLubyte* pixels, size_t numBytesAllocated);
+
+  private:
+    /** @return: true if the fence of slot signaled, waiting for it if wait. */
+    bool IsComplete(int slot, bool wait);
+
+    std::vector<GLuint> buffers_;
+    std::vector<GLsync> fences_;
+
+    /** slot queued last, -1 before the first frame. */
+    int newest_;
+
+    /** slot mapped, -1 if none. */
+    int mapped_;
+
+    GLFramebuffer* fbo_;
+    GLenum attachment_;
+    GLenum format_, type_;
+    size_t size_;
+  };
+}
+
+#endif // HJ_GLReadback_h__
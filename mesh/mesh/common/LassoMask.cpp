@@ -0,0 +1,104 @@
+#include "LassoMask.h"
+#include <string.h>
+#include <algorithm>
+#include "macro.h"
+
+namespace hj
+{
+  /**
+  * rows [r0, r1) of a mask starting at window row y0 whose centers the edge ab crosses
+  */
+  static void EdgeRows(const glm::vec2& a, const glm::vec2& b, int y0, int height, int& r0, int& r1)
+  {
+    float ymin = MIN(a.y, b.y), ymax = MAX(a.y, b.y);
+    r0 = MAX((int)ceilf(ymin - y0 - 0.5f), 0);
+    r1 = MIN((int)ceilf(ymax - y0 - 0.5f), height);
+  }
+
+  LassoMask::LassoMask()
+    : x0_(0), y0_(0), width_(0), height_(0)
+  {
+
+  }
+
+  void LassoMask::build(const std::vector<glm::vec2>& polygon)
+  {
+    mask_.clear();
+    width_ = height_ = 0;
+    int n = (int)polygon.size();
+    if (n < 3)
+      return;
+
+    glm::vec2 lo = polygon[0], hi = polygon[0];
+    for (int i = 1; i < n; i++) {
+      lo = glm::min(lo, polygon[i]);
+      hi = glm::max(hi, polygon[i]);
+    }
+    x0_ = (int)floorf(lo.x);
+    y0_ = (int)floorf(lo.y);
+    width_ = (int)floorf(hi.x) - x0_ + 1;
+    height_ = (int)floorf(hi.y) - y0_ + 1;
+    mask_.assign((size_t)width_ * height_, 0);
+
+    // every edge crosses the rows whose center y + 0.5 is in [ymin, ymax); the
+    // crossings are bucketed by row
+    std::vector<int> start(height_ + 1, 0);
+    for (int i = 0; i < n; i++) {
+      int r0, r1;
+      EdgeRows(polygon[i], polygon[(i + 1) % n], y0_, height_, r0, r1);
+      for (int r = r0; r < r1; r++)
+        start[r + 1]++;
+    }
+    for (int r = 0; r < height_; r++)
+      start[r + 1] += start[r];
+    std::vector<float> xs(start[height_]);
+    std::vector<int> fill(start.begin(), start.end() - 1);
+    for (int i = 0; i < n; i++) {
+      glm::vec2 a = polygon[i], b = polygon[(i + 1) % n];
+      int r0, r1;
+      EdgeRows(a, b, y0_, height_, r0, r1);
+      float slope = r0 < r1 ? (b.x - a.x) / (b.y - a.y) : 0.0f;
+      for (int r = r0; r < r1; r++)
+        xs[fill[r]++] = a.x + (y0_ + r + 0.5f - a.y) * slope;
+    }
+
+    // pixels whose center is between the 1st and 2nd crossing, the 3rd and 4th...
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int r = 0; r < height_; r++) {
+      int count = start[r + 1] - start[r];
+      if (count < 2)
+        continue;
+      float* x = &xs[start[r]];
+      std::sort(x, x + count);
+      unsigned char* row = &mask_[(size_t)r * width_];
+      for (int k = 0; k + 1 < count; k += 2) {
+        int c0 = MAX((int)ceilf(x[k] - x0_ - 0.5f), 0);
+        int c1 = MIN((int)ceilf(x[k + 1] - x0_ - 0.5f), width_);
+        if (c0 < c1)
+          memset(row + c0, 1, c1 - c0);
+      }
+    }
+  }
+
+  void LassoMask::select(const ScreenSpace& screen, SelectionSet& inside) const
+  {
+    const SelectionSet& front = screen.front();
+    inside.resize(screen.size());
+    inside.clear();
+    if (mask_.empty())
+      return;
+    const float* x = screen.x();
+    const float* y = screen.y();
+    int nw = inside.wordCount();
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int w = 0; w < nw; w++) {
+      uint32_t bits = front.word(w), in = 0;
+      for (int k = 0; k < 32 && (bits >> k) != 0; k++) {
+        int i = 32 * w + k;
+        if (((bits >> k) & 1) && contains(x[i], y[i]))
+          in |= 1u << k;
+      }
+      inside.setWord(w, in);
+    }
+  }
+}
@@ -0,0 +1,55 @@
+#ifndef HJ_LassoMask_h__
+#define HJ_LassoMask_h__
+
+#include <math.h>
+#include <vector>
+#include "common/glmext.h"
+#include "SelectionSet.h"
+#include "ScreenSpace.h"
+
+namespace hj
+{
+  /**
+  * A lasso rasterized once into a coverage mask over its bounding box, one byte per
+  * pixel, filled along scanlines with the even-odd rule. A point is inside if the
+  * center of its pixel is, so a lookup replaces the walk over the polygon edges
+  * of ScanLine::PointInPolygon and the cost of a test does not grow with the lasso.
+  */
+  class LassoMask
+  {
+  public:
+    LassoMask();
+
+    /**
+    * Rasterizes the polygon.
+    * @param polygon: corners in window coordinates.
+    */
+    void build(const std::vector<glm::vec2>& polygon);
+
+    bool empty() const { return mask_.empty(); }
+
+    /**
+    * @return: true if the window point (x, y) is inside the lasso.
+    */
+    bool contains(float x, float y) const
+    {
+      int c = (int)floorf(x) - x0_;
+      int r = (int)floorf(y) - y0_;
+      return c >= 0 && c < width_ && r >= 0 && r < height_ && mask_[r * width_ + c] != 0;
+    }
+
+    /**
+    * The points whose window position is inside the lasso. The words of the set are
+    * filled in parallel, from the projected positions.
+    * @param inside: receives the indices of the points inside.
+    */
+    void select(const ScreenSpace& screen, SelectionSet& inside) const;
+
+  private:
+    std::vector<unsigned char> mask_;
+    int x0_, y0_;          // window pixel of the first mask byte
+    int width_, height_;
+  };
+}
+
+#endif // HJ_LassoMask_h__
@@ -0,0 +1,103 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace hj
+{
+  MappedFile::MappedFile()
+    : data_(nullptr)
+    , size_(0)
+#ifdef _WIN32
+    , file_(INVALID_HANDLE_VALUE)
+    , mapping_(NULL)
+#endif
+  {
+  }
+
+  MappedFile::~MappedFile()
+  {
+    Close();
+  }
+
+#ifdef _WIN32
+
+  bool MappedFile::Open(const std::string& filename)
+  {
+    Close();
+    file_ = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+      OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file_ == INVALID_HANDLE_VALUE)
+      return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file_, &size) || size.QuadPart == 0
+      || (unsigned long long)size.QuadPart > (size_t)-1) {
+      Close();
+      return false;
+    }
+    mapping_ = CreateFileMappingA(file_, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping_) {
+      Close();
+      return false;
+    }
+    data_ = (const char*)MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+    if (!data_) {
+      Close();
+      return false;
+    }
+    size_ = (size_t)size.QuadPart;
+    return true;
+  }
+
+  void MappedFile::Close()
+  {
+    if (data_)
+      UnmapViewOfFile(data_);
+    if (mapping_)
+      CloseHandle(mapping_);
+    if (file_ != INVALID_HANDLE_VALUE)
+      CloseHandle(file_);
+    data_ = nullptr;
+    size_ = 0;
+    mapping_ = NULL;
+    file_ = INVALID_HANDLE_VALUE;
+  }
+
+#else
+
+  bool MappedFile::Open(const std::string& filename)
+  {
+    Close();
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+      return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+      close(fd);
+      return false;
+    }
+    void* p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED)
+      return false;
+    data_ = (const char*)p;
+    size_ = (size_t)st.st_size;
+    return true;
+  }
+
+  void MappedFile::Close()
+  {
+    if (data_)
+      munmap((void*)data_, size_);
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+#endif
+}
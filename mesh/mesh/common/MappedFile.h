@@ -0,0 +1,50 @@
+#ifndef HJ_MappedFile_h__
+#define HJ_MappedFile_h__
+
+#include <string>
+
+namespace hj
+{
+  /**
+  * Read only memory mapping of a whole file. The data are paged in by the OS
+  * on first access, so opening is cheap even for very large files and the
+  * pages are shared with the file cache instead of being copied.
+  */
+  class MappedFile
+  {
+  public:
+    MappedFile();
+    ~MappedFile();
+
+    /**
+    * Maps the file, any previous mapping is closed first.
+    * @param filename: path of the file.
+    * @return: True if successful, false if the file cannot be opened or is empty.
+    */
+    bool Open(const std::string& filename);
+
+    /**
+    * Unmaps the file, the pointer returned by GetData() is invalid afterwards.
+    */
+    void Close();
+
+    bool IsOpen() const { return data_ != nullptr; }
+
+    const char* GetData() const { return data_; }
+
+    size_t GetSize() const { return size_; }
+
+  private:
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    const char* data_;
+    size_t size_;
+#ifdef _WIN32
+    void* file_;
+    void* mapping_;
+#endif
+  };
+}
+
+#endif // HJ_MappedFile_h__
@@ -0,0 +1,690 @@
+#include "MeshBVH.h"
+#include <math.h>
+#include <algorithm>
+#include "macro.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define HJ_BVH_SSE
+#endif
+
+namespace hj
+{
+  // centroid bins per axis of a SAH split
+  static const int kBins = 16;
+
+  // deeper nodes are split at the object median, which bounds the depth of the tree
+  static const int kMaxSahDepth = 48;
+
+  // traversal stack, deeper than any tree build() makes
+  static const int kStackSize = 128;
+
+  static inline void EmptyBox(float lo[3], float hi[3])
+  {
+    lo[0] = lo[1] = lo[2] = FLT_MAX;
+    hi[0] = hi[1] = hi[2] = -FLT_MAX;
+  }
+
+  static inline void GrowBox(float lo[3], float hi[3], const float* p)
+  {
+    for (int c = 0; c < 3; c++) {
+      lo[c] = MIN(lo[c], p[c]);
+      hi[c] = MAX(hi[c], p[c]);
+    }
+  }
+
+  static inline void GrowBox(float lo[3], float hi[3], const float* blo, const float* bhi)
+  {
+    for (int c = 0; c < 3; c++) {
+      lo[c] = MIN(lo[c], blo[c]);
+      hi[c] = MAX(hi[c], bhi[c]);
+    }
+  }
+
+  /**
+  * half the surface area of a box, the SAH only compares them
+  */
+  static inline float HalfArea(const float lo[3], const float hi[3])
+  {
+    float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+    return dx * dy + dy * dz + dz * dx;
+  }
+
+  static inline int BinOf(float c, float lo, float scale)
+  {
+    int b = (int)((c - lo) * scale);
+    return b < kBins ? b : kBins - 1;
+  }
+
+  struct BinBelow
+  {
+    const float* centroids;
+    int axis, split;
+    float lo, scale;
+    bool operator()(int f) const { return BinOf(centroids[3 * f + axis], lo, scale) < split; }
+  };
+
+  struct CentroidLess
+  {
+    const float* centroids;
+    int axis;
+    bool operator()(int a, int b) const { return centroids[3 * a + axis] < centroids[3 * b + axis]; }
+  };
+
+  MeshBVH::MeshBVH()
+    : mesh_(NULL)
+  {
+  }
+
+  void MeshBVH::clear()
+  {
+    mesh_ = NULL;
+    nodes_.clear();
+    faces_.clear();
+    tris_.clear();
+  }
+
+  void MeshBVH::build(const TriMesh* mesh)
+  {
+    clear();
+    mesh_ = mesh;
+    const std::vector<unsigned int>& tri = mesh->triangleIndices();
+    int nf = (int)(tri.size() / 3);
+    if (!nf)
+      return;
+
+    const float* p = (const float*)mesh->points();
+    std::vector<Box> boxes(nf);
+    std::vector<float> centroids(3 * (size_t)nf);
+#pragma omp parallel for
+    for (int f = 0; f < nf; f++) {
+      Box& b = boxes[f];
+      EmptyBox(b.lo, b.hi);
+      for (int k = 0; k < 3; k++)
+        GrowBox(b.lo, b.hi, p + 3 * (size_t)tri[3 * f + k]);
+      for (int c = 0; c < 3; c++)
+        centroids[3 * f + c] = (b.lo[c] + b.hi[c]) / 2;
+    }
+
+    std::vector<int> order(nf);
+    for (int f = 0; f < nf; f++)
+      order[f] = f;
+    nodes_.reserve(nf);
+    buildNode(order, boxes, centroids, 0, nf, 0);
+
+    faces_.swap(order);
+    tris_.resize(3 * (size_t)nf);
+    for (int i = 0; i < nf; i++) {
+      for (int k = 0; k < 3; k++)
+        tris_[3 * i + k] = tri[3 * faces_[i] + k];
+    }
+  }
+
+  int MeshBVH::buildNode(std::vector<int>& order, const std::vector<Box>& boxes,
+    const std::vector<float>& centroids, int begin, int end, int depth)
+  {
+    int index = (int)nodes_.size();
+    nodes_.push_back(Node());
+    float lo[3], hi[3], clo[3], chi[3];
+    EmptyBox(lo, hi);
+    EmptyBox(clo, chi);
+    for (int i = begin; i < end; i++) {
+      const Box& b = boxes[order[i]];
+      GrowBox(lo, hi, b.lo, b.hi);
+      GrowBox(clo, chi, &centroids[3 * order[i]]);
+    }
+    for (int c = 0; c < 3; c++) {
+      nodes_[index].lo[c] = lo[c];
+      nodes_[index].hi[c] = hi[c];
+    }
+    int count = end - begin;
+    if (count <= kMaxLeafFaces) {
+      nodes_[index].index = begin;
+      nodes_[index].count = count;
+      return index;
+    }
+
+    // the split between centroid bins with the least area weighted face count
+    int axis = -1, split = 0;
+    float best = FLT_MAX;
+    for (int a = 0; a < 3 && depth < kMaxSahDepth; a++) {
+      float extent = chi[a] - clo[a];
+      if (extent <= 0)
+        continue;
+      float scale = kBins / extent;
+      int bin_count[kBins];
+      float bin_lo[kBins][3], bin_hi[kBins][3];
+      for (int b = 0; b < kBins; b++) {
+        bin_count[b] = 0;
+        EmptyBox(bin_lo[b], bin_hi[b]);
+      }
+      for (int i = begin; i < end; i++) {
+        int b = BinOf(centroids[3 * order[i] + a], clo[a], scale);
+        bin_count[b]++;
+        GrowBox(bin_lo[b], bin_hi[b], boxes[order[i]].lo, boxes[order[i]].hi);
+      }
+      float right_area[kBins], rlo[3], rhi[3];
+      int right_count[kBins], n = 0;
+      EmptyBox(rlo, rhi);
+      for (int b = kBins - 1; b > 0; b--) {
+        GrowBox(rlo, rhi, bin_lo[b], bin_hi[b]);
+        n += bin_count[b];
+        right_count[b] = n;
+        right_area[b] = n ? HalfArea(rlo, rhi) : 0;
+      }
+      float llo[3], lhi[3];
+      EmptyBox(llo, lhi);
+      n = 0;
+      for (int b = 0; b < kBins - 1; b++) {
+        GrowBox(llo, lhi, bin_lo[b], bin_hi[b]);
+        n += bin_count[b];
+        if (!n || !right_count[b + 1])
+          continue;
+        float cost = HalfArea(llo, lhi) * n + right_area[b + 1] * right_count[b + 1];
+        if (cost < best) {
+          best = cost;
+          axis = a;
+          split = b + 1;
+        }
+      }
+    }
+
+    int mid = begin;
+    if (axis >= 0) {
+      BinBelow below = { &centroids[0], axis, split, clo[axis], kBins / (chi[axis] - clo[axis]) };
+      mid = (int)(std::partition(order.begin() + begin, order.begin() + end, below) - order.begin());
+    }
+    if (mid == begin || mid == end) {
+      // no split separates the centroids (or the tree is deep already): halve the
+      // faces along the longest extent of the centroids
+      axis = 0;
+      for (int c = 1; c < 3; c++) {
+        if (chi[c] - clo[c] > chi[axis] - clo[axis])
+          axis = c;
+      }
+      mid = begin + count / 2;
+      CentroidLess less = { &centroids[0], axis };
+      std::nth_element(order.begin() + begin, order.begin() + mid, order.begin() + end, less);
+    }
+    buildNode(order, boxes, centroids, begin, mid, depth + 1);
+    int right = buildNode(order, boxes, centroids, mid, end, depth + 1);
+    nodes_[index].index = right;
+    nodes_[index].count = 0;
+    return index;
+  }
+
+  void MeshBVH::leafBox(const Node& node, float lo[3], float hi[3]) const
+  {
+    const float* p = (const float*)mesh_->points();
+    EmptyBox(lo, hi);
+    for (int i = 3 * node.index; i < 3 * (node.index + node.count); i++)
+      GrowBox(lo, hi, p + 3 * (size_t)tris_[i]);
+  }
+
+  void MeshBVH::refit()
+  {
+    int n = (int)nodes_.size();
+#pragma omp parallel for
+    for (int i = 0; i < n; i++) {
+      if (nodes_[i].count)
+        leafBox(nodes_[i], nodes_[i].lo, nodes_[i].hi);
+    }
+    // children come after their parent, so a backward pass meets them first
+    for (int i = n - 1; i >= 0; i--) {
+      Node& node = nodes_[i];
+      if (node.count)
+        continue;
+      const Node& l = nodes_[i + 1];
+      const Node& r = nodes_[node.index];
+      for (int c = 0; c < 3; c++) {
+        node.lo[c] = MIN(l.lo[c], r.lo[c]);
+        node.hi[c] = MAX(l.hi[c], r.hi[c]);
+      }
+    }
+  }
+
+  //----------------------------------------------------------------- rays
+
+  /**
+  * 1 / d, with zero made tiny so that the slab test needs no special case
+  */
+  static inline float SafeInverse(float d)
+  {
+    if (fabsf(d) < 1e-30f)
+      d = d < 0 ? -1e-30f : 1e-30f;
+    return 1.0f / d;
+  }
+
+  static inline bool BoxHit(const float lo[3], const float hi[3], const float o[3],
+    const float inv[3], float tmax, float* tnear)
+  {
+    float t0 = 0, t1 = tmax;
+    for (int c = 0; c < 3; c++) {
+      float a = (lo[c] - o[c]) * inv[c], b = (hi[c] - o[c]) * inv[c];
+      t0 = MAX(t0, MIN(a, b));
+      t1 = MIN(t1, MAX(a, b));
+    }
+    *tnear = t0;
+    return t0 <= t1;
+  }
+
+  /**
+  * Moller-Trumbore ray triangle test, for t in (0, tmax)
+  */
+  static inline bool TriangleHit(const float o[3], const float d[3], const float* a,
+    const float* b, const float* c, float tmax, float* t, float* u, float* v)
+  {
+    float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    float pv[3] = { d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0] };
+    float det = e1[0] * pv[0] + e1[1] * pv[1] + e1[2] * pv[2];
+    if (det == 0)
+      return false;
+    float inv = 1.0f / det;
+    float tv[3] = { o[0] - a[0], o[1] - a[1], o[2] - a[2] };
+    float uu = (tv[0] * pv[0] + tv[1] * pv[1] + tv[2] * pv[2]) * inv;
+    if (uu < 0 || uu > 1)
+      return false;
+    float qv[3] = { tv[1] * e1[2] - tv[2] * e1[1], tv[2] * e1[0] - tv[0] * e1[2], tv[0] * e1[1] - tv[1] * e1[0] };
+    float vv = (d[0] * qv[0] + d[1] * qv[1] + d[2] * qv[2]) * inv;
+    if (vv < 0 || uu + vv > 1)
+      return false;
+    float tt = (e2[0] * qv[0] + e2[1] * qv[1] + e2[2] * qv[2]) * inv;
+    if (tt <= 0 || tt >= tmax)
+      return false;
+    *t = tt;
+    *u = uu;
+    *v = vv;
+    return true;
+  }
+
+  bool MeshBVH::intersect(const Point& origin, const Vec& dir, Hit* hit, float tmax) const
+  {
+    hit->face = -1;
+    hit->t = tmax;
+    hit->u = hit->v = 0;
+    if (nodes_.empty())
+      return false;
+
+    const float* p = (const float*)mesh_->points();
+    float o[3] = { origin[0], origin[1], origin[2] };
+    float d[3] = { dir[0], dir[1], dir[2] };
+    float inv[3] = { SafeInverse(d[0]), SafeInverse(d[1]), SafeInverse(d[2]) };
+
+    // nodes whose box the ray enters, with the entry distance
+    int stack[kStackSize];
+    float near_t[kStackSize];
+    int top = 0;
+    float tn;
+    if (BoxHit(nodes_[0].lo, nodes_[0].hi, o, inv, hit->t, &tn)) {
+      stack[top] = 0;
+      near_t[top++] = tn;
+    }
+    while (top) {
+      --top;
+      if (near_t[top] > hit->t)
+        continue;
+      int index = stack[top];
+      const Node& node = nodes_[index];
+      if (node.count) {
+        for (int i = node.index; i < node.index + node.count; i++) {
+          const unsigned int* t = &tris_[3 * i];
+          if (TriangleHit(o, d, p + 3 * (size_t)t[0], p + 3 * (size_t)t[1], p + 3 * (size_t)t[2],
+            hit->t, &hit->t, &hit->u, &hit->v))
+            hit->face = faces_[i];
+        }
+        continue;
+      }
+      // the nearer child is pushed last and visited first
+      int l = index + 1, r = node.index;
+      float tl, tr;
+      bool hl = BoxHit(nodes_[l].lo, nodes_[l].hi, o, inv, hit->t, &tl);
+      bool hr = BoxHit(nodes_[r].lo, nodes_[r].hi, o, inv, hit->t, &tr);
+      if (hl && hr && tl < tr) {
+        std::swap(l, r);
+        std::swap(tl, tr);
+      }
+      if (hl || hr) {
+        if (hl && hr) {
+          stack[top] = l;
+          near_t[top++] = tl;
+        }
+        stack[top] = hl && hr ? r : (hl ? l : r);
+        near_t[top++] = hl && hr ? tr : (hl ? tl : tr);
+      }
+    }
+    return hit->face >= 0;
+  }
+
+#ifdef HJ_BVH_SSE
+  /**
+  * 4 rays in SSE lanes, with their closest hits so far
+  */
+  struct RayPacket
+  {
+    __m128 o[3], d[3], inv[3];
+    __m128 t, u, v;
+    __m128i face;
+  };
+
+  static inline __m128 PacketBoxHit(const RayPacket& pk, const float lo[3], const float hi[3])
+  {
+    __m128 t0 = _mm_setzero_ps(), t1 = pk.t;
+    for (int c = 0; c < 3; c++) {
+      __m128 a = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(lo[c]), pk.o[c]), pk.inv[c]);
+      __m128 b = _mm_mul_ps(_mm_sub_ps(_mm_set1_ps(hi[c]), pk.o[c]), pk.inv[c]);
+      t0 = _mm_max_ps(t0, _mm_min_ps(a, b));
+      t1 = _mm_min_ps(t1, _mm_max_ps(a, b));
+    }
+    return _mm_cmple_ps(t0, t1);
+  }
+
+  static inline __m128 Select(__m128 mask, __m128 a, __m128 b)
+  {
+    return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+  }
+
+  static inline void PacketTriangleHit(RayPacket& pk, const float* a, const float* b, const float* c, int face)
+  {
+    __m128 e1[3], e2[3], tv[3];
+    for (int k = 0; k < 3; k++) {
+      e1[k] = _mm_set1_ps(b[k] - a[k]);
+      e2[k] = _mm_set1_ps(c[k] - a[k]);
+      tv[k] = _mm_sub_ps(pk.o[k], _mm_set1_ps(a[k]));
+    }
+    const __m128* d = pk.d;
+    __m128 pv0 = _mm_sub_ps(_mm_mul_ps(d[1], e2[2]), _mm_mul_ps(d[2], e2[1]));
+    __m128 pv1 = _mm_sub_ps(_mm_mul_ps(d[2], e2[0]), _mm_mul_ps(d[0], e2[2]));
+    __m128 pv2 = _mm_sub_ps(_mm_mul_ps(d[0], e2[1]), _mm_mul_ps(d[1], e2[0]));
+    __m128 det = _mm_add_ps(_mm_add_ps(_mm_mul_ps(e1[0], pv0), _mm_mul_ps(e1[1], pv1)), _mm_mul_ps(e1[2], pv2));
+    __m128 inv = _mm_div_ps(_mm_set1_ps(1.0f), det);
+    __m128 u = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(tv[0], pv0), _mm_mul_ps(tv[1], pv1)), _mm_mul_ps(tv[2], pv2)), inv);
+    __m128 qv0 = _mm_sub_ps(_mm_mul_ps(tv[1], e1[2]), _mm_mul_ps(tv[2], e1[1]));
+    __m128 qv1 = _mm_sub_ps(_mm_mul_ps(tv[2], e1[0]), _mm_mul_ps(tv[0], e1[2]));
+    __m128 qv2 = _mm_sub_ps(_mm_mul_ps(tv[0], e1[1]), _mm_mul_ps(tv[1], e1[0]));
+    __m128 v = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(d[0], qv0), _mm_mul_ps(d[1], qv1)), _mm_mul_ps(d[2], qv2)), inv);
+    __m128 t = _mm_mul_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(e2[0], qv0), _mm_mul_ps(e2[1], qv1)), _mm_mul_ps(e2[2], qv2)), inv);
+
+    __m128 zero = _mm_setzero_ps();
+    __m128 mask = _mm_cmpneq_ps(det, zero);
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(u, zero));
+    mask = _mm_and_ps(mask, _mm_cmpge_ps(v, zero));
+    mask = _mm_and_ps(mask, _mm_cmple_ps(_mm_add_ps(u, v), _mm_set1_ps(1.0f)));
+    mask = _mm_and_ps(mask, _mm_cmpgt_ps(t, zero));
+    mask = _mm_and_ps(mask, _mm_cmplt_ps(t, pk.t));
+    if (!_mm_movemask_ps(mask))
+      return;
+    pk.t = Select(mask, t, pk.t);
+    pk.u = Select(mask, u, pk.u);
+    pk.v = Select(mask, v, pk.v);
+    __m128i m = _mm_castps_si128(mask);
+    pk.face = _mm_or_si128(_mm_and_si128(m, _mm_set1_epi32(face)), _mm_andnot_si128(m, pk.face));
+  }
+#endif
+
+  void MeshBVH::intersect(const float* origins, const float* dirs, int n, Hit* hits, float tmax) const
+  {
+    if (nodes_.empty()) {
+      for (int i = 0; i < n; i++) {
+        hits[i].face = -1;
+        hits[i].t = tmax;
+        hits[i].u = hits[i].v = 0;
+      }
+      return;
+    }
+#ifdef HJ_BVH_SSE
+    const float* p = (const float*)mesh_->points();
+    int packets = (n + 3) / 4;
+#pragma omp parallel for schedule(dynamic, 16)
+    for (int k = 0; k < packets; k++) {
+      // a short last packet repeats its last ray
+      int ray[4];
+      for (int j = 0; j < 4; j++)
+        ray[j] = MIN(4 * k + j, n - 1);
+      RayPacket pk;
+      for (int c = 0; c < 3; c++) {
+        pk.o[c] = _mm_setr_ps(origins[3 * ray[0] + c], origins[3 * ray[1] + c], origins[3 * ray[2] + c], origins[3 * ray[3] + c]);
+        pk.d[c] = _mm_setr_ps(dirs[3 * ray[0] + c], dirs[3 * ray[1] + c], dirs[3 * ray[2] + c], dirs[3 * ray[3] + c]);
+        pk.inv[c] = _mm_setr_ps(SafeInverse(dirs[3 * ray[0] + c]), SafeInverse(dirs[3 * ray[1] + c]),
+          SafeInverse(dirs[3 * ray[2] + c]), SafeInverse(dirs[3 * ray[3] + c]));
+      }
+      pk.t = _mm_set1_ps(tmax);
+      pk.u = pk.v = _mm_setzero_ps();
+      pk.face = _mm_set1_epi32(-1);
+      const float* d0 = dirs + 3 * ray[0];
+
+      int stack[kStackSize];
+      int top = 0;
+      stack[top++] = 0;
+      while (top) {
+        int index = stack[--top];
+        const Node& node = nodes_[index];
+        if (!_mm_movemask_ps(PacketBoxHit(pk, node.lo, node.hi)))
+          continue;
+        if (node.count) {
+          for (int i = node.index; i < node.index + node.count; i++) {
+            const unsigned int* t = &tris_[3 * i];
+            PacketTriangleHit(pk, p + 3 * (size_t)t[0], p + 3 * (size_t)t[1], p + 3 * (size_t)t[2], faces_[i]);
+          }
+          continue;
+        }
+        // the child nearer along the first ray is visited first
+        const Node& l = nodes_[index + 1];
+        const Node& r = nodes_[node.index];
+        float ahead = 0;
+        for (int c = 0; c < 3; c++)
+          ahead += (l.lo[c] + l.hi[c] - r.lo[c] - r.hi[c]) * d0[c];
+        if (ahead > 0) {
+          stack[top++] = index + 1;
+          stack[top++] = node.index;
+        } else {
+          stack[top++] = node.index;
+          stack[top++] = index + 1;
+        }
+      }
+
+      float t[4], u[4], v[4];
+      int face[4];
+      _mm_storeu_ps(t, pk.t);
+      _mm_storeu_ps(u, pk.u);
+      _mm_storeu_ps(v, pk.v);
+      _mm_storeu_si128((__m128i*)face, pk.face);
+      for (int j = 0; j < 4 && 4 * k + j < n; j++) {
+        Hit& h = hits[4 * k + j];
+        h.face = face[j];
+        h.t = t[j];
+        h.u = u[j];
+        h.v = v[j];
+      }
+    }
+#else
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int i = 0; i < n; i++) {
+      const float* o = origins + 3 * i;
+      const float* d = dirs + 3 * i;
+      intersect(Point(o[0], o[1], o[2]), Vec(d[0], d[1], d[2]), &hits[i], tmax);
+    }
+#endif
+  }
+
+  //----------------------------------------------------------------- volumes
+
+  void MeshBVH::query(const Plane* planes, int count, std::vector<int>& faces) const
+  {
+    faces.clear();
+    if (nodes_.empty())
+      return;
+    const float* p = (const float*)mesh_->points();
+
+    // nodes to visit, and whether their box is inside all planes already
+    int stack[kStackSize];
+    bool inside[kStackSize];
+    int top = 0;
+    stack[top] = 0;
+    inside[top++] = false;
+    while (top) {
+      --top;
+      int index = stack[top];
+      bool all_in = inside[top];
+      const Node& node = nodes_[index];
+      if (!all_in) {
+        // the box corners farthest along and against each plane normal
+        bool outside = false;
+        all_in = true;
+        for (int k = 0; k < count && !outside; k++) {
+          const Plane& pl = planes[k];
+          float dmax = pl.d, dmin = pl.d;
+          for (int c = 0; c < 3; c++) {
+            dmax += pl.n[c] * (pl.n[c] > 0 ? node.hi[c] : node.lo[c]);
+            dmin += pl.n[c] * (pl.n[c] > 0 ? node.lo[c] : node.hi[c]);
+          }
+          outside = dmax < 0;
+          all_in = all_in && dmin >= 0;
+        }
+        if (outside)
+          continue;
+      }
+      if (node.count) {
+        for (int i = node.index; i < node.index + node.count; i++) {
+          bool keep = true;
+          for (int k = 0; k < count && keep && !all_in; k++) {
+            const Plane& pl = planes[k];
+            int out = 0;
+            for (int j = 0; j < 3; j++) {
+              const float* q = p + 3 * (size_t)tris_[3 * i + j];
+              out += (pl.n[0] * q[0] + pl.n[1] * q[1] + pl.n[2] * q[2] + pl.d) < 0;
+            }
+            keep = out < 3;
+          }
+          if (keep)
+            faces.push_back(faces_[i]);
+        }
+        continue;
+      }
+      stack[top] = node.index;
+      inside[top++] = all_in;
+      stack[top] = index + 1;
+      inside[top++] = all_in;
+    }
+  }
+
+  static inline void CombineRows(const float* a, float sa, const float* b, float sb, MeshBVH::Plane& plane)
+  {
+    plane.n = Vec(sa * a[0] + sb * b[0], sa * a[1] + sb * b[1], sa * a[2] + sb * b[2]);
+    plane.d = sa * a[3] + sb * b[3];
+  }
+
+  void MeshBVH::ScreenPlanes(const float mvp[16], int width, int height,
+    float x0, float y0, float x1, float y1, Plane planes[4])
+  {
+    // window x is (clip x / clip w + 1) * width / 2, so x >= x0 is
+    // (row 0 - a * row 3) | p >= 0 with a = 2 * x0 / width - 1
+    float row[4][4];
+    for (int r = 0; r < 4; r++) {
+      for (int c = 0; c < 4; c++)
+        row[r][c] = mvp[4 * c + r];
+    }
+    float ax0 = 2 * x0 / width - 1, ax1 = 2 * x1 / width - 1;
+    float ay0 = 2 * y0 / height - 1, ay1 = 2 * y1 / height - 1;
+    CombineRows(row[0], 1, row[3], -ax0, planes[0]);
+    CombineRows(row[0], -1, row[3], ax1, planes[1]);
+    CombineRows(row[1], 1, row[3], -ay0, planes[2]);
+    CombineRows(row[1], -1, row[3], ay1, planes[3]);
+  }
+
+  //----------------------------------------------------------------- closest point
+
+  static inline float BoxDistance2(const float lo[3], const float hi[3], const Point& p)
+  {
+    float d2 = 0;
+    for (int c = 0; c < 3; c++) {
+      float d = p[c] < lo[c] ? lo[c] - p[c] : (p[c] > hi[c] ? p[c] - hi[c] : 0.0f);
+      d2 += d * d;
+    }
+    return d2;
+  }
+
+  /**
+  * closest point of triangle abc to p, by the Voronoi regions of its features
+  * (Ericson, Real-Time Collision Detection 5.1.5)
+  */
+  static Point ClosestOnTriangle(const Point& p, const Point& a, const Point& b, const Point& c)
+  {
+    Vec ab = b - a, ac = c - a, ap = p - a;
+    float d1 = ab | ap, d2 = ac | ap;
+    if (d1 <= 0 && d2 <= 0)
+      return a;
+    Vec bp = p - b;
+    float d3 = ab | bp, d4 = ac | bp;
+    if (d3 >= 0 && d4 <= d3)
+      return b;
+    float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0 && d1 >= 0 && d3 <= 0)
+      return a + ab * (d1 / (d1 - d3));
+    Vec cp = p - c;
+    float d5 = ab | cp, d6 = ac | cp;
+    if (d6 >= 0 && d5 <= d6)
+      return c;
+    float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0 && d2 >= 0 && d6 <= 0)
+      return a + ac * (d2 / (d2 - d6));
+    float va = d3 * d6 - d5 * d4;
+    if (va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0)
+      return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    float denom = 1.0f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+  }
+
+  bool MeshBVH::closestPoint(const Point& p, Point* closest, int* face, float max_dist) const
+  {
+    if (nodes_.empty())
+      return false;
+    const Point* pts = mesh_->points();
+    float best = max_dist < sqrtf(FLT_MAX) ? max_dist * max_dist : FLT_MAX;
+    bool found = false;
+
+    int stack[kStackSize];
+    float dist[kStackSize];
+    int top = 0;
+    stack[top] = 0;
+    dist[top++] = BoxDistance2(nodes_[0].lo, nodes_[0].hi, p);
+    while (top) {
+      --top;
+      if (dist[top] >= best)
+        continue;
+      int index = stack[top];
+      const Node& node = nodes_[index];
+      if (node.count) {
+        for (int i = node.index; i < node.index + node.count; i++) {
+          const unsigned int* t = &tris_[3 * i];
+          Point q = ClosestOnTriangle(p, pts[t[0]], pts[t[1]], pts[t[2]]);
+          float d2 = (q - p).sqrnorm();
+          if (d2 < best) {
+            best = d2;
+            *closest = q;
+            *face = faces_[i];
+            found = true;
+          }
+        }
+        continue;
+      }
+      int l = index + 1, r = node.index;
+      float dl = BoxDistance2(nodes_[l].lo, nodes_[l].hi, p);
+      float dr = BoxDistance2(nodes_[r].lo, nodes_[r].hi, p);
+      if (dl < dr) {
+        std::swap(l, r);
+        std::swap(dl, dr);
+      }
+      // the nearer child is pushed last and visited first
+      if (dl < best) {
+        stack[top] = l;
+        dist[top++] = dl;
+      }
+      if (dr < best) {
+        stack[top] = r;
+        dist[top++] = dr;
+      }
+    }
+    return found;
+  }
+}
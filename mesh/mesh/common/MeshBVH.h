@@ -0,0 +1,119 @@
+#ifndef HJ_MeshBVH_h__
+#define HJ_MeshBVH_h__
+
+#include <float.h>
+#include <vector>
+#include "TriMesh.h"
+
+namespace hj
+{
+  /**
+  * Bounding volume hierarchy over the faces of a TriMesh, for ray, volume and
+  * closest point queries in model coordinates. The tree is built with the surface
+  * area heuristic over binned face centroids and stored depth first, the left child
+  * right after its parent. Leaves hold up to kMaxLeafFaces faces, whose vertex
+  * indices are copied in leaf order so that queries read no half-edges.
+  * When the points move, refit() recomputes the boxes bottom-up in linear time and
+  * keeps the tree; it gets looser as the deformation grows, and build() makes a new one.
+  */
+  class MeshBVH
+  {
+  public:
+    /** most faces in a leaf. */
+    static const int kMaxLeafFaces = 4;
+
+    struct Hit
+    {
+      int face;   // -1 if nothing was hit
+      float t;    // the hit point is origin + t * dir
+      float u, v; // barycentric coordinates of the 2nd and 3rd vertex of the face
+    };
+
+    /** the half-space n | p + d >= 0. */
+    struct Plane
+    {
+      Vec n;
+      float d;
+    };
+
+    MeshBVH();
+
+    /**
+    * Builds the tree over the faces of mesh, which must outlive it.
+    */
+    void build(const TriMesh* mesh);
+
+    /**
+    * Brings the boxes up to date with the points, the faces must be the same.
+    */
+    void refit();
+
+    void clear();
+    bool empty() const { return nodes_.empty(); }
+    const TriMesh* mesh() const { return mesh_; }
+
+    /**
+    * Closest hit of a ray with t in (0, tmax].
+    * @return: True if a face was hit.
+    */
+    bool intersect(const Point& origin, const Vec& dir, Hit* hit, float tmax = FLT_MAX) const;
+
+    /**
+    * Closest hits of n rays. Rays are traced in packets of 4 that share one traversal,
+    * a node is entered if any ray of the packet hits its box, and the boxes and the
+    * triangles are tested against the 4 rays at once with SSE. Packets are traced in
+    * parallel.
+    * @param origins: x, y, z per ray.
+    * @param dirs: x, y, z per ray.
+    */
+    void intersect(const float* origins, const float* dirs, int n, Hit* hits, float tmax = FLT_MAX) const;
+
+    /**
+    * Faces that may be inside the convex volume of the planes: a face is left out
+    * when its 3 vertices are outside the same plane, so faces next to an edge of
+    * the volume can be reported.
+    */
+    void query(const Plane* planes, int count, std::vector<int>& faces) const;
+
+    /**
+    * Closest point of the mesh to p, if closer than max_dist.
+    * @return: True if found.
+    */
+    bool closestPoint(const Point& p, Point* closest, int* face, float max_dist = FLT_MAX) const;
+
+    /**
+    * The planes through the sides of the window rectangle (x0, y0) - (x1, y1), for a
+    * lasso or rubber band query().
+    * @param mvp: model to clip coordinates, column major.
+    */
+    static void ScreenPlanes(const float mvp[16], int width, int height,
+      float x0, float y0, float x1, float y1, Plane planes[4]);
+
+  private:
+    /** a leaf if count > 0, with faces [index, index + count); else index is the right child. */
+    struct Node
+    {
+      float lo[3];
+      int index;
+      float hi[3];
+      int count;
+    };
+
+    struct Box
+    {
+      float lo[3], hi[3];
+    };
+
+    int buildNode(std::vector<int>& order, const std::vector<Box>& boxes,
+      const std::vector<float>& centroids, int begin, int end, int depth);
+
+    void leafBox(const Node& node, float lo[3], float hi[3]) const;
+
+    const TriMesh* mesh_;
+    std::vector<Node> nodes_;
+    std::vector<int> faces_;         // face of every leaf slot
+    std::vector<unsigned int> tris_; // its 3 vertex indices
+  };
+}
+
+#endif // HJ_MeshBVH_h__
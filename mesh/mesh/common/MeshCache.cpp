@@ -0,0 +1,307 @@
+#include "MeshCache.h"
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <vector>
+#include "MappedFile.h"
+#include "macro.h"
+#include "TriMesh.h"
+
+namespace hj
+{
+  static const char kMagic[4] = { 'H', 'J', 'M', 'C' };
+
+  struct MeshCacheHeader
+  {
+    char magic[4];
+    uint32_t version;
+    uint64_t source_size;
+    uint64_t source_hash;
+    uint32_t n_vertices;
+    uint32_t n_edges;
+    uint32_t n_faces;
+    uint32_t section_count;
+    uint64_t offset[MeshCache::kSectionCount]; // 0 if the section is absent
+  };
+
+  static_assert(sizeof(TriMesh::Point) == 3 * sizeof(float)
+    && sizeof(TriMesh::Normal) == 3 * sizeof(float)
+    && sizeof(TriMesh::TexCoord2D) == 2 * sizeof(float),
+    "the cache sections are copied to and from the mesh property arrays");
+
+  static size_t SectionSize(int s, const MeshCacheHeader& h)
+  {
+    size_t nv = h.n_vertices, nh = 2 * (size_t)h.n_edges, nf = h.n_faces;
+    switch (s) {
+    case MeshCache::kPositions:
+    case MeshCache::kNormals:
+      return nv * 3 * sizeof(float);
+    case MeshCache::kTexCoords:
+      return nv * 2 * sizeof(float);
+    case MeshCache::kFaceNormals:
+      return nf * 3 * sizeof(float);
+    case MeshCache::kIndices:
+      return nf * 3 * sizeof(uint32_t);
+    case MeshCache::kVertexHalfedge:
+      return nv * sizeof(int32_t);
+    case MeshCache::kHalfedges:
+      return nh * 3 * sizeof(int32_t);
+    case MeshCache::kFaceHalfedge:
+      return nf * sizeof(int32_t);
+    case MeshCache::kCotWeights:
+      return nh * sizeof(float);
+    case MeshCache::kOriginalVertices:
+      return nv * sizeof(int32_t);
+    case MeshCache::kOriginalFaces:
+      return nf * sizeof(int32_t);
+    }
+    return 0;
+  }
+
+  static size_t Align(size_t offset)
+  {
+    return (offset + MeshCache::kAlignment - 1) / MeshCache::kAlignment * MeshCache::kAlignment;
+  }
+
+  /**
+  * true if all n values of a are in [lo, hi)
+  */
+  static bool InRange(const int32_t* a, size_t n, size_t stride, int32_t lo, int64_t hi)
+  {
+    for (size_t i = 0; i < n; i++) {
+      if (a[i * stride] < lo || a[i * stride] >= hi)
+        return false;
+    }
+    return true;
+  }
+
+  std::string MeshCache::CachePath(const std::string& source)
+  {
+    return source + ".hjmc";
+  }
+
+  uint64_t MeshCache::Hash(const void* data, size_t size)
+  {
+    // four independent multiply-xorshift lanes over 8 byte words keep the
+    // multiplier busy, so hashing runs at about memory speed
+    const uint64_t kMul = 0x9E3779B97F4A7C15ULL;
+    const char* p = (const char*)data;
+    uint64_t h[4] = { size, kMul, ~(uint64_t)size, 0x2545F4914F6CDD1DULL };
+    size_t blocks = size / 32;
+    for (size_t b = 0; b < blocks; b++, p += 32) {
+      for (int k = 0; k < 4; k++) {
+        uint64_t w;
+        memcpy(&w, p + 8 * k, 8);
+        h[k] = (h[k] ^ w) * kMul;
+        h[k] ^= h[k] >> 29;
+      }
+    }
+    for (size_t i = blocks * 32; i < size; i++, p++) {
+      h[0] = (h[0] ^ (unsigned char)*p) * kMul;
+      h[0] ^= h[0] >> 29;
+    }
+    uint64_t r = 0;
+    for (int k = 0; k < 4; k++) {
+      r = (r ^ h[k]) * kMul;
+      r ^= r >> 32;
+    }
+    return r;
+  }
+
+  bool MeshCache::Read(const std::string& filename, uint64_t source_size,
+    uint64_t source_hash, bool reordered, TriMesh* mesh)
+  {
+    if (!mesh->has_vertex_normals() || !mesh->has_face_normals())
+      return false;
+    MappedFile file;
+    if (!file.Open(filename) || file.GetSize() < sizeof(MeshCacheHeader))
+      return false;
+    const char* data = file.GetData();
+    MeshCacheHeader h;
+    memcpy(&h, data, sizeof(h));
+    if (memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion
+      || h.section_count != kSectionCount || h.source_size != source_size
+      || h.source_hash != source_hash)
+      return false;
+    if ((h.offset[kOriginalVertices] != 0) != reordered || (h.offset[kOriginalFaces] != 0) != reordered)
+      return false;
+
+    for (int s = 0; s < kSectionCount; s++) {
+      if (!h.offset[s]) {
+        if (s != kTexCoords && s != kCotWeights && s != kOriginalVertices && s != kOriginalFaces)
+          return false;
+        continue;
+      }
+      if (h.offset[s] % kAlignment != 0 || h.offset[s] > file.GetSize()
+        || SectionSize(s, h) > file.GetSize() - h.offset[s])
+        return false;
+    }
+
+    // the offsets are within the mapped file now, so they fit a size_t
+    size_t offset[kSectionCount];
+    for (int s = 0; s < kSectionCount; s++)
+      offset[s] = (size_t)h.offset[s];
+
+    size_t nv = h.n_vertices, ne = h.n_edges, nf = h.n_faces, nh = 2 * ne;
+    const int32_t* vhe = (const int32_t*)(data + offset[kVertexHalfedge]);
+    const int32_t* he = (const int32_t*)(data + offset[kHalfedges]);
+    const int32_t* fhe = (const int32_t*)(data + offset[kFaceHalfedge]);
+    const uint32_t* indices = (const uint32_t*)(data + offset[kIndices]);
+    const int32_t* ov = reordered ? (const int32_t*)(data + offset[kOriginalVertices]) : nullptr;
+    const int32_t* of = reordered ? (const int32_t*)(data + offset[kOriginalFaces]) : nullptr;
+
+    // the source hash does not protect the cache itself: reject handles that
+    // would point outside the mesh
+    if (!InRange(vhe, nv, 1, -1, nh) || !InRange(he, nh, 3, 0, nv)
+      || !InRange(he + 1, nh, 3, 0, nh) || !InRange(he + 2, nh, 3, -1, nf)
+      || !InRange(fhe, nf, 1, 0, nh))
+      return false;
+    if (reordered && (!InRange(ov, nv, 1, 0, nv) || !InRange(of, nf, 1, 0, nf)))
+      return false;
+    for (size_t i = 0; i < nf * 3; i++) {
+      if (indices[i] >= nv)
+        return false;
+    }
+
+    mesh->clean();
+    mesh->resize(nv, ne, nf);
+    for (size_t v = 0; v < nv; v++)
+      mesh->set_halfedge_handle(TriMesh::VertexHandle((int)v), TriMesh::HalfedgeHandle(vhe[v]));
+    for (size_t i = 0; i < nh; i++) {
+      TriMesh::HalfedgeHandle heh((int)i);
+      mesh->set_vertex_handle(heh, TriMesh::VertexHandle(he[3 * i]));
+      mesh->set_next_halfedge_handle(heh, TriMesh::HalfedgeHandle(he[3 * i + 1]));
+      mesh->set_face_handle(heh, TriMesh::FaceHandle(he[3 * i + 2]));
+    }
+    for (size_t f = 0; f < nf; f++)
+      mesh->set_halfedge_handle(TriMesh::FaceHandle((int)f), TriMesh::HalfedgeHandle(fhe[f]));
+
+    if (nv) {
+      memcpy((void*)mesh->points(), data + offset[kPositions], SectionSize(kPositions, h));
+      memcpy((void*)mesh->vertex_normals(), data + offset[kNormals], SectionSize(kNormals, h));
+      if (mesh->has_vertex_texcoords2D()) {
+        if (h.offset[kTexCoords])
+          memcpy((void*)mesh->texcoords2D(), data + offset[kTexCoords], SectionSize(kTexCoords, h));
+        else
+          memset((void*)mesh->texcoords2D(), 0, SectionSize(kTexCoords, h));
+      }
+    }
+    if (nf)
+      memcpy((void*)&mesh->normal(TriMesh::FaceHandle(0)), data + offset[kFaceNormals], SectionSize(kFaceNormals, h));
+
+    mesh->tri_indices_.assign(indices, indices + nf * 3);
+    if (h.offset[kCotWeights]) {
+      const float* w = (const float*)(data + offset[kCotWeights]);
+      mesh->cot_weights_.assign(w, w + nh);
+    }
+    else
+      mesh->cot_weights_.clear();
+    if (reordered) {
+      mesh->original_vertex_.assign(ov, ov + nv);
+      mesh->original_face_.assign(of, of + nf);
+    }
+    else {
+      mesh->original_vertex_.clear();
+      mesh->original_face_.clear();
+    }
+
+    // the cache provides the normals, whether the source had them or not
+    OpenMesh::IO::Options opt;
+    opt += OpenMesh::IO::Options::VertexNormal;
+    opt += OpenMesh::IO::Options::FaceNormal;
+    if (h.offset[kTexCoords])
+      opt += OpenMesh::IO::Options::VertexTexCoord;
+    mesh->option = opt;
+    return true;
+  }
+
+  /**
+  * writes size bytes at offset, padding with zeros from the current position pos
+  */
+  static void WriteSection(std::ofstream& out, size_t& pos, uint64_t offset, const void* data, size_t size)
+  {
+    static const char zeros[MeshCache::kAlignment] = { 0 };
+    while (pos < offset) {
+      size_t n = MIN((size_t)(offset - pos), sizeof(zeros));
+      out.write(zeros, n);
+      pos += n;
+    }
+    if (size)
+      out.write((const char*)data, size);
+    pos += size;
+  }
+
+  bool MeshCache::Write(const std::string& filename, uint64_t source_size,
+    uint64_t source_hash, const TriMesh& mesh)
+  {
+    size_t nv = mesh.n_vertices(), ne = mesh.n_edges(), nf = mesh.n_faces(), nh = 2 * ne;
+    if (mesh.tri_indices_.size() != nf * 3 || !mesh.has_vertex_normals() || !mesh.has_face_normals())
+      return false;
+
+    MeshCacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.source_size = source_size;
+    h.source_hash = source_hash;
+    h.n_vertices = (uint32_t)nv;
+    h.n_edges = (uint32_t)ne;
+    h.n_faces = (uint32_t)nf;
+    h.section_count = kSectionCount;
+
+    bool texcoords = mesh.option.check(OpenMesh::IO::Options::VertexTexCoord) && mesh.has_vertex_texcoords2D();
+    bool weights = mesh.cot_weights_.size() == nh;
+    bool reordered = !mesh.original_vertex_.empty() && mesh.original_vertex_.size() == nv
+      && mesh.original_face_.size() == nf;
+    size_t offset = Align(sizeof(h));
+    for (int s = 0; s < kSectionCount; s++) {
+      if ((s == kTexCoords && !texcoords) || (s == kCotWeights && !weights)
+        || ((s == kOriginalVertices || s == kOriginalFaces) && !reordered))
+        continue;
+      h.offset[s] = offset;
+      offset = Align(offset + SectionSize(s, h));
+    }
+
+    // connectivity is not stored contiguously by OpenMesh, gather it
+    std::vector<int32_t> vhe(nv), he(nh * 3), fhe(nf);
+    for (size_t v = 0; v < nv; v++)
+      vhe[v] = mesh.halfedge_handle(TriMesh::VertexHandle((int)v)).idx();
+    for (size_t i = 0; i < nh; i++) {
+      TriMesh::HalfedgeHandle heh((int)i);
+      he[3 * i] = mesh.to_vertex_handle(heh).idx();
+      he[3 * i + 1] = mesh.next_halfedge_handle(heh).idx();
+      he[3 * i + 2] = mesh.face_handle(heh).idx();
+    }
+    for (size_t f = 0; f < nf; f++)
+      fhe[f] = mesh.halfedge_handle(TriMesh::FaceHandle((int)f)).idx();
+
+    const void* sections[kSectionCount] = {
+      mesh.points(), mesh.vertex_normals(), texcoords ? mesh.texcoords2D() : nullptr,
+      nf ? &mesh.normal(TriMesh::FaceHandle(0)) : nullptr, nf ? &mesh.tri_indices_[0] : nullptr,
+      nv ? &vhe[0] : nullptr, nh ? &he[0] : nullptr, nf ? &fhe[0] : nullptr,
+      weights && nh ? &mesh.cot_weights_[0] : nullptr,
+      reordered ? &mesh.original_vertex_[0] : nullptr, reordered && nf ? &mesh.original_face_[0] : nullptr };
+
+    std::string tmp = filename + ".tmp";
+    std::ofstream out(tmp.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out)
+      return false;
+    size_t pos = 0;
+    WriteSection(out, pos, 0, &h, sizeof(h));
+    for (int s = 0; s < kSectionCount; s++) {
+      if (h.offset[s])
+        WriteSection(out, pos, h.offset[s], sections[s], SectionSize(s, h));
+    }
+    out.close();
+    if (!out) {
+      remove(tmp.c_str());
+      return false;
+    }
+    remove(filename.c_str());
+    if (rename(tmp.c_str(), filename.c_str()) != 0) {
+      remove(tmp.c_str());
+      return false;
+    }
+    return true;
+  }
+}
@@ -0,0 +1,82 @@
+#ifndef HJ_MeshCache_h__
+#define HJ_MeshCache_h__
+
+#include <stdint.h>
+#include <string>
+
+namespace hj
+{
+  class TriMesh;
+
+  /**
+  * Binary cache of a loaded mesh, kept next to the source file. It holds what
+  * TriMesh::read builds from the source: positions, normals, texture coordinates,
+  * the render index array, the half-edge connectivity and optionally the
+  * cotangent weights, so a later load is a few block copies out of a mapped file
+  * instead of parsing text and inserting the faces one by one. A mesh that read()
+  * reordered is cached in its new order, together with the file index of every
+  * vertex and face, so loading it does not reorder it again.
+  *
+  * The file is a fixed header followed by the sections, each starting on a
+  * kAlignment byte boundary, so a mapping of the cache can also be used in place.
+  * A cache is only used if its version and the size and content hash of the
+  * source it was made from match, otherwise it is ignored and rewritten.
+  */
+  class MeshCache
+  {
+  public:
+    enum Section
+    {
+      kPositions,        // float x, y, z per vertex
+      kNormals,          // float x, y, z per vertex
+      kTexCoords,        // float u, v per vertex, only if the source has them
+      kFaceNormals,      // float x, y, z per face
+      kIndices,          // uint32 v0, v1, v2 per face, as drawn by the renderer
+      kVertexHalfedge,   // int32 outgoing halfedge per vertex, -1 if isolated
+      kHalfedges,        // int32 to vertex, next halfedge, face (-1 on the boundary) per halfedge
+      kFaceHalfedge,     // int32 halfedge per face
+      kCotWeights,       // float per halfedge in vertex-vertex circulation order, optional
+      kOriginalVertices, // int32 file index per vertex, only if the mesh was reordered
+      kOriginalFaces,    // int32 file index per face, only if the mesh was reordered
+      kSectionCount
+    };
+
+    /** file format version, bumped whenever the layout changes. */
+    static const uint32_t kVersion = 2;
+
+    /** alignment of every section in bytes. */
+    static const size_t kAlignment = 64;
+
+    /**
+    * @return: path of the cache file of a mesh file.
+    */
+    static std::string CachePath(const std::string& source);
+
+    /**
+    * 64 bit hash of the source content, recorded in the cache.
+    */
+    static uint64_t Hash(const void* data, size_t size);
+
+    /**
+    * Loads mesh from a cache file made from a source of the given size and hash.
+    * The mesh must have its vertex normals, texture coordinates and face normals requested.
+    * @param reordered: whether a reordered mesh is asked for; a cache in the other
+    * order does not match.
+    * @return: True if the mesh was loaded, false if the cache is missing, stale,
+    * damaged or in the other order; the mesh is not touched in that case.
+    */
+    static bool Read(const std::string& filename, uint64_t source_size,
+      uint64_t source_hash, bool reordered, TriMesh* mesh);
+
+    /**
+    * Writes the cache of mesh, with its file indices if it was reordered. The data go
+    * to a temporary file that is renamed when
+    * complete, so an interrupted write never leaves a partial cache behind.
+    * @return: True if successful, false otherwise.
+    */
+    static bool Write(const std::string& filename, uint64_t source_size,
+      uint64_t source_hash, const TriMesh& mesh);
+  };
+}
+
+#endif // HJ_MeshCache_h__
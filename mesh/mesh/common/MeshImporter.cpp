@@ -0,0 +1,1344 @@
+#include "MeshImporter.h"
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <iostream>
+#include <vector>
+#include <omp.h>
+#include "IOUtilities.h"
+#include "MappedFile.h"
+#include "macro.h"
+#include "TriMesh.h"
+
+namespace hj
+{
+  // chunks are cut for about this many per thread, but not smaller than kMinChunkBytes
+  static const int kChunksPerThread = 4;
+  static const size_t kMinChunkBytes = 1 << 20;
+
+  /**
+  * what a parser produces, before the mesh is built
+  */
+  struct ImportData
+  {
+    std::vector<float> positions;   // x, y, z per vertex
+    std::vector<float> normals;     // x, y, z per vertex, empty if the file has none
+    std::vector<float> texcoords;   // u, v per vertex, empty if the file has none
+    std::vector<int> triangles;     // 3 vertex indices per triangle, -1 if invalid
+
+    int VertexCount() const { return (int)(positions.size() / 3); }
+    int TriangleCount() const { return (int)(triangles.size() / 3); }
+  };
+
+  //----------------------------------------------------------------- text parsing
+
+  static const double kPow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+  static inline bool IsDigit(char c) { return (unsigned)(c - '0') < 10; }
+
+  static inline bool IsSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+  static inline const char* SkipSpaces(const char* p, const char* end)
+  {
+    while (p < end && IsSpace(*p))
+      ++p;
+    return p;
+  }
+
+  static inline const char* SkipToken(const char* p, const char* end)
+  {
+    while (p < end && !IsSpace(*p) && *p != '\n')
+      ++p;
+    return p;
+  }
+
+  static inline const char* NextLine(const char* p, const char* end)
+  {
+    const char* nl = (const char*)memchr(p, '\n', end - p);
+    return nl ? nl + 1 : end;
+  }
+
+  /**
+  * end of the content of the line starting at p (before '\r\n' or '\n')
+  */
+  static inline const char* LineEnd(const char* p, const char* next)
+  {
+    while (next > p && (next[-1] == '\n' || next[-1] == '\r'))
+      --next;
+    return next;
+  }
+
+  static const char* ParseInt(const char* p, const char* end, int& value)
+  {
+    p = SkipSpaces(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negative = *p == '-';
+      ++p;
+    }
+    int v = 0;
+    for (; p < end && IsDigit(*p); ++p)
+      v = v * 10 + (*p - '0');
+    value = negative ? -v : v;
+    return p;
+  }
+
+  /**
+  * fallback for what the fast path does not parse (nan, inf), value is 0 for garbage
+  */
+  static const char* ParseFloatSlow(const char* p, const char* end, float& value)
+  {
+    char buf[64];
+    const char* e = SkipToken(p, end);
+    size_t n = MIN((size_t)(e - p), sizeof(buf) - 1);
+    memcpy(buf, p, n);
+    buf[n] = 0;
+    value = (float)strtod(buf, NULL);
+    return e;
+  }
+
+  /**
+  * Decimal to float without locale or stream overhead: the significant digits are
+  * collected in an integer and scaled by an exact power of ten, which rounds the
+  * same as strtod for the up to 9 digits a float carries.
+  */
+  static const char* ParseFloat(const char* p, const char* end, float& value)
+  {
+    p = SkipSpaces(p, end);
+    const char* start = p;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+      negative = *p == '-';
+      ++p;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    const char* first = p;
+    for (; p < end && IsDigit(*p); ++p) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += mantissa != 0;
+      }
+      else
+        exponent++;
+    }
+    if (p < end && *p == '.') {
+      ++p;
+      for (; p < end && IsDigit(*p); ++p) {
+        if (digits < 19) {
+          mantissa = mantissa * 10 + (*p - '0');
+          digits += mantissa != 0;
+          exponent--;
+        }
+      }
+    }
+    if (p == first || (p == first + 1 && *first == '.'))
+      return ParseFloatSlow(start, end, value);
+    if (p + 1 < end && (*p == 'e' || *p == 'E')
+      && (IsDigit(p[1]) || ((p[1] == '-' || p[1] == '+') && p + 2 < end && IsDigit(p[2])))) {
+      int e;
+      p = ParseInt(p + 1, end, e);
+      exponent += e;
+    }
+    double v = (double)mantissa;
+    if (exponent < 0)
+      v = (exponent >= -22) ? v / kPow10[-exponent] : v * pow(10.0, exponent);
+    else if (exponent > 0)
+      v = (exponent <= 22) ? v * kPow10[exponent] : v * pow(10.0, exponent);
+    value = (float)(negative ? -v : v);
+    return p;
+  }
+
+  /**
+  * Cuts [begin, end) into pieces starting at the beginning of a line.
+  * @return: chunk boundaries, chunk i is [cuts[i], cuts[i + 1]).
+  */
+  static std::vector<const char*> SplitLines(const char* begin, const char* end)
+  {
+    size_t size = end - begin;
+    size_t n = MIN((size_t)omp_get_max_threads() * kChunksPerThread, size / kMinChunkBytes);
+    n = MAX(n, (size_t)1);
+    std::vector<const char*> cuts(1, begin);
+    for (size_t i = 1; i < n; i++) {
+      const char* p = MAX(begin + size / n * i, cuts.back());
+      cuts.push_back(p < end ? NextLine(p, end) : end);
+    }
+    cuts.push_back(end);
+    return cuts;
+  }
+
+  /**
+  * exclusive prefix sum, returns the total
+  */
+  static int PrefixSum(std::vector<int>& a)
+  {
+    int sum = 0;
+    for (size_t i = 0; i < a.size(); i++) {
+      int v = a[i];
+      a[i] = sum;
+      sum += v;
+    }
+    return sum;
+  }
+
+  //--------------------------------------------------------------------------- OBJ
+
+  struct ObjCounts
+  {
+    int v, vt, vn, tris;
+  };
+
+  struct ObjData
+  {
+    std::vector<float> vt, vn;
+    std::vector<int> corner_vt, corner_vn; // per triangle corner, -1 if not given
+  };
+
+  static inline int CountTokens(const char* p, const char* end)
+  {
+    int n = 0;
+    for (p = SkipSpaces(p, end); p < end && *p != '#'; p = SkipSpaces(p, end)) {
+      p = SkipToken(p, end);
+      n++;
+    }
+    return n;
+  }
+
+  static inline bool IsSpaceAt(const char* p, const char* end) { return p < end && (*p == ' ' || *p == '\t'); }
+
+  static void CountObj(const char* p, const char* end, ObjCounts& c)
+  {
+    while (p < end) {
+      p = SkipSpaces(p, end);
+      const char* next = NextLine(p, end);
+      if (next - p > 2 && p[0] == 'v') {
+        if (IsSpaceAt(p + 1, end))
+          c.v++;
+        else if (p[1] == 't' && IsSpaceAt(p + 2, end))
+          c.vt++;
+        else if (p[1] == 'n' && IsSpaceAt(p + 2, end))
+          c.vn++;
+      }
+      else if (next - p > 2 && p[0] == 'f' && IsSpaceAt(p + 1, end)) {
+        int corners = CountTokens(p + 1, LineEnd(p, next));
+        if (corners >= 3)
+          c.tris += corners - 2;
+      }
+      p = next;
+    }
+  }
+
+  /**
+  * OBJ index to 0-based, relative to count elements read so far if negative; -1 if invalid.
+  */
+  static inline int ObjIndex(int i, int count)
+  {
+    if (i > 0)
+      return i - 1;
+    if (i < 0 && count + i >= 0)
+      return count + i;
+    return -1;
+  }
+
+  /**
+  * second pass over a chunk, at holds the number of elements of each kind before the chunk
+  */
+  static void ParseObj(const char* p, const char* end, ObjCounts at, ImportData& d, ObjData& o)
+  {
+    while (p < end) {
+      p = SkipSpaces(p, end);
+      const char* next = NextLine(p, end);
+      const char* le = LineEnd(p, next);
+      if (next - p > 2 && p[0] == 'v') {
+        if (IsSpaceAt(p + 1, end)) {
+          float* v = &d.positions[3 * at.v++];
+          const char* q = ParseFloat(p + 1, le, v[0]);
+          q = ParseFloat(q, le, v[1]);
+          ParseFloat(q, le, v[2]);
+        }
+        else if (p[1] == 't' && IsSpaceAt(p + 2, end)) {
+          float* t = &o.vt[2 * at.vt++];
+          ParseFloat(ParseFloat(p + 2, le, t[0]), le, t[1]);
+        }
+        else if (p[1] == 'n' && IsSpaceAt(p + 2, end)) {
+          float* n = &o.vn[3 * at.vn++];
+          const char* q = ParseFloat(p + 2, le, n[0]);
+          q = ParseFloat(q, le, n[1]);
+          ParseFloat(q, le, n[2]);
+        }
+      }
+      else if (next - p > 2 && p[0] == 'f' && IsSpaceAt(p + 1, end)) {
+        // the same tokens as counted by CountObj, so the number of triangles matches
+        int corners = CountTokens(p + 1, le);
+        int v0 = -1, t0 = -1, n0 = -1, vp = -1, tp = -1, np = -1;
+        const char* q = SkipSpaces(p + 1, le);
+        for (int k = 0; k < corners; k++, q = SkipSpaces(q, le)) {
+          const char* te = SkipToken(q, le);
+          int vi = 0, ti = 0, ni = 0;
+          const char* r = ParseInt(q, te, vi);
+          if (r < te && *r == '/') {
+            if (r + 1 < te && r[1] != '/')
+              r = ParseInt(r + 1, te, ti);
+            else
+              ++r;
+            if (r < te && *r == '/')
+              ParseInt(r + 1, te, ni);
+          }
+          int v = ObjIndex(vi, at.v), t = ObjIndex(ti, at.vt), n = ObjIndex(ni, at.vn);
+          if (k == 0) {
+            v0 = v; t0 = t; n0 = n;
+          }
+          else if (k >= 2) {
+            int c = 3 * at.tris++;
+            int* tri = &d.triangles[c];
+            tri[0] = v0; tri[1] = vp; tri[2] = v;
+            o.corner_vt[c] = t0; o.corner_vt[c + 1] = tp; o.corner_vt[c + 2] = t;
+            o.corner_vn[c] = n0; o.corner_vn[c + 1] = np; o.corner_vn[c + 2] = n;
+          }
+          vp = v; tp = t; np = n;
+          q = te;
+        }
+      }
+      p = next;
+    }
+  }
+
+  static bool ReadObj(const char* begin, const char* end, ImportData& d)
+  {
+    std::vector<const char*> cuts = SplitLines(begin, end);
+    int nc = (int)cuts.size() - 1;
+    std::vector<ObjCounts> counts(nc);
+    memset(&counts[0], 0, nc * sizeof(ObjCounts));
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < nc; i++)
+      CountObj(cuts[i], cuts[i + 1], counts[i]);
+
+    ObjCounts total = { 0, 0, 0, 0 };
+    for (int i = 0; i < nc; i++) {
+      ObjCounts c = counts[i];
+      counts[i] = total;
+      total.v += c.v; total.vt += c.vt; total.vn += c.vn; total.tris += c.tris;
+    }
+    if (total.v == 0)
+      return false;
+
+    ObjData o;
+    d.positions.resize(3 * (size_t)total.v);
+    d.triangles.resize(3 * (size_t)total.tris);
+    o.vt.resize(2 * (size_t)total.vt);
+    o.vn.resize(3 * (size_t)total.vn);
+    o.corner_vt.resize(d.triangles.size());
+    o.corner_vn.resize(d.triangles.size());
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < nc; i++)
+      ParseObj(cuts[i], cuts[i + 1], counts[i], d, o);
+
+    // texture coordinates and normals are given per corner; as in the OpenMesh
+    // reader the last corner of a vertex decides
+    int nv = total.v;
+    if (total.vt) {
+      d.texcoords.assign(2 * (size_t)nv, 0.0f);
+      for (size_t c = 0; c < d.triangles.size(); c++) {
+        int v = d.triangles[c], t = o.corner_vt[c];
+        if (v >= 0 && v < nv && t >= 0 && t < total.vt) {
+          d.texcoords[2 * v] = o.vt[2 * t];
+          d.texcoords[2 * v + 1] = o.vt[2 * t + 1];
+        }
+      }
+    }
+    if (total.vn) {
+      d.normals.assign(3 * (size_t)nv, 0.0f);
+      for (size_t c = 0; c < d.triangles.size(); c++) {
+        int v = d.triangles[c], n = o.corner_vn[c];
+        if (v >= 0 && v < nv && n >= 0 && n < total.vn)
+          memcpy(&d.normals[3 * v], &o.vn[3 * n], 3 * sizeof(float));
+      }
+    }
+    return true;
+  }
+
+  //--------------------------------------------------------------------------- PLY
+
+  enum PlyType { kPlyInt8, kPlyUInt8, kPlyInt16, kPlyUInt16, kPlyInt32, kPlyUInt32, kPlyFloat32, kPlyFloat64, kPlyInvalid };
+
+  static const int kPlyTypeSize[] = { 1, 1, 2, 2, 4, 4, 4, 8 };
+
+  struct PlyProperty
+  {
+    std::string name;
+    PlyType type;
+    PlyType count_type; // kPlyInvalid for scalar properties
+  };
+
+  struct PlyElement
+  {
+    std::string name;
+    int count;
+    std::vector<PlyProperty> props;
+    int stride; // record size in bytes, 0 if there are list properties
+
+    int Find(const char* prop) const
+    {
+      for (size_t i = 0; i < props.size(); i++) {
+        if (props[i].name == prop)
+          return (int)i;
+      }
+      return -1;
+    }
+  };
+
+  static PlyType PlyTypeOf(const std::string& s)
+  {
+    if (s == "char" || s == "int8") return kPlyInt8;
+    if (s == "uchar" || s == "uint8") return kPlyUInt8;
+    if (s == "short" || s == "int16") return kPlyInt16;
+    if (s == "ushort" || s == "uint16") return kPlyUInt16;
+    if (s == "int" || s == "int32") return kPlyInt32;
+    if (s == "uint" || s == "uint32") return kPlyUInt32;
+    if (s == "float" || s == "float32") return kPlyFloat32;
+    if (s == "double" || s == "float64") return kPlyFloat64;
+    return kPlyInvalid;
+  }
+
+  static double PlyValue(const char* p, PlyType type, bool swap)
+  {
+    unsigned char b[8];
+    int n = kPlyTypeSize[type];
+    for (int i = 0; i < n; i++)
+      b[i] = (unsigned char)p[swap ? n - 1 - i : i];
+    switch (type) {
+    case kPlyInt8: return (double)(signed char)b[0];
+    case kPlyUInt8: return (double)b[0];
+    case kPlyInt16: { int16_t v; memcpy(&v, b, 2); return (double)v; }
+    case kPlyUInt16: { uint16_t v; memcpy(&v, b, 2); return (double)v; }
+    case kPlyInt32: { int32_t v; memcpy(&v, b, 4); return (double)v; }
+    case kPlyUInt32: { uint32_t v; memcpy(&v, b, 4); return (double)v; }
+    case kPlyFloat32: { float v; memcpy(&v, b, 4); return (double)v; }
+    case kPlyFloat64: { double v; memcpy(&v, b, 8); return v; }
+    default: return 0;
+    }
+  }
+
+  struct PlyHeader
+  {
+    enum Format { kAscii, kBinaryLE, kBinaryBE } format;
+    std::vector<PlyElement> elements;
+    const char* body;
+  };
+
+  static bool ParsePlyHeader(const char* begin, const char* end, PlyHeader& h)
+  {
+    if (end - begin < 4 || memcmp(begin, "ply", 3) != 0)
+      return false;
+    bool has_format = false;
+    for (const char* p = NextLine(begin, end); p < end;) {
+      const char* next = NextLine(p, end);
+      std::vector<std::string> tok;
+      const char* le = LineEnd(p, next);
+      for (const char* q = SkipSpaces(p, le); q < le; q = SkipSpaces(q, le)) {
+        const char* e = SkipToken(q, le);
+        tok.push_back(std::string(q, e));
+        q = e;
+      }
+      p = next;
+      if (tok.empty() || tok[0] == "comment" || tok[0] == "obj_info")
+        continue;
+      if (tok[0] == "end_header") {
+        h.body = p;
+        return has_format;
+      }
+      if (tok[0] == "format" && tok.size() >= 2) {
+        if (tok[1] == "ascii") h.format = PlyHeader::kAscii;
+        else if (tok[1] == "binary_little_endian") h.format = PlyHeader::kBinaryLE;
+        else if (tok[1] == "binary_big_endian") h.format = PlyHeader::kBinaryBE;
+        else return false;
+        has_format = true;
+      }
+      else if (tok[0] == "element" && tok.size() >= 3) {
+        PlyElement e;
+        e.name = tok[1];
+        e.count = atoi(tok[2].c_str());
+        e.stride = 0;
+        if (e.count < 0)
+          return false;
+        h.elements.push_back(e);
+      }
+      else if (tok[0] == "property" && !h.elements.empty()) {
+        PlyProperty prop;
+        if (tok.size() >= 5 && tok[1] == "list") {
+          prop.count_type = PlyTypeOf(tok[2]);
+          prop.type = PlyTypeOf(tok[3]);
+          prop.name = tok[4];
+          if (prop.count_type == kPlyInvalid)
+            return false;
+        }
+        else if (tok.size() >= 3) {
+          prop.count_type = kPlyInvalid;
+          prop.type = PlyTypeOf(tok[1]);
+          prop.name = tok[2];
+        }
+        else
+          return false;
+        if (prop.type == kPlyInvalid)
+          return false;
+        h.elements.back().props.push_back(prop);
+      }
+    }
+    return false;
+  }
+
+  /**
+  * vertex property indices
+  */
+  struct PlyVertexLayout
+  {
+    int x, y, z, nx, ny, nz, u, v;
+    int offset[3 + 3 + 2]; // byte offsets in a binary record, same order
+
+    bool Init(const PlyElement& e)
+    {
+      x = e.Find("x"); y = e.Find("y"); z = e.Find("z");
+      nx = e.Find("nx"); ny = e.Find("ny"); nz = e.Find("nz");
+      u = e.Find("u"); v = e.Find("v");
+      if (u < 0 || v < 0) { u = e.Find("s"); v = e.Find("t"); }
+      if (u < 0 || v < 0) { u = e.Find("texture_u"); v = e.Find("texture_v"); }
+      if (nx < 0 || ny < 0 || nz < 0) nx = ny = nz = -1;
+      if (u < 0 || v < 0) u = v = -1;
+      for (size_t i = 0; i < e.props.size(); i++) {
+        if (e.props[i].count_type != kPlyInvalid)
+          return false;
+      }
+      return x >= 0 && y >= 0 && z >= 0;
+    }
+  };
+
+  static int FaceIndexProperty(const PlyElement& e)
+  {
+    int i = e.Find("vertex_indices");
+    if (i < 0)
+      i = e.Find("vertex_index");
+    return (i >= 0 && e.props[i].count_type != kPlyInvalid) ? i : -1;
+  }
+
+  /**
+  * record size of an element without list properties, 0 otherwise
+  */
+  static int PlyStride(const PlyElement& e)
+  {
+    int s = 0;
+    for (size_t i = 0; i < e.props.size(); i++) {
+      if (e.props[i].count_type != kPlyInvalid)
+        return 0;
+      s += kPlyTypeSize[e.props[i].type];
+    }
+    return s;
+  }
+
+  /**
+  * fan triangles of a face with n corners
+  */
+  static inline void EmitFan(const int* idx, int n, int*& out)
+  {
+    for (int k = 2; k < n; k++) {
+      out[0] = idx[0]; out[1] = idx[k - 1]; out[2] = idx[k];
+      out += 3;
+    }
+  }
+
+  /**
+  * walks one binary face record, calling back the indices of its vertex list
+  * @return: pointer past the record, or NULL if it runs past end.
+  */
+  static const char* PlyBinaryFace(const char* p, const char* end, const PlyElement& e, int list,
+    bool swap, std::vector<int>& idx)
+  {
+    for (size_t i = 0; i < e.props.size(); i++) {
+      const PlyProperty& prop = e.props[i];
+      int ts = kPlyTypeSize[prop.type];
+      if (prop.count_type == kPlyInvalid) {
+        p += ts;
+        continue;
+      }
+      int cs = kPlyTypeSize[prop.count_type];
+      if (end - p < cs)
+        return NULL;
+      int n = (int)PlyValue(p, prop.count_type, swap);
+      p += cs;
+      if (n < 0 || (end - p) / ts < n)
+        return NULL;
+      if ((int)i == list) {
+        idx.resize(n);
+        for (int k = 0; k < n; k++)
+          idx[k] = (int)PlyValue(p + k * ts, prop.type, swap);
+      }
+      p += n * ts;
+    }
+    return p <= end ? p : NULL;
+  }
+
+  static bool ReadPlyBinaryVertices(const char* p, const PlyElement& e, bool swap, ImportData& d)
+  {
+    PlyVertexLayout l;
+    if (!l.Init(e))
+      return false;
+    int nv = e.count, stride = e.stride;
+    int props[8] = { l.x, l.y, l.z, l.nx, l.ny, l.nz, l.u, l.v };
+    PlyType types[8];
+    for (int k = 0; k < 8; k++) {
+      l.offset[k] = 0;
+      types[k] = kPlyFloat32;
+      if (props[k] < 0)
+        continue;
+      for (int i = 0; i < props[k]; i++)
+        l.offset[k] += kPlyTypeSize[e.props[i].type];
+      types[k] = e.props[props[k]].type;
+    }
+    d.positions.resize(3 * (size_t)nv);
+    if (l.nx >= 0)
+      d.normals.resize(3 * (size_t)nv);
+    if (l.u >= 0)
+      d.texcoords.resize(2 * (size_t)nv);
+    bool fast = !swap && types[0] == kPlyFloat32 && types[1] == kPlyFloat32 && types[2] == kPlyFloat32;
+#pragma omp parallel for
+    for (int i = 0; i < nv; i++) {
+      const char* r = p + (size_t)i * stride;
+      if (fast) {
+        memcpy(&d.positions[3 * i], r + l.offset[0], sizeof(float));
+        memcpy(&d.positions[3 * i + 1], r + l.offset[1], sizeof(float));
+        memcpy(&d.positions[3 * i + 2], r + l.offset[2], sizeof(float));
+      }
+      else {
+        for (int k = 0; k < 3; k++)
+          d.positions[3 * i + k] = (float)PlyValue(r + l.offset[k], types[k], swap);
+      }
+      if (l.nx >= 0) {
+        for (int k = 0; k < 3; k++)
+          d.normals[3 * i + k] = (float)PlyValue(r + l.offset[3 + k], types[3 + k], swap);
+      }
+      if (l.u >= 0) {
+        for (int k = 0; k < 2; k++)
+          d.texcoords[2 * i + k] = (float)PlyValue(r + l.offset[6 + k], types[6 + k], swap);
+      }
+    }
+    return true;
+  }
+
+  static bool ReadPlyBinaryFaces(const char* p, const char* end, const PlyElement& e, bool swap, ImportData& d)
+  {
+    int list = FaceIndexProperty(e);
+    if (list < 0)
+      return false;
+    int nf = e.count;
+    const PlyProperty& prop = e.props[list];
+    int cs = kPlyTypeSize[prop.count_type], ts = kPlyTypeSize[prop.type];
+
+    // the common case, triangles with nothing but the index list, has fixed size
+    // records: check that every count is 3 and read them in parallel
+    if (e.props.size() == 1) {
+      int stride = cs + 3 * ts;
+      if ((size_t)(end - p) / stride >= (size_t)nf) {
+        int bad = 0;
+#pragma omp parallel for reduction(+:bad)
+        for (int i = 0; i < nf; i++) {
+          const char* r = p + (size_t)i * stride;
+          bad += (cs == 1) ? *r != 3 : PlyValue(r, prop.count_type, swap) != 3.0;
+        }
+        if (!bad) {
+          d.triangles.resize(3 * (size_t)nf);
+          bool raw = !swap && (prop.type == kPlyInt32 || prop.type == kPlyUInt32);
+#pragma omp parallel for
+          for (int i = 0; i < nf; i++) {
+            const char* r = p + (size_t)i * stride + cs;
+            if (raw)
+              memcpy(&d.triangles[3 * i], r, 3 * sizeof(int));
+            else {
+              for (int k = 0; k < 3; k++)
+                d.triangles[3 * i + k] = (int)PlyValue(r + k * ts, prop.type, swap);
+            }
+          }
+          return true;
+        }
+      }
+    }
+
+    // polygons or extra properties: records must be walked in order
+    std::vector<int> idx;
+    d.triangles.clear();
+    d.triangles.reserve(3 * (size_t)nf);
+    for (int i = 0; i < nf; i++) {
+      p = PlyBinaryFace(p, end, e, list, swap, idx);
+      if (!p)
+        return false;
+      for (int k = 2; k < (int)idx.size(); k++) {
+        d.triangles.push_back(idx[0]);
+        d.triangles.push_back(idx[k - 1]);
+        d.triangles.push_back(idx[k]);
+      }
+    }
+    return true;
+  }
+
+  static bool ReadPlyBinary(const PlyHeader& h, const char* end, ImportData& d)
+  {
+    bool swap = h.format == PlyHeader::kBinaryBE;
+    const char* p = h.body;
+    bool has_vertices = false, has_faces = false;
+    std::vector<int> idx;
+    for (size_t i = 0; i < h.elements.size(); i++) {
+      const PlyElement& e = h.elements[i];
+      if (e.name == "vertex") {
+        if (!e.stride || (size_t)(end - p) / e.stride < (size_t)e.count || !ReadPlyBinaryVertices(p, e, swap, d))
+          return false;
+        p += (size_t)e.count * e.stride;
+        has_vertices = true;
+      }
+      else if (e.name == "face") {
+        if (!ReadPlyBinaryFaces(p, end, e, swap, d))
+          return false;
+        has_faces = true;
+        if (i + 1 == h.elements.size())
+          break;
+        // find the end of the face records for the elements that follow
+        for (int k = 0; k < e.count && p; k++)
+          p = PlyBinaryFace(p, end, e, -1, swap, idx);
+        if (!p)
+          return false;
+      }
+      else if (e.stride) {
+        if ((size_t)(end - p) / e.stride < (size_t)e.count)
+          return false;
+        p += (size_t)e.count * e.stride;
+      }
+      else {
+        for (int k = 0; k < e.count && p; k++)
+          p = PlyBinaryFace(p, end, e, -1, swap, idx);
+        if (!p)
+          return false;
+      }
+    }
+    return has_vertices && has_faces;
+  }
+
+  /**
+  * Triangles of an ascii face record, written to out if not NULL.
+  * @return: number of triangles.
+  */
+  static int PlyAsciiFace(const char* p, const char* le, const PlyElement& e, int list, int* out)
+  {
+    int tris = 0;
+    int first = 0, prev = 0;
+    for (int i = 0; i < (int)e.props.size(); i++) {
+      if (e.props[i].count_type == kPlyInvalid) {
+        p = SkipToken(SkipSpaces(p, le), le);
+        continue;
+      }
+      int n;
+      p = ParseInt(p, le, n);
+      for (int k = 0; k < n; k++) {
+        if (i != list) {
+          p = SkipToken(SkipSpaces(p, le), le);
+          continue;
+        }
+        int v = -1;
+        p = SkipSpaces(p, le);
+        if (p < le)
+          p = ParseInt(p, le, v);
+        if (k == 0)
+          first = v;
+        else if (k >= 2) {
+          if (out) {
+            out[3 * tris] = first; out[3 * tris + 1] = prev; out[3 * tris + 2] = v;
+          }
+          tris++;
+        }
+        prev = v;
+      }
+    }
+    return tris;
+  }
+
+  static bool ReadPlyAscii(const PlyHeader& h, const char* end, ImportData& d)
+  {
+    // every record is a non-empty line; element i has the records [first[i], first[i + 1])
+    std::vector<int> first(h.elements.size() + 1, 0);
+    int vertex = -1, face = -1;
+    for (size_t i = 0; i < h.elements.size(); i++) {
+      first[i + 1] = first[i] + h.elements[i].count;
+      if (h.elements[i].name == "vertex") vertex = (int)i;
+      if (h.elements[i].name == "face") face = (int)i;
+    }
+    if (vertex < 0 || face < 0)
+      return false;
+    const PlyElement& ve = h.elements[vertex];
+    const PlyElement& fe = h.elements[face];
+    PlyVertexLayout l;
+    int list = FaceIndexProperty(fe);
+    if (!l.Init(ve) || list < 0)
+      return false;
+
+    std::vector<const char*> cuts = SplitLines(h.body, end);
+    int nc = (int)cuts.size() - 1;
+    std::vector<int> records(nc, 0), tris(nc, 0);
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < nc; i++) {
+      for (const char* p = cuts[i]; p < cuts[i + 1];) {
+        const char* next = NextLine(p, cuts[i + 1]);
+        const char* q = SkipSpaces(p, next);
+        if (q < LineEnd(q, next))
+          records[i]++;
+        p = next;
+      }
+    }
+    std::vector<int> at = records;
+    PrefixSum(at);
+    // triangles per chunk, counted on the face records only
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < nc; i++) {
+      int r = at[i];
+      if (r + records[i] <= first[face] || r >= first[face + 1])
+        continue;
+      for (const char* p = cuts[i]; p < cuts[i + 1];) {
+        const char* next = NextLine(p, cuts[i + 1]);
+        const char* le = LineEnd(p, next);
+        const char* q = SkipSpaces(p, le);
+        if (q < le) {
+          if (r >= first[face] && r < first[face + 1])
+            tris[i] += PlyAsciiFace(q, le, fe, list, NULL);
+          r++;
+        }
+        p = next;
+      }
+    }
+    int ntris = PrefixSum(tris);
+
+    int nv = ve.count;
+    d.positions.resize(3 * (size_t)nv);
+    if (l.nx >= 0)
+      d.normals.resize(3 * (size_t)nv);
+    if (l.u >= 0)
+      d.texcoords.resize(2 * (size_t)nv);
+    d.triangles.resize(3 * (size_t)ntris);
+    int nprops = (int)ve.props.size();
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < nc; i++) {
+      int r = at[i];
+      int t = tris[i];
+      std::vector<float> values(nprops);
+      for (const char* p = cuts[i]; p < cuts[i + 1];) {
+        const char* next = NextLine(p, cuts[i + 1]);
+        const char* le = LineEnd(p, next);
+        const char* q = SkipSpaces(p, le);
+        if (q < le) {
+          if (r >= first[vertex] && r < first[vertex + 1]) {
+            int v = r - first[vertex];
+            for (int k = 0; k < nprops; k++)
+              q = ParseFloat(q, le, values[k]);
+            d.positions[3 * v] = values[l.x];
+            d.positions[3 * v + 1] = values[l.y];
+            d.positions[3 * v + 2] = values[l.z];
+            if (l.nx >= 0) {
+              d.normals[3 * v] = values[l.nx];
+              d.normals[3 * v + 1] = values[l.ny];
+              d.normals[3 * v + 2] = values[l.nz];
+            }
+            if (l.u >= 0) {
+              d.texcoords[2 * v] = values[l.u];
+              d.texcoords[2 * v + 1] = values[l.v];
+            }
+          }
+          else if (r >= first[face] && r < first[face + 1])
+            t += PlyAsciiFace(q, le, fe, list, &d.triangles[3 * (size_t)t]);
+          r++;
+        }
+        p = next;
+      }
+    }
+    // the file must have at least the vertex and face records the header announces
+    int total = at[nc - 1] + records[nc - 1];
+    return total >= first[vertex + 1] && total >= first[face + 1];
+  }
+
+  static bool ReadPly(const char* begin, const char* end, ImportData& d)
+  {
+    PlyHeader h;
+    h.format = PlyHeader::kAscii;
+    h.body = NULL;
+    if (!ParsePlyHeader(begin, end, h))
+      return false;
+    for (size_t i = 0; i < h.elements.size(); i++)
+      h.elements[i].stride = PlyStride(h.elements[i]);
+    if (h.format == PlyHeader::kAscii)
+      return ReadPlyAscii(h, end, d);
+    return ReadPlyBinary(h, end, d);
+  }
+
+  //--------------------------------------------------------------------------- STL
+
+  static inline uint32_t FloatBits(float f)
+  {
+    f += 0.0f; // -0 and +0 are the same point
+    uint32_t b;
+    memcpy(&b, &f, sizeof(b));
+    return b;
+  }
+
+  static inline uint64_t PointKey(const float* p)
+  {
+    const uint64_t kMul = 0x9E3779B97F4A7C15ULL;
+    uint64_t h = FloatBits(p[0]);
+    h = (h * kMul) ^ FloatBits(p[1]);
+    h = (h * kMul) ^ FloatBits(p[2]);
+    h *= kMul;
+    return h ^ (h >> 31);
+  }
+
+  static inline bool SamePoint(const float* a, const float* b)
+  {
+    return FloatBits(a[0]) == FloatBits(b[0]) && FloatBits(a[1]) == FloatBits(b[1]) && FloatBits(a[2]) == FloatBits(b[2]);
+  }
+
+  struct CornerKey
+  {
+    uint64_t key;
+    int corner;
+    bool operator<(const CornerKey& b) const { return key < b.key || (key == b.key && corner < b.corner); }
+  };
+
+  /**
+  * Merges the corners (x, y, z each) that are at the same position into vertices,
+  * numbered in the order of their first corner. The corners are bucketed by the top
+  * bits of a hash of their position and the buckets are sorted in parallel.
+  */
+  static void WeldCorners(const std::vector<float>& corners, ImportData& d)
+  {
+    int nc = (int)(corners.size() / 3);
+    const int kBucketBits = 12, nb = 1 << kBucketBits;
+    std::vector<CornerKey> keys(nc), sorted(nc);
+#pragma omp parallel for
+    for (int c = 0; c < nc; c++) {
+      keys[c].key = PointKey(&corners[3 * c]);
+      keys[c].corner = c;
+    }
+
+    // counting sort on the bucket, one histogram per thread for a stable scatter;
+    // each thread counts and scatters the same range of corners, in one region so
+    // the team and its ranges cannot change between the two
+    std::vector<int> hist;
+    std::vector<int> bucket(nb + 1, 0);
+#pragma omp parallel
+    {
+      int nt = omp_get_num_threads(), t = omp_get_thread_num();
+      int first = (int)((int64_t)nc * t / nt), last = (int)((int64_t)nc * (t + 1) / nt);
+#pragma omp single
+      hist.assign((size_t)nt * nb, 0);
+
+      int* h = &hist[(size_t)t * nb];
+      for (int c = first; c < last; c++)
+        h[(int)(keys[c].key >> (64 - kBucketBits))]++;
+#pragma omp barrier
+
+#pragma omp single
+      {
+        int sum = 0;
+        for (int b = 0; b < nb; b++) {
+          bucket[b] = sum;
+          for (int u = 0; u < nt; u++) {
+            int n = hist[(size_t)u * nb + b];
+            hist[(size_t)u * nb + b] = sum;
+            sum += n;
+          }
+        }
+        bucket[nb] = sum;
+      }
+
+      for (int c = first; c < last; c++)
+        sorted[h[(int)(keys[c].key >> (64 - kBucketBits))]++] = keys[c];
+    }
+
+    // within a run of equal hashes the positions are compared exactly, the
+    // representative of a vertex is its first corner
+    std::vector<int> rep(nc);
+#pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < nb; b++) {
+      CornerKey* s = sorted.empty() ? NULL : &sorted[0];
+      std::sort(s + bucket[b], s + bucket[b + 1]);
+      for (int i = bucket[b]; i < bucket[b + 1];) {
+        int j = i;
+        while (j < bucket[b + 1] && s[j].key == s[i].key)
+          j++;
+        for (int k = i; k < j; k++) {
+          int c = s[k].corner;
+          rep[c] = c;
+          for (int m = i; m < k; m++) {
+            if (SamePoint(&corners[3 * c], &corners[3 * s[m].corner])) {
+              rep[c] = rep[s[m].corner];
+              break;
+            }
+          }
+        }
+        i = j;
+      }
+    }
+
+    std::vector<int> id(nc);
+    int nv = 0;
+    for (int c = 0; c < nc; c++)
+      id[c] = (rep[c] == c) ? nv++ : -1;
+    d.positions.resize(3 * (size_t)nv);
+    d.triangles.resize(nc);
+#pragma omp parallel for
+    for (int c = 0; c < nc; c++) {
+      int v = id[rep[c]];
+      d.triangles[c] = v;
+      if (rep[c] == c)
+        memcpy(&d.positions[3 * v], &corners[3 * c], 3 * sizeof(float));
+    }
+  }
+
+  static bool ReadStlBinary(const char* begin, const char* end, ImportData& d)
+  {
+    uint32_t n;
+    memcpy(&n, begin + 80, sizeof(n));
+    if ((size_t)(end - begin - 84) / 50 < n)
+      return false;
+    int nt = (int)n;
+    std::vector<float> corners(9 * (size_t)nt);
+    const char* p = begin + 84;
+#pragma omp parallel for
+    for (int t = 0; t < nt; t++) // facet normal, 3 corners, attribute
+      memcpy(&corners[9 * (size_t)t], p + (size_t)t * 50 + 12, 9 * sizeof(float));
+    WeldCorners(corners, d);
+    return true;
+  }
+
+  static inline bool IsStlVertex(const char* p, const char* le)
+  {
+    return le - p > 6 && memcmp(p, "vertex", 6) == 0 && IsSpace(p[6]);
+  }
+
+  static bool ReadStlAscii(const char* begin, const char* end, ImportData& d)
+  {
+    std::vector<const char*> cuts = SplitLines(begin, end);
+    int nc = (int)cuts.size() - 1;
+    std::vector<int> at(nc, 0);
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < nc; i++) {
+      for (const char* p = cuts[i]; p < cuts[i + 1];) {
+        const char* next = NextLine(p, cuts[i + 1]);
+        at[i] += IsStlVertex(SkipSpaces(p, next), LineEnd(p, next));
+        p = next;
+      }
+    }
+    int n = PrefixSum(at);
+    if (n == 0 || n % 3 != 0)
+      return false;
+    std::vector<float> corners(3 * (size_t)n);
+#pragma omp parallel for schedule(dynamic)
+    for (int i = 0; i < nc; i++) {
+      int c = at[i];
+      for (const char* p = cuts[i]; p < cuts[i + 1];) {
+        const char* next = NextLine(p, cuts[i + 1]);
+        const char* le = LineEnd(p, next);
+        const char* q = SkipSpaces(p, next);
+        if (IsStlVertex(q, le)) {
+          float* v = &corners[3 * (size_t)c++];
+          q = ParseFloat(q + 6, le, v[0]);
+          q = ParseFloat(q, le, v[1]);
+          ParseFloat(q, le, v[2]);
+        }
+        p = next;
+      }
+    }
+    WeldCorners(corners, d);
+    return true;
+  }
+
+  static bool ReadStl(const char* begin, const char* end, ImportData& d)
+  {
+    // a binary file may start with "solid" too, its size decides
+    size_t size = end - begin;
+    if (size >= 84) {
+      uint32_t n;
+      memcpy(&n, begin + 80, sizeof(n));
+      if ((size - 84) / 50 == n && (size - 84) % 50 == 0)
+        return ReadStlBinary(begin, end, d);
+    }
+    if (size >= 5 && memcmp(begin, "solid", 5) == 0)
+      return ReadStlAscii(begin, end, d);
+    return false;
+  }
+
+  //---------------------------------------------------------------- connectivity
+
+  /**
+  * Builds the half-edge structure of d in mesh from the sorted edge list: the
+  * corners (directed edges) are counting sorted by their smaller vertex, and then
+  * by the larger one within each vertex, so the two sides of every edge end up
+  * next to each other. Edge e gets halfedges 2e and 2e + 1, the side of a boundary
+  * edge without a face is linked into its boundary loop.
+  * @return: false if the mesh is not manifold (an edge with more than two faces or
+  * two faces of the same orientation, or a vertex with several fans); mesh is not
+  * touched then.
+  */
+  static bool BuildConnectivity(const ImportData& d, TriMesh* mesh)
+  {
+    const std::vector<int>& tri = d.triangles;
+    int nv = d.VertexCount(), nt = d.TriangleCount(), nc = 3 * nt;
+
+    // corners by smaller vertex, then by larger vertex
+    std::vector<int> start(nv + 1, 0), order(nc);
+    for (int c = 0; c < nc; c++) {
+      int a = tri[c], b = tri[c - c % 3 + (c + 1) % 3];
+      start[MIN(a, b) + 1]++;
+    }
+    for (int v = 0; v < nv; v++)
+      start[v + 1] += start[v];
+    {
+      std::vector<int> fill(start.begin(), start.end() - 1);
+      for (int c = 0; c < nc; c++) {
+        int a = tri[c], b = tri[c - c % 3 + (c + 1) % 3];
+        order[fill[MIN(a, b)]++] = c;
+      }
+    }
+
+    // edges per vertex, and the manifold check of the edges
+    std::vector<int> edges(nv, 0);
+    int bad = 0;
+#pragma omp parallel reduction(+:bad)
+    {
+      std::vector<std::pair<int, int> > run;
+#pragma omp for schedule(dynamic, 1024)
+      for (int v = 0; v < nv; v++) {
+        int* o = order.empty() ? NULL : &order[0];
+        int s = start[v], e = start[v + 1];
+        run.clear();
+        for (int i = s; i < e; i++) {
+          int c = o[i];
+          int a = tri[c], b = tri[c - c % 3 + (c + 1) % 3];
+          run.push_back(std::make_pair(MAX(a, b), c));
+        }
+        std::sort(run.begin(), run.end());
+        for (int i = 0; i < e - s;) {
+          int j = i + 1;
+          while (j < e - s && run[j].first == run[i].first)
+            j++;
+          if (j - i > 2 || (j - i == 2 && tri[run[i].second] == tri[run[i + 1].second]))
+            bad++;
+          edges[v]++;
+          i = j;
+        }
+        for (int i = 0; i < e - s; i++)
+          o[s + i] = run[i].second;
+      }
+    }
+    if (bad)
+      return false;
+    int ne = PrefixSum(edges), nh = 2 * ne;
+
+    // halfedge of every corner; to vertex, next and face of every halfedge
+    std::vector<int> corner_he(nc), to(nh), next(nh, -1), face(nh, -1);
+#pragma omp parallel for schedule(dynamic, 1024)
+    for (int v = 0; v < nv; v++) {
+      int s = start[v], e = start[v + 1];
+      int edge = edges[v];
+      for (int i = s; i < e;) {
+        int c = order[i];
+        int a = tri[c], b = tri[c - c % 3 + (c + 1) % 3];
+        int hi = MAX(a, b);
+        corner_he[c] = 2 * edge;
+        if (i + 1 < e) {
+          int c2 = order[i + 1];
+          int a2 = tri[c2], b2 = tri[c2 - c2 % 3 + (c2 + 1) % 3];
+          if (MAX(a2, b2) == hi) {
+            corner_he[c2] = 2 * edge + 1;
+            i += 2;
+            edge++;
+            continue;
+          }
+        }
+        // boundary edge: the other side runs from b to a
+        to[2 * edge + 1] = a;
+        i++;
+        edge++;
+      }
+    }
+#pragma omp parallel for
+    for (int c = 0; c < nc; c++) {
+      int n = c - c % 3 + (c + 1) % 3;
+      int h = corner_he[c];
+      to[h] = tri[n];
+      face[h] = c / 3;
+      next[h] = corner_he[n];
+    }
+
+    // boundary loops: a manifold vertex has at most one outgoing boundary halfedge
+    std::vector<int> vertex_he(nv, -1), degree(nv, 0);
+    for (int h = 0; h < nh; h++) {
+      if (face[h] >= 0)
+        continue;
+      int from = to[h ^ 1];
+      if (vertex_he[from] >= 0)
+        return false;
+      vertex_he[from] = h;
+      degree[from]++;
+    }
+    for (int h = 0; h < nh; h++) {
+      if (face[h] >= 0)
+        continue;
+      next[h] = vertex_he[to[h]];
+      if (next[h] < 0)
+        return false;
+    }
+    for (int c = 0; c < nc; c++) {
+      degree[tri[c]]++;
+      if (vertex_he[tri[c]] < 0)
+        vertex_he[tri[c]] = corner_he[c];
+    }
+
+    // every outgoing halfedge of a vertex must be reached by rotating around it
+#pragma omp parallel for schedule(dynamic, 1024) reduction(+:bad)
+    for (int v = 0; v < nv; v++) {
+      int h0 = vertex_he[v];
+      if (h0 < 0)
+        continue;
+      int n = 0, h = h0;
+      do {
+        n++;
+        h = next[h ^ 1];
+      } while (h != h0 && n <= degree[v]);
+      bad += n != degree[v];
+    }
+    if (bad)
+      return false;
+
+    mesh->clean();
+    mesh->resize(nv, ne, nt);
+#pragma omp parallel for
+    for (int v = 0; v < nv; v++)
+      mesh->set_halfedge_handle(TriMesh::VertexHandle(v), TriMesh::HalfedgeHandle(vertex_he[v]));
+#pragma omp parallel for
+    for (int h = 0; h < nh; h++) {
+      TriMesh::HalfedgeHandle heh(h);
+      mesh->set_vertex_handle(heh, TriMesh::VertexHandle(to[h]));
+      mesh->set_next_halfedge_handle(heh, TriMesh::HalfedgeHandle(next[h]));
+      mesh->set_face_handle(heh, TriMesh::FaceHandle(face[h]));
+    }
+#pragma omp parallel for
+    for (int t = 0; t < nt; t++)
+      mesh->set_halfedge_handle(TriMesh::FaceHandle(t), TriMesh::HalfedgeHandle(corner_he[3 * t]));
+    return true;
+  }
+
+  /**
+  * drops triangles with invalid or repeated vertices, as OpenMesh's add_face refuses them
+  */
+  static void RemoveInvalidTriangles(ImportData& d)
+  {
+    int nv = d.VertexCount(), nt = d.TriangleCount(), n = 0;
+    int* t = d.triangles.empty() ? NULL : &d.triangles[0];
+    for (int i = 0; i < nt; i++) {
+      int a = t[3 * i], b = t[3 * i + 1], c = t[3 * i + 2];
+      if (a < 0 || b < 0 || c < 0 || a >= nv || b >= nv || c >= nv || a == b || b == c || a == c)
+        continue;
+      t[3 * n] = a; t[3 * n + 1] = b; t[3 * n + 2] = c;
+      n++;
+    }
+    d.triangles.resize(3 * (size_t)n);
+  }
+
+  static void BuildMesh(ImportData& d, TriMesh* mesh)
+  {
+    RemoveInvalidTriangles(d);
+    int nv = d.VertexCount();
+    if (!BuildConnectivity(d, mesh)) {
+      // non-manifold input: let OpenMesh sort it out face by face
+      std::cout << "Mesh is not manifold, adding faces one by one\n";
+      mesh->clean();
+      mesh->reserve(nv, 3 * d.TriangleCount() / 2, d.TriangleCount());
+      for (int v = 0; v < nv; v++)
+        mesh->add_vertex(TriMesh::Point(0, 0, 0));
+      for (int t = 0; t < d.TriangleCount(); t++)
+        mesh->add_face(TriMesh::VertexHandle(d.triangles[3 * t]),
+        TriMesh::VertexHandle(d.triangles[3 * t + 1]),
+        TriMesh::VertexHandle(d.triangles[3 * t + 2]));
+    }
+    if (!nv)
+      return;
+    memcpy((void*)mesh->points(), &d.positions[0], d.positions.size() * sizeof(float));
+    if (mesh->has_vertex_normals() && !d.normals.empty())
+      memcpy((void*)mesh->vertex_normals(), &d.normals[0], d.normals.size() * sizeof(float));
+    if (mesh->has_vertex_texcoords2D()) {
+      if (!d.texcoords.empty())
+        memcpy((void*)mesh->texcoords2D(), &d.texcoords[0], d.texcoords.size() * sizeof(float));
+      else
+        memset((void*)mesh->texcoords2D(), 0, nv * sizeof(TriMesh::TexCoord2D));
+    }
+  }
+
+  //---------------------------------------------------------------- MeshImporter
+
+  static std::string LowerExtension(const std::string& filename)
+  {
+    if (filename.find('.') == std::string::npos)
+      return std::string();
+    std::string ext = IOUtilities::GetExtension(filename);
+    for (size_t i = 0; i < ext.size(); i++)
+      ext[i] = (char)tolower(ext[i]);
+    return ext;
+  }
+
+  bool MeshImporter::CanRead(const std::string& filename)
+  {
+    std::string ext = LowerExtension(filename);
+    return ext == "obj" || ext == "ply" || ext == "stl";
+  }
+
+  bool MeshImporter::Read(const std::string& filename, TriMesh* mesh, OpenMesh::IO::Options* opt)
+  {
+    MappedFile file;
+    if (!file.Open(filename))
+      return false;
+    const char* begin = file.GetData();
+    const char* end = begin + file.GetSize();
+    std::string ext = LowerExtension(filename);
+    ImportData d;
+    bool ok = false;
+    if (ext == "obj")
+      ok = ReadObj(begin, end, d);
+    else if (ext == "ply")
+      ok = ReadPly(begin, end, d);
+    else if (ext == "stl")
+      ok = ReadStl(begin, end, d);
+    if (!ok || d.positions.empty())
+      return false;
+    file.Close();
+
+    OpenMesh::IO::Options wanted = *opt, provided;
+    if (!wanted.check(OpenMesh::IO::Options::VertexNormal))
+      d.normals.clear();
+    if (!wanted.check(OpenMesh::IO::Options::VertexTexCoord))
+      d.texcoords.clear();
+    BuildMesh(d, mesh);
+    if (!d.normals.empty())
+      provided += OpenMesh::IO::Options::VertexNormal;
+    if (!d.texcoords.empty())
+      provided += OpenMesh::IO::Options::VertexTexCoord;
+    *opt = provided;
+    return true;
+  }
+
+  void MeshImporter::Build(const std::vector<float>& positions, const std::vector<float>& normals,
+    const std::vector<float>& texcoords, const std::vector<int>& triangles, TriMesh* mesh)
+  {
+    ImportData d;
+    d.positions = positions;
+    d.normals = normals;
+    d.texcoords = texcoords;
+    d.triangles = triangles;
+    BuildMesh(d, mesh);
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef HJ_MeshImporter_h__
+#define HJ_MeshImporter_h__
+
+#include <string>
+#include <vector>
+#include "meshext.h"
+
+namespace hj
+{
+  class TriMesh;
+
+  /**
+  * Fast reader for OBJ, PLY (ascii and binary) and STL (ascii and binary) files,
+  * used instead of OpenMesh::IO::read_mesh for large scans. The file is memory
+  * mapped and cut into chunks at line or record boundaries that are parsed in
+  * parallel, and the half-edge connectivity is built in one pass over the sorted
+  * edge list instead of inserting the faces one by one.
+  * As with the OpenMesh readers, polygons are split into triangle fans, triangles
+  * with repeated or invalid vertices are dropped and the corners of an STL file
+  * are welded into shared vertices.
+  */
+  class MeshImporter
+  {
+  public:
+    /**
+    * @return: True if the file extension is obj, ply or stl.
+    */
+    static bool CanRead(const std::string& filename);
+
+    /**
+    * Reads a mesh file. The mesh must have its vertex normals and texture coordinates
+    * requested, and should be empty.
+    * @param opt: on input the attributes wanted, on output the ones the file provided,
+    * as for OpenMesh::IO::read_mesh.
+    * @return: True if successful. False if the file cannot be read or is a variant this
+    * reader does not handle (e.g. list properties on PLY vertices); the mesh is left
+    * empty then, and OpenMesh::IO::read_mesh should be used instead.
+    */
+    static bool Read(const std::string& filename, TriMesh* mesh, OpenMesh::IO::Options* opt);
+
+    /**
+    * Builds a mesh from arrays the way Read() does after parsing.
+    * @param normals: x, y, z per vertex, or empty.
+    * @param texcoords: u, v per vertex, or empty.
+    * @param triangles: 3 vertex indices per face.
+    */
+    static void Build(const std::vector<float>& positions, const std::vector<float>& normals,
+      const std::vector<float>& texcoords, const std::vector<int>& triangles, TriMesh* mesh);
+  };
+}
+
+#endif // HJ_MeshImporter_h__
@@ -0,0 +1,162 @@
+#include "MeshReorder.h"
+#include <math.h>
+#include <stdint.h>
+#include <algorithm>
+#include "macro.h"
+
+namespace hj
+{
+  // simulated post-transform cache size, and the score parameters of Forsyth's paper
+  static const int kCacheSize = 32;
+  static const float kLastFaceScore = 0.75f;
+  static const float kCacheDecayPower = 1.5f;
+  static const float kValenceBoostScale = 2.0f;
+  static const float kValenceBoostPower = 0.5f;
+
+  /**
+  * spreads the low 21 bits of x to every third bit
+  */
+  static uint64_t Spread3(uint64_t x)
+  {
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffULL;
+    x = (x | x << 16) & 0x1f0000ff0000ffULL;
+    x = (x | x << 8) & 0x100f00f00f00f00fULL;
+    x = (x | x << 4) & 0x10c30c30c30c30c3ULL;
+    x = (x | x << 2) & 0x1249249249249249ULL;
+    return x;
+  }
+
+  void MeshReorder::VertexOrder(const float* positions, int nv, std::vector<int>& order)
+  {
+    order.resize(nv);
+    if (nv == 0)
+      return;
+    float lo[3], hi[3];
+    for (int c = 0; c < 3; c++)
+      lo[c] = hi[c] = positions[c];
+    for (int i = 1; i < nv; i++) {
+      for (int c = 0; c < 3; c++) {
+        lo[c] = MIN(lo[c], positions[3 * i + c]);
+        hi[c] = MAX(hi[c], positions[3 * i + c]);
+      }
+    }
+    // one scale for all axes keeps the cells cubic
+    float extent = MAX(MAX(hi[0] - lo[0], hi[1] - lo[1]), hi[2] - lo[2]);
+    float scale = extent > 0 ? (float)0x1fffff / extent : 0.0f;
+
+    std::vector<std::pair<uint64_t, int> > keys(nv);
+#pragma omp parallel for
+    for (int i = 0; i < nv; i++) {
+      uint64_t key = 0;
+      for (int c = 0; c < 3; c++)
+        key |= Spread3((uint64_t)((positions[3 * i + c] - lo[c]) * scale)) << c;
+      keys[i] = std::make_pair(key, i);
+    }
+    std::sort(keys.begin(), keys.end());
+    for (int i = 0; i < nv; i++)
+      order[i] = keys[i].second;
+  }
+
+  static float VertexScore(int cache_pos, int remaining)
+  {
+    if (remaining == 0)
+      return -1.0f;
+    float score = 0;
+    if (cache_pos >= 0) {
+      // the vertices of the last face get a fixed score, so that the next face
+      // does not depend on the order the last one was drawn in
+      if (cache_pos < 3)
+        score = kLastFaceScore;
+      else
+        score = powf(1.0f - (float)(cache_pos - 3) / (kCacheSize - 3), kCacheDecayPower);
+    }
+    return score + kValenceBoostScale * powf((float)remaining, -kValenceBoostPower);
+  }
+
+  void MeshReorder::FaceOrder(const std::vector<int>& triangles, int nv, std::vector<int>& order)
+  {
+    int nf = (int)(triangles.size() / 3);
+    order.clear();
+    order.reserve(nf);
+    if (nf == 0)
+      return;
+
+    // faces of every vertex; the first remaining[v] entries are the faces not emitted yet
+    std::vector<int> start(nv + 1, 0), adj(3 * (size_t)nf), remaining(nv, 0);
+    for (int c = 0; c < 3 * nf; c++)
+      remaining[triangles[c]]++;
+    for (int v = 0; v < nv; v++)
+      start[v + 1] = start[v] + remaining[v];
+    {
+      std::vector<int> fill(start.begin(), start.end() - 1);
+      for (int c = 0; c < 3 * nf; c++)
+        adj[fill[triangles[c]]++] = c / 3;
+    }
+
+    std::vector<int> cache_pos(nv, -1);
+    std::vector<float> vscore(nv), fscore(nf);
+    std::vector<unsigned char> emitted(nf, 0);
+    for (int v = 0; v < nv; v++)
+      vscore[v] = VertexScore(-1, remaining[v]);
+    for (int f = 0; f < nf; f++)
+      fscore[f] = vscore[triangles[3 * f]] + vscore[triangles[3 * f + 1]] + vscore[triangles[3 * f + 2]];
+
+    std::vector<int> cache, next_cache;
+    cache.reserve(kCacheSize + 3);
+    next_cache.reserve(kCacheSize + 3);
+    int cursor = 0, best = -1;
+    for (int n = 0; n < nf; n++) {
+      // nothing scored around the cache: continue with the first face left in the old order
+      if (best < 0) {
+        while (emitted[cursor])
+          cursor++;
+        best = cursor;
+      }
+      int f = best;
+      emitted[f] = 1;
+      order.push_back(f);
+      const int* fv = &triangles[3 * f];
+      for (int k = 0; k < 3; k++) {
+        int v = fv[k];
+        int* a = &adj[start[v]];
+        for (int i = 0; i < remaining[v]; i++) {
+          if (a[i] == f) {
+            std::swap(a[i], a[remaining[v] - 1]);
+            break;
+          }
+        }
+        remaining[v]--;
+      }
+
+      // the face's vertices move to the front of the cache, the last ones fall out
+      next_cache.assign(fv, fv + 3);
+      for (size_t i = 0; i < cache.size(); i++) {
+        if (cache[i] != fv[0] && cache[i] != fv[1] && cache[i] != fv[2])
+          next_cache.push_back(cache[i]);
+      }
+      for (int i = 0; i < (int)next_cache.size(); i++)
+        cache_pos[next_cache[i]] = i < kCacheSize ? i : -1;
+      for (size_t i = 0; i < next_cache.size(); i++)
+        vscore[next_cache[i]] = VertexScore(cache_pos[next_cache[i]], remaining[next_cache[i]]);
+
+      best = -1;
+      float best_score = -1;
+      for (size_t i = 0; i < next_cache.size(); i++) {
+        int v = next_cache[i];
+        for (int j = start[v]; j < start[v] + remaining[v]; j++) {
+          int g = adj[j];
+          const int* gv = &triangles[3 * g];
+          fscore[g] = vscore[gv[0]] + vscore[gv[1]] + vscore[gv[2]];
+          if (cache_pos[v] >= 0 && fscore[g] > best_score) {
+            best_score = fscore[g];
+            best = g;
+          }
+        }
+      }
+      if (next_cache.size() > (size_t)kCacheSize)
+        next_cache.resize(kCacheSize);
+      cache.swap(next_cache);
+    }
+  }
+}
@@ -0,0 +1,36 @@
+#ifndef HJ_MeshReorder_h__
+#define HJ_MeshReorder_h__
+
+#include <vector>
+
+namespace hj
+{
+  /**
+  * Vertex and face orders that improve memory locality. Scanners write vertices in
+  * acquisition order, so the one-ring of a vertex is scattered over the arrays and
+  * the renderer's post-transform vertex cache misses most of the time.
+  */
+  class MeshReorder
+  {
+  public:
+    /**
+    * Orders the vertices along a Morton (Z-order) curve through their bounding box,
+    * so vertices close in space are close in memory.
+    * @param positions: x, y, z per vertex.
+    * @param order: receives the old index of every vertex in the new order.
+    */
+    static void VertexOrder(const float* positions, int nv, std::vector<int>& order);
+
+    /**
+    * Orders the faces for a post-transform vertex cache with Forsyth's linear-speed
+    * optimization: the next face is the best scored one around the simulated cache,
+    * which favors faces whose vertices were just used and vertices with few faces
+    * left.
+    * @param triangles: 3 vertex indices per face.
+    * @param order: receives the old index of every face in the new order.
+    */
+    static void FaceOrder(const std::vector<int>& triangles, int nv, std::vector<int>& order);
+  };
+}
+
+#endif // HJ_MeshReorder_h__
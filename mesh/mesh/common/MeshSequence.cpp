@@ -0,0 +1,381 @@
+#include "MeshSequence.h"
+#include <math.h>
+#include <string.h>
+#include "macro.h"
+#include "TriMesh.h"
+
+namespace hj
+{
+  static const char kMagic[4] = { 'H', 'J', 'M', 'S' };
+  static const uint32_t kVersion = 1;
+
+  // largest offset from the rest pose, in quantization steps, a frame may have
+  static const int64_t kMaxOffset = 1 << 30;
+
+  struct MeshSequenceHeader
+  {
+    char magic[4];
+    uint32_t version;
+    uint32_t n_vertices;
+    uint32_t n_faces;
+    uint32_t frame_count;
+    uint32_t chunk_vertices;
+    float step;
+    uint32_t reserved;
+    uint64_t faces_offset;  // uint32 v0, v1, v2 per face
+    uint64_t rest_offset;   // float x, y, z per vertex
+    uint64_t index_offset;  // uint64 offset, size per frame
+  };
+
+  static size_t ChunkCount(size_t n_vertices)
+  {
+    return (n_vertices + MeshSequenceWriter::kChunkVertices - 1) / MeshSequenceWriter::kChunkVertices;
+  }
+
+  static void PutVarint(std::vector<unsigned char>& out, uint64_t v)
+  {
+    while (v >= 0x80) {
+      out.push_back((unsigned char)(v | 0x80));
+      v >>= 7;
+    }
+    out.push_back((unsigned char)v);
+  }
+
+  static bool GetVarint(const unsigned char*& p, const unsigned char* end, uint64_t& v)
+  {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+      unsigned char b = *p++;
+      v |= (uint64_t)(b & 0x7f) << shift;
+      if (!(b & 0x80))
+        return true;
+    }
+    return false;
+  }
+
+  /**
+  * Codes the quantized offsets of n vertices: a run of vertices equal to their
+  * predecessor, then the zigzag residual of the next vertex, and so on.
+  */
+  static void EncodeChunk(const int32_t* d, size_t n, std::vector<unsigned char>& out)
+  {
+    out.clear();
+    int64_t prev[3] = { 0, 0, 0 };
+    uint64_t run = 0;
+    for (size_t i = 0; i < n; i++) {
+      const int32_t* q = d + 3 * i;
+      if (q[0] == prev[0] && q[1] == prev[1] && q[2] == prev[2]) {
+        run++;
+        continue;
+      }
+      PutVarint(out, run);
+      run = 0;
+      for (int c = 0; c < 3; c++) {
+        int64_t r = q[c] - prev[c];
+        PutVarint(out, ((uint64_t)r << 1) ^ (uint64_t)(r >> 63));
+        prev[c] = q[c];
+      }
+    }
+    if (run)
+      PutVarint(out, run);
+  }
+
+  /**
+  * Decodes n vertices of a chunk to positions, rest + offset * step.
+  */
+  static bool DecodeChunk(const unsigned char* p, const unsigned char* end, size_t n,
+    const float* rest, float step, float* positions)
+  {
+    int64_t prev[3] = { 0, 0, 0 };
+    size_t i = 0;
+    while (i < n) {
+      uint64_t run;
+      if (!GetVarint(p, end, run) || run > n - i)
+        return false;
+      for (size_t k = i; k < i + (size_t)run; k++) {
+        for (int c = 0; c < 3; c++)
+          positions[3 * k + c] = rest[3 * k + c] + (float)prev[c] * step;
+      }
+      i += (size_t)run;
+      if (i == n)
+        break;
+      for (int c = 0; c < 3; c++) {
+        uint64_t z;
+        if (!GetVarint(p, end, z))
+          return false;
+        prev[c] += (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+        positions[3 * i + c] = rest[3 * i + c] + (float)prev[c] * step;
+      }
+      i++;
+    }
+    return p == end;
+  }
+
+  //----------------------------------------------------------- MeshSequenceWriter
+
+  MeshSequenceWriter::MeshSequenceWriter()
+    : pos_(0)
+    , faces_offset_(0)
+    , rest_offset_(0)
+    , face_count_(0)
+    , step_(0)
+  {
+  }
+
+  MeshSequenceWriter::~MeshSequenceWriter()
+  {
+    if (out_.is_open())
+      Close();
+  }
+
+  static void WritePadded(std::ofstream& out, uint64_t& pos, const void* data, size_t size)
+  {
+    static const char zeros[8] = { 0 };
+    if (size)
+      out.write((const char*)data, size);
+    pos += size;
+    size_t pad = (size_t)((8 - pos % 8) % 8);
+    out.write(zeros, pad);
+    pos += pad;
+  }
+
+  bool MeshSequenceWriter::Open(const std::string& filename, const TriMesh& rest, float step)
+  {
+    if (out_.is_open())
+      Close();
+    size_t nv = rest.n_vertices(), nf = rest.n_faces();
+    rest_.assign((const float*)rest.points(), (const float*)rest.points() + 3 * nv);
+
+    std::vector<uint32_t> faces;
+    if (rest.triangleIndices().size() == 3 * nf)
+      faces.assign(rest.triangleIndices().begin(), rest.triangleIndices().end());
+    else {
+      for (TriMesh::ConstFaceIter f_it = rest.faces_begin(); f_it != rest.faces_end(); ++f_it) {
+        for (TriMesh::ConstFaceVertexIter fv_it = rest.cfv_iter(f_it.handle()); fv_it.is_valid(); ++fv_it)
+          faces.push_back(fv_it.handle().idx());
+      }
+      if (faces.size() != 3 * nf)
+        return false;
+    }
+
+    if (step <= 0) {
+      Point lo(0, 0, 0), hi(0, 0, 0);
+      for (size_t i = 0; i < nv; i++) {
+        Point p(rest_[3 * i], rest_[3 * i + 1], rest_[3 * i + 2]);
+        if (i == 0)
+          lo = hi = p;
+        lo.minimize(p);
+        hi.maximize(p);
+      }
+      step = (hi - lo).norm() / 65536;
+      if (step <= 0)
+        step = kEpsilonFloat;
+    }
+    step_ = step;
+
+    out_.open(filename.c_str(), std::ios::binary | std::ios::trunc);
+    if (!out_)
+      return false;
+    MeshSequenceHeader h;
+    memset(&h, 0, sizeof(h));
+    pos_ = 0;
+    WritePadded(out_, pos_, &h, sizeof(h)); // rewritten by Close()
+    faces_offset_ = pos_;
+    WritePadded(out_, pos_, faces.empty() ? nullptr : &faces[0], faces.size() * sizeof(uint32_t));
+    rest_offset_ = pos_;
+    WritePadded(out_, pos_, rest_.empty() ? nullptr : &rest_[0], rest_.size() * sizeof(float));
+    face_count_ = (uint32_t)nf;
+    frames_.clear();
+    chunks_.resize(ChunkCount(nv));
+    return !!out_;
+  }
+
+  bool MeshSequenceWriter::AddFrame(const float* positions)
+  {
+    if (!out_.is_open())
+      return false;
+    int nv = (int)(rest_.size() / 3);
+    std::vector<int32_t> d(3 * (size_t)nv);
+    int bad = 0;
+#pragma omp parallel for reduction(+:bad)
+    for (int i = 0; i < 3 * nv; i++) {
+      double q = floor(((double)positions[i] - rest_[i]) / step_ + 0.5);
+      // also false for NaN
+      if (fabs(q) <= (double)kMaxOffset)
+        d[i] = (int32_t)q;
+      else
+        bad++;
+    }
+    // the offsets of the frame cannot be coded, nothing is written
+    if (bad)
+      return false;
+
+    int nc = (int)chunks_.size();
+#pragma omp parallel for schedule(dynamic)
+    for (int c = 0; c < nc; c++) {
+      size_t first = (size_t)c * kChunkVertices;
+      EncodeChunk(&d[3 * first], MIN((size_t)kChunkVertices, (size_t)nv - first), chunks_[c]);
+    }
+
+    // chunk count and sizes, then the chunks
+    std::vector<uint32_t> table(1 + nc);
+    table[0] = (uint32_t)nc;
+    for (int c = 0; c < nc; c++)
+      table[1 + c] = (uint32_t)chunks_[c].size();
+    uint64_t offset = pos_;
+    out_.write((const char*)&table[0], table.size() * sizeof(uint32_t));
+    pos_ += table.size() * sizeof(uint32_t);
+    for (int c = 0; c < nc; c++) {
+      if (!chunks_[c].empty())
+        out_.write((const char*)&chunks_[c][0], chunks_[c].size());
+      pos_ += chunks_[c].size();
+    }
+    frames_.push_back(offset);
+    frames_.push_back(pos_ - offset);
+    WritePadded(out_, pos_, nullptr, 0);
+    return !!out_;
+  }
+
+  bool MeshSequenceWriter::AddFrame(const TriMesh& mesh)
+  {
+    if (mesh.n_vertices() * 3 != rest_.size())
+      return false;
+    return AddFrame((const float*)mesh.points());
+  }
+
+  bool MeshSequenceWriter::Close()
+  {
+    if (!out_.is_open())
+      return false;
+    MeshSequenceHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, kMagic, sizeof(kMagic));
+    h.version = kVersion;
+    h.n_vertices = (uint32_t)(rest_.size() / 3);
+    h.n_faces = face_count_;
+    h.frame_count = (uint32_t)GetFrameCount();
+    h.chunk_vertices = kChunkVertices;
+    h.step = step_;
+    h.faces_offset = faces_offset_;
+    h.rest_offset = rest_offset_;
+    h.index_offset = pos_;
+    WritePadded(out_, pos_, frames_.empty() ? nullptr : &frames_[0], frames_.size() * sizeof(uint64_t));
+    out_.seekp(0);
+    out_.write((const char*)&h, sizeof(h));
+    out_.close();
+    bool ok = !out_.fail();
+    frames_.clear();
+    return ok;
+  }
+
+  //----------------------------------------------------------- MeshSequenceReader
+
+  MeshSequenceReader::MeshSequenceReader()
+    : frame_count_(0)
+    , vertex_count_(0)
+    , face_count_(0)
+    , step_(0)
+    , faces_(nullptr)
+    , rest_(nullptr)
+    , index_(nullptr)
+  {
+  }
+
+  bool MeshSequenceReader::Open(const std::string& filename)
+  {
+    Close();
+    if (!file_.Open(filename) || file_.GetSize() < sizeof(MeshSequenceHeader))
+      return false;
+    const char* data = file_.GetData();
+    size_t size = file_.GetSize();
+    MeshSequenceHeader h;
+    memcpy(&h, data, sizeof(h));
+    uint64_t nv = h.n_vertices, nf = h.n_faces, frames = h.frame_count;
+    if (memcmp(h.magic, kMagic, sizeof(kMagic)) != 0 || h.version != kVersion
+      || h.chunk_vertices != MeshSequenceWriter::kChunkVertices || !(h.step > 0)
+      || h.faces_offset % 8 || h.rest_offset % 8 || h.index_offset % 8
+      || h.faces_offset > size || nf * 3 * sizeof(uint32_t) > size - h.faces_offset
+      || h.rest_offset > size || nv * 3 * sizeof(float) > size - h.rest_offset
+      || h.index_offset > size || frames * 2 * sizeof(uint64_t) > size - h.index_offset) {
+      Close();
+      return false;
+    }
+    faces_ = (const uint32_t*)(data + (size_t)h.faces_offset);
+    rest_ = (const float*)(data + (size_t)h.rest_offset);
+    index_ = (const uint64_t*)(data + (size_t)h.index_offset);
+    for (size_t i = 0; i < 3 * (size_t)nf; i++) {
+      if (faces_[i] >= nv) {
+        Close();
+        return false;
+      }
+    }
+    for (size_t f = 0; f < (size_t)frames; f++) {
+      if (index_[2 * f] > size || index_[2 * f + 1] > size - index_[2 * f]) {
+        Close();
+        return false;
+      }
+    }
+    frame_count_ = (size_t)frames;
+    vertex_count_ = (size_t)nv;
+    face_count_ = (size_t)nf;
+    step_ = h.step;
+    return true;
+  }
+
+  void MeshSequenceReader::Close()
+  {
+    file_.Close();
+    frame_count_ = vertex_count_ = face_count_ = 0;
+    step_ = 0;
+    faces_ = nullptr;
+    rest_ = nullptr;
+    index_ = nullptr;
+  }
+
+  bool MeshSequenceReader::ReadFrame(size_t frame, float* positions) const
+  {
+    if (frame >= frame_count_)
+      return false;
+    const unsigned char* p = (const unsigned char*)file_.GetData() + (size_t)index_[2 * frame];
+    const unsigned char* end = p + (size_t)index_[2 * frame + 1];
+    size_t nc = ChunkCount(vertex_count_);
+    uint32_t count;
+    if ((size_t)(end - p) < sizeof(uint32_t))
+      return false;
+    memcpy(&count, p, sizeof(count));
+    if (count != nc || (size_t)(end - p) / sizeof(uint32_t) < 1 + nc)
+      return false;
+
+    // chunk boundaries from the size table
+    std::vector<size_t> start(nc + 1);
+    start[0] = (1 + nc) * sizeof(uint32_t);
+    for (size_t c = 0; c < nc; c++) {
+      uint32_t s;
+      memcpy(&s, p + (1 + c) * sizeof(uint32_t), sizeof(s));
+      start[c + 1] = start[c] + s;
+    }
+    if (start[nc] != (size_t)(end - p))
+      return false;
+
+    int n = (int)nc, bad = 0;
+#pragma omp parallel for schedule(dynamic) reduction(+:bad)
+    for (int c = 0; c < n; c++) {
+      size_t first = (size_t)c * MeshSequenceWriter::kChunkVertices;
+      size_t count = MIN((size_t)MeshSequenceWriter::kChunkVertices, vertex_count_ - first);
+      bad += !DecodeChunk(p + start[c], p + start[c + 1], count, rest_ + 3 * first, step_, positions + 3 * first);
+    }
+    return !bad;
+  }
+
+  bool MeshSequenceReader::ReadFrame(size_t frame, TriMesh* mesh) const
+  {
+    if (mesh->n_vertices() != vertex_count_)
+      return false;
+    std::vector<float> positions(3 * vertex_count_);
+    if (!vertex_count_ || !ReadFrame(frame, &positions[0]))
+      return !vertex_count_ && frame < frame_count_;
+    for (size_t i = 0; i < vertex_count_; i++)
+      mesh->movePoint(TriMesh::VertexHandle((int)i), Point(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]));
+    return true;
+  }
+}
@@ -0,0 +1,123 @@
+#ifndef HJ_MeshSequence_h__
+#define HJ_MeshSequence_h__
+
+#include <stdint.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "MappedFile.h"
+
+namespace hj
+{
+  class TriMesh;
+
+  /**
+  * Writes a sequence of poses of one mesh to a single file: the faces and the rest
+  * positions once, then every frame as its offsets from the rest pose, quantized to
+  * a fixed step. Each offset is predicted from the previous vertex in vertex order,
+  * and a run of vertices with the same offset as their predecessor (most of the mesh
+  * when only a region was deformed) is coded as one varint of its length. Frames are split into chunks
+  * of kChunkVertices vertices that restart the prediction, so they are encoded and
+  * decoded in parallel, and an index at the end of the file gives random access to
+  * any frame.
+  */
+  class MeshSequenceWriter
+  {
+  public:
+    /** vertices per independently coded chunk of a frame. */
+    static const uint32_t kChunkVertices = 4096;
+
+    MeshSequenceWriter();
+    ~MeshSequenceWriter();
+
+    /**
+    * Starts a sequence file and writes the topology and the rest pose.
+    * @param rest: the mesh at rest, all frames must have its vertices and faces.
+    * @param step: quantization step of the positions, 0 for 1/65536 of the rest
+    * pose's bounding box diagonal.
+    * @return: True if successful, false otherwise.
+    */
+    bool Open(const std::string& filename, const TriMesh& rest, float step = 0);
+
+    /**
+    * Appends a frame.
+    * @param positions: x, y, z of every vertex.
+    * @return: True if successful, false if the file cannot be written or a position
+    * is not finite or more than 2^30 quantization steps from the rest pose; such a
+    * frame is not written.
+    */
+    bool AddFrame(const float* positions);
+    bool AddFrame(const TriMesh& mesh);
+
+    /**
+    * Writes the frame index and closes the file.
+    * @return: True if the whole file was written.
+    */
+    bool Close();
+
+    size_t GetFrameCount() const { return frames_.size() / 2; }
+
+  private:
+    MeshSequenceWriter(const MeshSequenceWriter&);
+    MeshSequenceWriter& operator=(const MeshSequenceWriter&);
+
+    std::ofstream out_;
+    uint64_t pos_;
+    uint64_t faces_offset_, rest_offset_;
+    uint32_t face_count_;
+    float step_;
+    std::vector<float> rest_;
+    std::vector<uint64_t> frames_; // offset, size of every frame
+    std::vector<std::vector<unsigned char> > chunks_;
+  };
+
+  /**
+  * Plays back a file of MeshSequenceWriter. The file is mapped, so opening it reads
+  * only the header and the index, and a frame is decoded on request.
+  */
+  class MeshSequenceReader
+  {
+  public:
+    MeshSequenceReader();
+
+    /**
+    * @return: True if the file is a valid sequence, false otherwise.
+    */
+    bool Open(const std::string& filename);
+    void Close();
+
+    size_t GetFrameCount() const { return frame_count_; }
+    size_t GetVertexCount() const { return vertex_count_; }
+    size_t GetFaceCount() const { return face_count_; }
+    float GetStep() const { return step_; }
+
+    /** vertex indices of the faces, 3 per face. */
+    const uint32_t* GetFaces() const { return faces_; }
+
+    /** x, y, z of the rest pose per vertex. */
+    const float* GetRestPositions() const { return rest_; }
+
+    /**
+    * Decodes a frame.
+    * @param positions: receives x, y, z of every vertex.
+    * @return: True if successful, false if frame is out of range or damaged.
+    */
+    bool ReadFrame(size_t frame, float* positions) const;
+
+    /**
+    * Decodes a frame into the points of mesh, which must have the sequence's
+    * vertices; the vertices that move are marked dirty.
+    */
+    bool ReadFrame(size_t frame, TriMesh* mesh) const;
+
+  private:
+    MappedFile file_;
+    size_t frame_count_, vertex_count_, face_count_;
+    float step_;
+    const uint32_t* faces_;
+    const float* rest_;
+    const uint64_t* index_;
+  };
+}
+
+#endif // HJ_MeshSequence_h__
@@ -0,0 +1,66 @@
+#ifndef HJ_Quantize_h__
+#define HJ_Quantize_h__
+
+#include <math.h>
+
+namespace hj
+{
+  /**
+  * Packs a unit vector into two 16-bit snorm values with the octahedral mapping: the
+  * vector is projected onto the octahedron |x| + |y| + |z| = 1 and the lower half is
+  * folded over the upper one, so the error is even over the sphere (well below a
+  * hundredth of a degree) and decoding needs no trigonometry.
+  */
+  inline void EncodeOctahedral(const float n[3], short e[2])
+  {
+    float s = fabsf(n[0]) + fabsf(n[1]) + fabsf(n[2]);
+    float x = 0, y = 0;
+    if (s > 0) {
+      x = n[0] / s;
+      y = n[1] / s;
+      if (n[2] < 0) {
+        float fx = (1 - fabsf(y)) * (x >= 0 ? 1 : -1);
+        float fy = (1 - fabsf(x)) * (y >= 0 ? 1 : -1);
+        x = fx;
+        y = fy;
+      }
+    }
+    e[0] = (short)floorf(x * 32767 + 0.5f);
+    e[1] = (short)floorf(y * 32767 + 0.5f);
+  }
+
+  /**
+  * Unpacks a vector of EncodeOctahedral(), normalized.
+  */
+  inline void DecodeOctahedral(const short e[2], float n[3])
+  {
+    float x = e[0] / 32767.0f, y = e[1] / 32767.0f, z = 1 - fabsf(x) - fabsf(y);
+    if (z < 0) {
+      float fx = (1 - fabsf(y)) * (x >= 0 ? 1 : -1);
+      float fy = (1 - fabsf(x)) * (y >= 0 ? 1 : -1);
+      x = fx;
+      y = fy;
+    }
+    float len = sqrtf(x * x + y * y + z * z);
+    n[0] = x / len;
+    n[1] = y / len;
+    n[2] = z / len;
+  }
+
+  /**
+  * Maps v in [lo, lo + size] to a 16-bit unorm value.
+  */
+  inline unsigned short EncodeUnorm16(float v, float lo, float size)
+  {
+    float t = size > 0 ? (v - lo) / size : 0.0f;
+    t = t < 0 ? 0 : (t > 1 ? 1 : t);
+    return (unsigned short)floorf(t * 65535 + 0.5f);
+  }
+
+  inline float DecodeUnorm16(unsigned short u, float lo, float size)
+  {
+    return lo + u / 65535.0f * size;
+  }
+}
+
+#endif // HJ_Quantize_h__
@@ -1,8 +1,14 @@
 #include "ScanLine.h"
 
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define HJ_SCANLINE_SSE
+#endif
+
 namespace hj
 {
-
+  // triangle groups of 4 below this are tested on one thread
+  static const int kParallelGroups = 256;
 
   bool ScanLine::PointInPolygon(const std::vector<glm::vec2> &polygon, const glm::vec2 &point)
   {
@@ -71,4 +77,80 @@ namespace hj
     /* Otherwise we're intersecting with at least one edge */
     return true;// INTERSECTING;
   }
-}
\ No newline at end of file
+
+#ifdef HJ_SCANLINE_SSE
+  /**
+  * (b - a) x (p - a) for 4 lines and points
+  */
+  static inline __m128 Edge(__m128 ax, __m128 ay, __m128 bx, __m128 by, __m128 px, __m128 py)
+  {
+    return _mm_sub_ps(_mm_mul_ps(_mm_sub_ps(bx, ax), _mm_sub_ps(py, ay)),
+      _mm_mul_ps(_mm_sub_ps(px, ax), _mm_sub_ps(by, ay)));
+  }
+
+  /**
+  * mask of the points p0, p1 both strictly on the other side of edge ab than c
+  */
+  static inline __m128 Outside(__m128 ax, __m128 ay, __m128 bx, __m128 by, __m128 cx, __m128 cy,
+    __m128 p0x, __m128 p0y, __m128 p1x, __m128 p1y)
+  {
+    __m128 zero = _mm_setzero_ps();
+    __m128 c = Edge(ax, ay, bx, by, cx, cy);
+    __m128 f0 = _mm_mul_ps(Edge(ax, ay, bx, by, p0x, p0y), c);
+    __m128 f1 = _mm_mul_ps(Edge(ax, ay, bx, by, p1x, p1y), c);
+    return _mm_and_ps(_mm_cmplt_ps(f0, zero), _mm_cmplt_ps(f1, zero));
+  }
+#endif
+
+  void ScanLine::Intersecting(const glm::vec2 &p0,
+    const glm::vec2 &p1,
+    const float* x,
+    const float* y,
+    const unsigned int* triangles,
+    const int* faces,
+    int count,
+    unsigned char* hits)
+  {
+    int done = 0;
+#ifdef HJ_SCANLINE_SSE
+    int groups = count / 4;
+#pragma omp parallel for if (groups > kParallelGroups)
+    for (int g = 0; g < groups; g++) {
+      const int* f = faces + 4 * g;
+      const unsigned int* t[4] = { triangles + 3 * f[0], triangles + 3 * f[1],
+        triangles + 3 * f[2], triangles + 3 * f[3] };
+      __m128 tx[3], ty[3];
+      for (int k = 0; k < 3; k++) {
+        tx[k] = _mm_setr_ps(x[t[0][k]], x[t[1][k]], x[t[2][k]], x[t[3][k]]);
+        ty[k] = _mm_setr_ps(y[t[0][k]], y[t[1][k]], y[t[2][k]], y[t[3][k]]);
+      }
+      __m128 p0x = _mm_set1_ps(p0.x), p0y = _mm_set1_ps(p0.y);
+      __m128 p1x = _mm_set1_ps(p1.x), p1y = _mm_set1_ps(p1.y);
+
+      // the segment is outside one of the edges of the triangle...
+      __m128 apart = Outside(tx[0], ty[0], tx[1], ty[1], tx[2], ty[2], p0x, p0y, p1x, p1y);
+      apart = _mm_or_ps(apart, Outside(tx[1], ty[1], tx[2], ty[2], tx[0], ty[0], p0x, p0y, p1x, p1y));
+      apart = _mm_or_ps(apart, Outside(tx[2], ty[2], tx[0], ty[0], tx[1], ty[1], p0x, p0y, p1x, p1y));
+      // ...or the triangle is on one side of the segment
+      __m128 s0 = Edge(p0x, p0y, p1x, p1y, tx[0], ty[0]);
+      __m128 s1 = Edge(p0x, p0y, p1x, p1y, tx[1], ty[1]);
+      __m128 s2 = Edge(p0x, p0y, p1x, p1y, tx[2], ty[2]);
+      __m128 zero = _mm_setzero_ps();
+      apart = _mm_or_ps(apart, _mm_and_ps(_mm_cmpgt_ps(_mm_mul_ps(s0, s1), zero),
+        _mm_cmpgt_ps(_mm_mul_ps(s1, s2), zero)));
+
+      int mask = _mm_movemask_ps(apart);
+      for (int k = 0; k < 4; k++)
+        hits[4 * g + k] = ((mask >> k) & 1) ? 0 : 1;
+    }
+    done = 4 * groups;
+#endif
+    for (int i = done; i < count; i++) {
+      const unsigned int* t = triangles + 3 * faces[i];
+      hits[i] = Intersecting(p0, p1,
+        glm::vec2(x[t[0]], y[t[0]]),
+        glm::vec2(x[t[1]], y[t[1]]),
+        glm::vec2(x[t[2]], y[t[2]])) ? 1 : 0;
+    }
+  }
+}
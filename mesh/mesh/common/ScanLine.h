@@ -32,6 +32,24 @@ namespace hj
       const glm::vec2 &t1,
       const glm::vec2 &t2);
 
+    /**
+    * Check segment P0P1 against many triangles, with the result of Intersecting()
+    * for each. Triangles are tested 4 at a time with SSE, and the groups are shared
+    * among threads.
+    * @param x, y: window coordinates of the vertices.
+    * @param triangles: 3 vertex indices per face.
+    * @param faces: the faces to test.
+    * @param hits: receives 1 for every face the segment intersects, 0 otherwise.
+    */
+    static void Intersecting(const glm::vec2 &p0,
+      const glm::vec2 &p1,
+      const float* x,
+      const float* y,
+      const unsigned int* triangles,
+      const int* faces,
+      int count,
+      unsigned char* hits);
+
   private:
     /* Check whether P and Q lie on the same side of line AB */
     static float Side(const glm::vec2 &p,
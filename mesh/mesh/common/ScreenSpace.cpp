@@ -0,0 +1,87 @@
+#include "ScreenSpace.h"
+#include <string.h>
+#include "macro.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define HJ_SCREEN_SSE
+#endif
+
+namespace hj
+{
+  ScreenSpace::ScreenSpace()
+    : width_(0), height_(0), valid_(false)
+  {
+    memset(mvp_, 0, sizeof(mvp_));
+  }
+
+  /**
+  * window positions of up to 32 points; bit i of the result is set if point i is in
+  * front of the eye
+  */
+  static unsigned int Project(const float* p, int count, const float m[16],
+    float half_width, float half_height, float* wx, float* wy)
+  {
+    unsigned int front = 0;
+    int i = 0;
+#ifdef HJ_SCREEN_SSE
+    const __m128 m0 = _mm_set1_ps(m[0]), m4 = _mm_set1_ps(m[4]), m8 = _mm_set1_ps(m[8]), m12 = _mm_set1_ps(m[12]);
+    const __m128 m1 = _mm_set1_ps(m[1]), m5 = _mm_set1_ps(m[5]), m9 = _mm_set1_ps(m[9]), m13 = _mm_set1_ps(m[13]);
+    const __m128 m3 = _mm_set1_ps(m[3]), m7 = _mm_set1_ps(m[7]), m11 = _mm_set1_ps(m[11]), m15 = _mm_set1_ps(m[15]);
+    const __m128 one = _mm_set1_ps(1.0f), hw = _mm_set1_ps(half_width), hh = _mm_set1_ps(half_height);
+    for (; i + 4 <= count; i += 4) {
+      const float* q = p + 3 * i;
+      __m128 x = _mm_setr_ps(q[0], q[3], q[6], q[9]);
+      __m128 y = _mm_setr_ps(q[1], q[4], q[7], q[10]);
+      __m128 z = _mm_setr_ps(q[2], q[5], q[8], q[11]);
+      __m128 cx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, x), _mm_mul_ps(m4, y)), _mm_add_ps(_mm_mul_ps(m8, z), m12));
+      __m128 cy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m1, x), _mm_mul_ps(m5, y)), _mm_add_ps(_mm_mul_ps(m9, z), m13));
+      __m128 cw = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m3, x), _mm_mul_ps(m7, y)), _mm_add_ps(_mm_mul_ps(m11, z), m15));
+      __m128 inv = _mm_div_ps(one, cw);
+      // points behind the eye get 0, as in the scalar loop, not inf or NaN
+      __m128 ahead = _mm_cmpgt_ps(cw, _mm_setzero_ps());
+      _mm_storeu_ps(wx + i, _mm_and_ps(ahead, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(cx, inv), one), hw)));
+      _mm_storeu_ps(wy + i, _mm_and_ps(ahead, _mm_mul_ps(_mm_add_ps(_mm_mul_ps(cy, inv), one), hh)));
+      front |= (unsigned int)_mm_movemask_ps(ahead) << i;
+    }
+#endif
+    for (; i < count; i++) {
+      const float* q = p + 3 * i;
+      float cx = m[0] * q[0] + m[4] * q[1] + m[8] * q[2] + m[12];
+      float cy = m[1] * q[0] + m[5] * q[1] + m[9] * q[2] + m[13];
+      float cw = m[3] * q[0] + m[7] * q[1] + m[11] * q[2] + m[15];
+      wx[i] = wy[i] = 0;
+      if (cw > 0) {
+        wx[i] = (cx / cw + 1) * half_width;
+        wy[i] = (cy / cw + 1) * half_height;
+        front |= 1u << i;
+      }
+    }
+    return front;
+  }
+
+  void ScreenSpace::project(const float* positions, int count, const float mvp[16], int width, int height)
+  {
+    x_.resize(count);
+    y_.resize(count);
+    front_.resize(count);
+    float half_width = 0.5f * width, half_height = 0.5f * height;
+    int nw = front_.wordCount();
+#pragma omp parallel for schedule(dynamic, 64)
+    for (int w = 0; w < nw; w++) {
+      int begin = 32 * w;
+      int n = MIN(count - begin, 32);
+      front_.setWord(w, Project(positions + 3 * begin, n, mvp, half_width, half_height,
+        &x_[begin], &y_[begin]));
+    }
+    memcpy(mvp_, mvp, sizeof(mvp_));
+    width_ = width;
+    height_ = height;
+    valid_ = true;
+  }
+
+  bool ScreenSpace::isValid(const float mvp[16], int width, int height) const
+  {
+    return valid_ && width == width_ && height == height_ && memcmp(mvp, mvp_, sizeof(mvp_)) == 0;
+  }
+}
@@ -0,0 +1,52 @@
+#ifndef HJ_ScreenSpace_h__
+#define HJ_ScreenSpace_h__
+
+#include <vector>
+#include "SelectionSet.h"
+
+namespace hj
+{
+  /**
+  * Window positions of a point set under one model-view-projection matrix, kept as
+  * separate x and y arrays so that screen-space tests can read 4 points with one
+  * load. The points are projected once with the matrix and reused by every query
+  * until the matrix, the window size or the points change.
+  */
+  class ScreenSpace
+  {
+  public:
+    ScreenSpace();
+
+    /**
+    * Projects the points, 4 at a time with SSE, in blocks of 32 shared among threads.
+    * @param positions: x, y, z per point, in model coordinates.
+    * @param mvp: model to clip coordinates, column major.
+    */
+    void project(const float* positions, int count, const float mvp[16], int width, int height);
+
+    /** marks the positions out of date, after the points moved. */
+    void invalidate() { valid_ = false; }
+
+    /**
+    * @return: true if the positions were projected with this matrix and window size,
+    * and the points did not move since.
+    */
+    bool isValid(const float mvp[16], int width, int height) const;
+
+    int size() const { return (int)x_.size(); }
+    const float* x() const { return x_.empty() ? NULL : &x_[0]; }
+    const float* y() const { return y_.empty() ? NULL : &y_[0]; }
+
+    /** the points in front of the eye, the others have no window position. */
+    const SelectionSet& front() const { return front_; }
+
+  private:
+    std::vector<float> x_, y_;
+    SelectionSet front_;
+    float mvp_[16];
+    int width_, height_;
+    bool valid_;
+  };
+}
+
+#endif // HJ_ScreenSpace_h__
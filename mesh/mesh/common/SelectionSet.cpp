@@ -0,0 +1,180 @@
+#include "SelectionSet.h"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace hj
+{
+  // word loops shorter than this are not worth the threads
+  static const int kParallelWords = 1 << 14;
+
+  static int PopCount(uint32_t x)
+  {
+#if defined(_MSC_VER) && defined(__AVX__)
+    return (int)__popcnt(x);
+#elif defined(__GNUC__)
+    return __builtin_popcount(x);
+#else
+    x = x - ((x >> 1) & 0x55555555);
+    x = (x & 0x33333333) + ((x >> 2) & 0x33333333);
+    x = (x + (x >> 4)) & 0x0f0f0f0f;
+    return (int)((x * 0x01010101) >> 24);
+#endif
+  }
+
+  /**
+  * index of the lowest set bit, x must not be 0
+  */
+  static int LowestBit(uint32_t x)
+  {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, x);
+    return (int)index;
+#else
+    return __builtin_ctz(x);
+#endif
+  }
+
+  SelectionSet::SelectionSet()
+    : size_(0)
+  {
+
+  }
+
+  SelectionSet::SelectionSet(int size)
+    : words_((size + 31) >> 5, 0), size_(size)
+  {
+
+  }
+
+  void SelectionSet::resize(int size)
+  {
+    words_.resize((size + 31) >> 5, 0);
+    size_ = size;
+    if (size & 31)
+      words_.back() &= (1u << (size & 31)) - 1;
+  }
+
+  void SelectionSet::clear()
+  {
+    words_.assign(words_.size(), 0);
+  }
+
+  int SelectionSet::count() const
+  {
+    int nw = (int)words_.size();
+    int n = 0;
+#pragma omp parallel for reduction(+:n) if (nw > kParallelWords)
+    for (int w = 0; w < nw; w++)
+      n += PopCount(words_[w]);
+    return n;
+  }
+
+  bool SelectionSet::empty() const
+  {
+    for (size_t w = 0; w < words_.size(); w++) {
+      if (words_[w])
+        return false;
+    }
+    return true;
+  }
+
+  int SelectionSet::next(int i) const
+  {
+    if (i < 0)
+      i = 0;
+    if (i >= size_)
+      return -1;
+    int w = i >> 5;
+    uint32_t bits = words_[w] & (~0u << (i & 31));
+    while (!bits) {
+      if (++w == (int)words_.size())
+        return -1;
+      bits = words_[w];
+    }
+    return (w << 5) + LowestBit(bits);
+  }
+
+  SelectionSet& SelectionSet::operator|=(const SelectionSet& other)
+  {
+    if (other.size_ > size_)
+      resize(other.size_);
+    int nw = (int)other.words_.size();
+    uint32_t* a = words_.empty() ? NULL : &words_[0];
+    const uint32_t* b = other.words_.empty() ? NULL : &other.words_[0];
+#pragma omp parallel for if (nw > kParallelWords)
+    for (int w = 0; w < nw; w++)
+      a[w] |= b[w];
+    return *this;
+  }
+
+  SelectionSet& SelectionSet::operator&=(const SelectionSet& other)
+  {
+    int nw = (int)words_.size();
+    int nb = (int)other.words_.size();
+    uint32_t* a = words_.empty() ? NULL : &words_[0];
+    const uint32_t* b = other.words_.empty() ? NULL : &other.words_[0];
+#pragma omp parallel for if (nw > kParallelWords)
+    for (int w = 0; w < nw; w++)
+      a[w] &= w < nb ? b[w] : 0;
+    return *this;
+  }
+
+  SelectionSet& SelectionSet::operator-=(const SelectionSet& other)
+  {
+    int nw = (int)(words_.size() < other.words_.size() ? words_.size() : other.words_.size());
+    uint32_t* a = words_.empty() ? NULL : &words_[0];
+    const uint32_t* b = other.words_.empty() ? NULL : &other.words_[0];
+#pragma omp parallel for if (nw > kParallelWords)
+    for (int w = 0; w < nw; w++)
+      a[w] &= ~b[w];
+    return *this;
+  }
+
+  void SelectionSet::combine(const SelectionSet& other, Operation op)
+  {
+    switch (op) {
+    case kUnion:
+      *this |= other;
+      break;
+    case kDifference:
+      *this -= other;
+      break;
+    case kIntersection:
+      *this &= other;
+      break;
+    default:
+      *this = other;
+      break;
+    }
+  }
+
+  void SelectionSet::indices(std::vector<int>& out) const
+  {
+    out.clear();
+    out.reserve(count());
+    for (int i = next(0); i >= 0; i = next(i + 1))
+      out.push_back(i);
+  }
+
+  void SelectionSet::VerticesToFaces(const TriMesh& mesh, const SelectionSet& vertices, SelectionSet& faces)
+  {
+    faces.resize((int)mesh.n_faces());
+    faces.clear();
+    for (int v = vertices.next(0); v >= 0; v = vertices.next(v + 1)) {
+      for (TriMesh::ConstVertexFaceIter vf_it = mesh.cvf_iter(TriMesh::VertexHandle(v)); vf_it.is_valid(); ++vf_it)
+        faces.insert(vf_it.handle().idx());
+    }
+  }
+
+  void SelectionSet::FacesToVertices(const TriMesh& mesh, const SelectionSet& faces, SelectionSet& vertices)
+  {
+    vertices.resize((int)mesh.n_vertices());
+    vertices.clear();
+    for (int f = faces.next(0); f >= 0; f = faces.next(f + 1)) {
+      for (TriMesh::ConstFaceVertexIter fv_it = mesh.cfv_iter(TriMesh::FaceHandle(f)); fv_it.is_valid(); ++fv_it)
+        vertices.insert(fv_it.handle().idx());
+    }
+  }
+}
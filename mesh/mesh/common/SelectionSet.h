@@ -0,0 +1,104 @@
+#ifndef HJ_SelectionSet_h__
+#define HJ_SelectionSet_h__
+
+#include <stdint.h>
+#include <vector>
+#include "TriMesh.h"
+
+namespace hj
+{
+  /**
+  * A set of vertex or face indices in [0, size), stored as a dense bitset: one bit
+  * per element, 32 to a word. Membership is a bit test, the count is a popcount over
+  * the words, and union, intersection and difference are one word operation per 32
+  * elements, so combining selections never sorts. Iterating skips empty words, which
+  * costs a few instructions per 32 elements outside of the set.
+  */
+  class SelectionSet
+  {
+  public:
+    /** how a new selection is combined with the current one. */
+    enum Operation
+    {
+      kReplace,
+      kUnion,        // shift
+      kDifference,   // ctrl
+      kIntersection  // shift + ctrl
+    };
+
+    SelectionSet();
+    explicit SelectionSet(int size);
+
+    /**
+    * Changes the range of the elements, the ones not in [0, size) are removed.
+    */
+    void resize(int size);
+    int size() const { return size_; }
+
+    /** removes all the elements, keeping the size. */
+    void clear();
+
+    void insert(int i) { words_[i >> 5] |= 1u << (i & 31); }
+    void erase(int i) { words_[i >> 5] &= ~(1u << (i & 31)); }
+    bool contains(int i) const
+    {
+      return i >= 0 && i < size_ && ((words_[i >> 5] >> (i & 31)) & 1) != 0;
+    }
+
+    /** number of elements. */
+    int count() const;
+    bool empty() const;
+
+    /**
+    * @return: the smallest element >= i, or -1 if there is none. The elements are
+    * visited with for (int i = s.next(0); i >= 0; i = s.next(i + 1)).
+    */
+    int next(int i) const;
+
+    SelectionSet& operator|=(const SelectionSet& other);
+    SelectionSet& operator&=(const SelectionSet& other);
+    SelectionSet& operator-=(const SelectionSet& other);
+
+    /**
+    * Combines other into this set with op.
+    */
+    void combine(const SelectionSet& other, Operation op);
+
+    /**
+    * The elements [32 * w, 32 * w + 32) as the bits of word w, for filling a set in
+    * parallel: threads may set different words at once.
+    */
+    int wordCount() const { return (int)words_.size(); }
+    uint32_t word(int w) const { return words_[w]; }
+    void setWord(int w, uint32_t bits) { words_[w] = bits; }
+
+    /** the elements in increasing order. */
+    void indices(std::vector<int>& out) const;
+
+    /** the elements as mesh handles in increasing order. */
+    template <class Handle>
+    void handles(std::vector<Handle>& out) const
+    {
+      out.clear();
+      out.reserve(count());
+      for (int i = next(0); i >= 0; i = next(i + 1))
+        out.push_back(Handle(i));
+    }
+
+    /**
+    * The faces around the vertices of a set, in time linear in the selection.
+    */
+    static void VerticesToFaces(const TriMesh& mesh, const SelectionSet& vertices, SelectionSet& faces);
+
+    /**
+    * The vertices of the faces of a set, in time linear in the selection.
+    */
+    static void FacesToVertices(const TriMesh& mesh, const SelectionSet& faces, SelectionSet& vertices);
+
+  private:
+    std::vector<uint32_t> words_;
+    int size_;
+  };
+}
+
+#endif // HJ_SelectionSet_h__
@@ -0,0 +1,323 @@
+#ifndef HJ_SmallMatrix_h__
+#define HJ_SmallMatrix_h__
+
+#include <math.h>
+
+/**
+* Fixed size vectors and matrices for the 3x3/4x4 geometry code (ARAP rotations,
+* PCA frames, control point transforms), where newmat's heap allocated, size
+* checked matrices cost far more than the arithmetic.
+* The types are plain aggregates: they live on the stack or inline in a
+* std::vector, copy with memcpy, and brace initialization of a const object is
+* done at compile time. Indices are 0-based, matrices are stored row by row.
+*/
+namespace hj
+{
+  template <typename T>
+  struct Vec3T
+  {
+    T v[3];
+
+    T& operator[](int i) { return v[i]; }
+    const T& operator[](int i) const { return v[i]; }
+
+    Vec3T operator+(const Vec3T& b) const { Vec3T r = { v[0] + b[0], v[1] + b[1], v[2] + b[2] }; return r; }
+    Vec3T operator-(const Vec3T& b) const { Vec3T r = { v[0] - b[0], v[1] - b[1], v[2] - b[2] }; return r; }
+    Vec3T operator*(T s) const { Vec3T r = { v[0] * s, v[1] * s, v[2] * s }; return r; }
+
+    T dot(const Vec3T& b) const { return v[0] * b[0] + v[1] * b[1] + v[2] * b[2]; }
+
+    Vec3T cross(const Vec3T& b) const
+    {
+      Vec3T r = { v[1] * b[2] - v[2] * b[1], v[2] * b[0] - v[0] * b[2], v[0] * b[1] - v[1] * b[0] };
+      return r;
+    }
+
+    T length() const { return (T)sqrt(dot(*this)); }
+  };
+
+  template <typename T>
+  inline Vec3T<T> MakeVec3(T x, T y, T z)
+  {
+    Vec3T<T> r = { x, y, z };
+    return r;
+  }
+
+  template <typename T>
+  struct Mat3T
+  {
+    T m[3][3];
+
+    T& operator()(int i, int j) { return m[i][j]; }
+    const T& operator()(int i, int j) const { return m[i][j]; }
+
+    static Mat3T zero()
+    {
+      Mat3T r = { { { 0, 0, 0 }, { 0, 0, 0 }, { 0, 0, 0 } } };
+      return r;
+    }
+
+    static Mat3T identity()
+    {
+      Mat3T r = { { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } } };
+      return r;
+    }
+
+    Vec3T<T> column(int j) const { return MakeVec3(m[0][j], m[1][j], m[2][j]); }
+
+    void setColumn(int j, const Vec3T<T>& c) { m[0][j] = c[0]; m[1][j] = c[1]; m[2][j] = c[2]; }
+
+    Mat3T operator+(const Mat3T& b) const
+    {
+      Mat3T r;
+      for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++)
+        r.m[i][j] = m[i][j] + b.m[i][j];
+      return r;
+    }
+
+    Mat3T operator*(const Mat3T& b) const
+    {
+      Mat3T r;
+      for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++)
+        r.m[i][j] = m[i][0] * b.m[0][j] + m[i][1] * b.m[1][j] + m[i][2] * b.m[2][j];
+      return r;
+    }
+
+    Vec3T<T> operator*(const Vec3T<T>& x) const
+    {
+      Vec3T<T> r = {
+        m[0][0] * x[0] + m[0][1] * x[1] + m[0][2] * x[2],
+        m[1][0] * x[0] + m[1][1] * x[1] + m[1][2] * x[2],
+        m[2][0] * x[0] + m[2][1] * x[1] + m[2][2] * x[2] };
+      return r;
+    }
+
+    Mat3T transpose() const
+    {
+      Mat3T r;
+      for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++)
+        r.m[i][j] = m[j][i];
+      return r;
+    }
+
+    T determinant() const
+    {
+      return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+        - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+        + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    }
+
+    /**
+    * this += a * b.t()
+    */
+    void addOuter(const Vec3T<T>& a, const Vec3T<T>& b)
+    {
+      for (int i = 0; i < 3; i++)
+      for (int j = 0; j < 3; j++)
+        m[i][j] += a[i] * b[j];
+    }
+  };
+
+  /**
+  * Eigen decomposition A = V * diag(d) * V.t() of the symmetric matrix A by cyclic
+  * Jacobi rotations. The eigenvalues are sorted in decreasing order, the columns of
+  * V are the corresponding eigenvectors and V is a rotation (determinant +1).
+  */
+  template <typename T>
+  void SymmetricEigen(const Mat3T<T>& A, T d[3], Mat3T<T>& V)
+  {
+    Mat3T<T> a = A;
+    V = Mat3T<T>::identity();
+    for (int sweep = 0; sweep < 50; sweep++)
+    {
+      T off = a.m[0][1] * a.m[0][1] + a.m[0][2] * a.m[0][2] + a.m[1][2] * a.m[1][2];
+      T diag = a.m[0][0] * a.m[0][0] + a.m[1][1] * a.m[1][1] + a.m[2][2] * a.m[2][2];
+      if (off <= diag * (T)1e-30 || off == 0)
+        break;
+      for (int p = 0; p < 2; p++)
+      for (int q = p + 1; q < 3; q++)
+      {
+        if (a.m[p][q] == 0)
+          continue;
+        // rotation in the (p, q) plane that zeroes a(p, q)
+        T theta = (a.m[q][q] - a.m[p][p]) / (2 * a.m[p][q]);
+        T t = (theta >= 0 ? 1 : -1) / (fabs(theta) + sqrt(theta * theta + 1));
+        T c = 1 / sqrt(t * t + 1);
+        T s = t * c;
+        for (int k = 0; k < 3; k++)
+        {
+          T akp = a.m[k][p], akq = a.m[k][q];
+          a.m[k][p] = c * akp - s * akq;
+          a.m[k][q] = s * akp + c * akq;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+          T apk = a.m[p][k], aqk = a.m[q][k];
+          a.m[p][k] = c * apk - s * aqk;
+          a.m[q][k] = s * apk + c * aqk;
+        }
+        for (int k = 0; k < 3; k++)
+        {
+          T vkp = V.m[k][p], vkq = V.m[k][q];
+          V.m[k][p] = c * vkp - s * vkq;
+          V.m[k][q] = s * vkp + c * vkq;
+        }
+      }
+    }
+    for (int i = 0; i < 3; i++)
+      d[i] = a.m[i][i];
+    // selection sort of three, swapping the eigenvectors along
+    for (int i = 0; i < 2; i++)
+    for (int j = i + 1; j < 3; j++)
+    {
+      if (d[j] > d[i])
+      {
+        T tmp = d[i]; d[i] = d[j]; d[j] = tmp;
+        Vec3T<T> ci = V.column(i);
+        V.setColumn(i, V.column(j));
+        V.setColumn(j, ci);
+      }
+    }
+    if (V.determinant() < 0)
+      V.setColumn(2, V.column(2) * (T)-1);
+  }
+
+  /**
+  * Rotation R closest to the covariance S = U * D * V.t(): R = V * diag(1, 1, det(V * U.t())) * U.t(),
+  * i.e. the sign of the column of the smallest singular value is flipped when V * U.t()
+  * is a reflection ("Least-Squares Rigid Motion Using SVD", Sorkine).
+  * U is recovered from the eigenvectors V of S.t() * S, with u3 = u1 x u2, so a rank
+  * deficient S (a vertex with coplanar neighbours) is handled as well.
+  */
+  template <typename T>
+  Mat3T<T> FitRotation(const Mat3T<T>& S)
+  {
+    T d[3];
+    Mat3T<T> V;
+    SymmetricEigen(S.transpose() * S, d, V);
+    Vec3T<T> u1 = S * V.column(0);
+    T l1 = u1.length();
+    if (!(l1 > 0))
+      return Mat3T<T>::identity();
+    u1 = u1 * (1 / l1);
+    Vec3T<T> u2 = S * V.column(1);
+    u2 = u2 - u1 * u1.dot(u2);
+    T l2 = u2.length();
+    if (l2 <= l1 * (T)1e-12)
+    {
+      // rank one: any unit vector orthogonal to u1
+      int k = (fabs(u1[0]) < fabs(u1[1])) ? (fabs(u1[0]) < fabs(u1[2]) ? 0 : 2) : (fabs(u1[1]) < fabs(u1[2]) ? 1 : 2);
+      Vec3T<T> e = MakeVec3((T)0, (T)0, (T)0);
+      e[k] = 1;
+      u2 = u1.cross(e);
+      l2 = u2.length();
+    }
+    u2 = u2 * (1 / l2);
+    Vec3T<T> u3 = u1.cross(u2);
+    // R = V * U.t() with det(V) = det(U) = 1
+    Mat3T<T> U;
+    U.setColumn(0, u1);
+    U.setColumn(1, u2);
+    U.setColumn(2, u3);
+    return V * U.transpose();
+  }
+
+  template <typename T>
+  struct Mat4T
+  {
+    T m[4][4];
+
+    T& operator()(int i, int j) { return m[i][j]; }
+    const T& operator()(int i, int j) const { return m[i][j]; }
+
+    static Mat4T identity()
+    {
+      Mat4T r = { { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } } };
+      return r;
+    }
+
+    /**
+    * from a column major array, as returned by glGetDoublev(GL_MODELVIEW_MATRIX)
+    */
+    static Mat4T fromColumnMajor(const T a[16])
+    {
+      Mat4T r;
+      for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+        r.m[j][i] = a[i * 4 + j];
+      return r;
+    }
+
+    Mat4T operator*(const Mat4T& b) const
+    {
+      Mat4T r;
+      for (int i = 0; i < 4; i++)
+      for (int j = 0; j < 4; j++)
+        r.m[i][j] = m[i][0] * b.m[0][j] + m[i][1] * b.m[1][j] + m[i][2] * b.m[2][j] + m[i][3] * b.m[3][j];
+      return r;
+    }
+
+    /**
+    * transforms the point (p, 1); the last row is assumed to be (0, 0, 0, 1)
+    */
+    Vec3T<T> transformPoint(const Vec3T<T>& p) const
+    {
+      Vec3T<T> r = {
+        m[0][0] * p[0] + m[0][1] * p[1] + m[0][2] * p[2] + m[0][3],
+        m[1][0] * p[0] + m[1][1] * p[1] + m[1][2] * p[2] + m[1][3],
+        m[2][0] * p[0] + m[2][1] * p[1] + m[2][2] * p[2] + m[2][3] };
+      return r;
+    }
+
+    /**
+    * Gauss-Jordan elimination with partial pivoting.
+    * @return: false if the matrix is singular (inv is undefined then).
+    */
+    bool inverse(Mat4T& inv) const
+    {
+      Mat4T a = *this;
+      inv = identity();
+      for (int c = 0; c < 4; c++)
+      {
+        int p = c;
+        for (int r = c + 1; r < 4; r++)
+          if (fabs(a.m[r][c]) > fabs(a.m[p][c]))
+            p = r;
+        if (a.m[p][c] == 0)
+          return false;
+        for (int k = 0; k < 4; k++)
+        {
+          T tmp = a.m[c][k]; a.m[c][k] = a.m[p][k]; a.m[p][k] = tmp;
+          tmp = inv.m[c][k]; inv.m[c][k] = inv.m[p][k]; inv.m[p][k] = tmp;
+        }
+        T s = 1 / a.m[c][c];
+        for (int k = 0; k < 4; k++)
+        {
+          a.m[c][k] *= s;
+          inv.m[c][k] *= s;
+        }
+        for (int r = 0; r < 4; r++)
+        {
+          if (r == c || a.m[r][c] == 0)
+            continue;
+          T f = a.m[r][c];
+          for (int k = 0; k < 4; k++)
+          {
+            a.m[r][k] -= f * a.m[c][k];
+            inv.m[r][k] -= f * inv.m[c][k];
+          }
+        }
+      }
+      return true;
+    }
+  };
+
+  typedef Vec3T<double> Vec3d;
+  typedef Mat3T<double> Mat3d;
+  typedef Mat4T<double> Mat4d;
+}
+
+#endif // HJ_SmallMatrix_h__
@@ -1,96 +1,408 @@
 #include "TriMesh.h"
+#include <float.h>
+#include "Curvature.h"
+#include "MappedFile.h"
+#include "MeshCache.h"
+#include "MeshImporter.h"
+#include "MeshReorder.h"
+#include "Quantize.h"
+#include "macro.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1) || defined(__SSE__)
+#include <xmmintrin.h>
+#define HJ_TRIMESH_SSE
+#endif
 
 namespace hj
 {
+  // below this many faces or vertices updateNormals() stays on one thread
+  static const int kParallelNormals = 4096;
+
   TriMesh::TriMesh(void)
+    : bbox_min(0, 0, 0)
+    , bbox_max(0, 0, 0)
+    , bbox_leaves_(0)
+    , curvature_(nullptr)
+    , use_cache_(true)
+    , attributes_(kDefaultAttributes)
+    , reorder_(false)
+    , changed_first_(0)
+    , changed_last_(0)
   {
+    texcoord_min_[0] = texcoord_min_[1] = 0;
+    texcoord_size_[0] = texcoord_size_[1] = 0;
   }
 
   TriMesh::~TriMesh(void)
   {
+    DEL_PTR(curvature_);
+  }
+
+  /**
+  * min and max of n points stored as x, y, z floats
+  */
+  static void BlockBox(const float* p, size_t n, Point& lo, Point& hi)
+  {
+    lo = Point(FLT_MAX, FLT_MAX, FLT_MAX);
+    hi = Point(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    size_t i = 0;
+#ifdef HJ_TRIMESH_SSE
+    if (n >= 4) {
+      // 4 points are 3 registers, x y z x | y z x y | z x y z; each lane keeps
+      // its coordinate, which is sorted out at the end
+      __m128 lo0 = _mm_loadu_ps(p), lo1 = _mm_loadu_ps(p + 4), lo2 = _mm_loadu_ps(p + 8);
+      __m128 hi0 = lo0, hi1 = lo1, hi2 = lo2;
+      for (i = 4; i + 4 <= n; i += 4) {
+        const float* q = p + 3 * i;
+        __m128 a = _mm_loadu_ps(q), b = _mm_loadu_ps(q + 4), c = _mm_loadu_ps(q + 8);
+        lo0 = _mm_min_ps(lo0, a); hi0 = _mm_max_ps(hi0, a);
+        lo1 = _mm_min_ps(lo1, b); hi1 = _mm_max_ps(hi1, b);
+        lo2 = _mm_min_ps(lo2, c); hi2 = _mm_max_ps(hi2, c);
+      }
+      float l[12], h[12];
+      _mm_storeu_ps(l, lo0); _mm_storeu_ps(l + 4, lo1); _mm_storeu_ps(l + 8, lo2);
+      _mm_storeu_ps(h, hi0); _mm_storeu_ps(h + 4, hi1); _mm_storeu_ps(h + 8, hi2);
+      for (int k = 0; k < 12; k++) {
+        lo[k % 3] = MIN(lo[k % 3], l[k]);
+        hi[k % 3] = MAX(hi[k % 3], h[k]);
+      }
+    }
+#endif
+    for (; i < n; i++) {
+      lo.minimize(Point(p[3 * i], p[3 * i + 1], p[3 * i + 2]));
+      hi.maximize(Point(p[3 * i], p[3 * i + 1], p[3 * i + 2]));
+    }
+  }
+
+  void TriMesh::invalidateBoundingBox()
+  {
+    bbox_tree_min_.clear();
+    bbox_tree_max_.clear();
+    bbox_leaves_ = 0;
+    block_dirty_.clear();
+    dirty_blocks_.clear();
   }
 
   void TriMesh::needBoundingBox()
   {
-    TriMesh::ConstVertexIter vIt = vertices_begin();
-    TriMesh::ConstVertexIter vEnd = vertices_end();
+    size_t nv = n_vertices();
+    size_t nb = (nv + kBoundingBlockSize - 1) / kBoundingBlockSize;
+    if (!nv) {
+      bbox_min = bbox_max = Point(0, 0, 0);
+      return;
+    }
+    if (block_dirty_.size() != nb) {
+      bbox_leaves_ = 1;
+      while (bbox_leaves_ < nb)
+        bbox_leaves_ *= 2;
+      bbox_tree_min_.assign(2 * bbox_leaves_, Point(FLT_MAX, FLT_MAX, FLT_MAX));
+      bbox_tree_max_.assign(2 * bbox_leaves_, Point(-FLT_MAX, -FLT_MAX, -FLT_MAX));
+      block_dirty_.assign(nb, 1);
+      dirty_blocks_.resize(nb);
+      for (size_t b = 0; b < nb; b++)
+        dirty_blocks_[b] = (int)b;
+    }
+    if (dirty_blocks_.empty())
+      return;
 
-    bbox_min = bbox_max = point(vIt);
+    const float* p = (const float*)points();
+    int nd = (int)dirty_blocks_.size();
+#pragma omp parallel for if (nd > 4)
+    for (int i = 0; i < nd; i++) {
+      size_t b = dirty_blocks_[i];
+      size_t first = b * kBoundingBlockSize;
+      size_t n = MIN(kBoundingBlockSize, nv - first);
+      BlockBox(p + 3 * first, n, bbox_tree_min_[bbox_leaves_ + b], bbox_tree_max_[bbox_leaves_ + b]);
+    }
 
-    for (; vIt != vEnd; ++vIt) {
-      const Point& p = point(vIt);
-      bbox_min.minimize(p);
-      bbox_max.maximize(p);
+    // up to the root, stopping where a node does not change: whatever changes
+    // above it comes from another dirty block
+    for (int i = 0; i < nd; i++) {
+      size_t b = dirty_blocks_[i];
+      block_dirty_[b] = 0;
+      for (size_t node = (bbox_leaves_ + b) / 2; node >= 1; node /= 2) {
+        Point lo = bbox_tree_min_[2 * node], hi = bbox_tree_max_[2 * node];
+        lo.minimize(bbox_tree_min_[2 * node + 1]);
+        hi.maximize(bbox_tree_max_[2 * node + 1]);
+        if (lo == bbox_tree_min_[node] && hi == bbox_tree_max_[node])
+          break;
+        bbox_tree_min_[node] = lo;
+        bbox_tree_max_[node] = hi;
+      }
     }
+    dirty_blocks_.clear();
+    bbox_min = bbox_tree_min_[1];
+    bbox_max = bbox_tree_max_[1];
+  }
+
+  bool TriMesh::hasTexCoords() const
+  {
+    return (has_vertex_texcoords2D() && option.check(OpenMesh::IO::Options::VertexTexCoord)) ||
+      !unorm_texcoords_.empty();
+  }
+
+  Normal TriMesh::vertexNormal(VertexHandle vh) const
+  {
+    if (has_vertex_normals())
+      return normal(vh);
+    Normal n(0, 0, 0);
+    if (!oct_normals_.empty())
+      DecodeOctahedral(&oct_normals_[2 * vh.idx()], n.data());
+    return n;
+  }
+
+  TriMesh::TexCoord2D TriMesh::vertexTexCoord(VertexHandle vh) const
+  {
+    if (has_vertex_texcoords2D())
+      return texcoord2D(vh);
+    if (unorm_texcoords_.empty())
+      return TexCoord2D(0, 0);
+    const unsigned short* t = &unorm_texcoords_[2 * vh.idx()];
+    return TexCoord2D(DecodeUnorm16(t[0], texcoord_min_[0], texcoord_size_[0]),
+      DecodeUnorm16(t[1], texcoord_min_[1], texcoord_size_[1]));
+  }
+
+  void TriMesh::quantizeTexCoords()
+  {
+    int nv = (int)n_vertices();
+    if (option.check(OpenMesh::IO::Options::VertexTexCoord) && nv) {
+      const float* t = (const float*)texcoords2D();
+      float hi[2];
+      for (int c = 0; c < 2; c++)
+        texcoord_min_[c] = hi[c] = t[c];
+      for (int i = 1; i < nv; i++) {
+        for (int c = 0; c < 2; c++) {
+          texcoord_min_[c] = MIN(texcoord_min_[c], t[2 * i + c]);
+          hi[c] = MAX(hi[c], t[2 * i + c]);
+        }
+      }
+      for (int c = 0; c < 2; c++)
+        texcoord_size_[c] = hi[c] - texcoord_min_[c];
+      unorm_texcoords_.resize(2 * (size_t)nv);
+#pragma omp parallel for
+      for (int i = 0; i < 2 * nv; i++)
+        unorm_texcoords_[i] = EncodeUnorm16(t[i], texcoord_min_[i % 2], texcoord_size_[i % 2]);
+    }
+    release_vertex_texcoords2D();
+  }
+
+  void TriMesh::resetMoved()
+  {
+    vertex_moved_.assign(n_vertices(), 0);
+    moved_vertices_.clear();
+    changed_first_ = changed_last_ = 0;
+  }
+
+  void TriMesh::needNormals()
+  {
+    if (moved_vertices_.empty())
+      return;
+    updateNormals(moved_vertices_);
+    if (curvature_)
+      curvature_->update(moved_vertices_);
+    for (size_t i = 0; i < moved_vertices_.size(); i++)
+      vertex_moved_[moved_vertices_[i].idx()] = 0;
+    moved_vertices_.clear();
+  }
+
+  void TriMesh::updateNormals(const std::vector<VertexHandle>& moved)
+  {
+    size_t nv = n_vertices(), nf = n_faces();
+    bool face_normals = has_face_normals(), vertex_normals = hasNormals();
+    if (!nf || (!face_normals && !vertex_normals))
+      return;
+    if (face_mark_.size() != nf)
+      face_mark_.assign(nf, 0);
+    if (vertex_mark_.size() != nv)
+      vertex_mark_.assign(nv, 0);
+
+    // faces around the moved vertices, and the vertices of those faces
+    std::vector<FaceHandle> faces;
+    std::vector<VertexHandle> verts;
+    for (size_t i = 0; i < moved.size(); i++) {
+      for (ConstVertexFaceIter vf_it = cvf_iter(moved[i]); vf_it.is_valid(); ++vf_it) {
+        FaceHandle fh = vf_it.handle();
+        if (face_mark_[fh.idx()])
+          continue;
+        face_mark_[fh.idx()] = 1;
+        faces.push_back(fh);
+        for (ConstFaceVertexIter fv_it = cfv_iter(fh); fv_it.is_valid(); ++fv_it) {
+          if (!vertex_mark_[fv_it.handle().idx()]) {
+            vertex_mark_[fv_it.handle().idx()] = 1;
+            verts.push_back(fv_it.handle());
+          }
+        }
+      }
+    }
+
+    // the circulators only read the connectivity, so both loops run in parallel;
+    // without face normals the vertices compute those of their faces themselves
+    int n = face_normals ? (int)faces.size() : 0;
+#pragma omp parallel for if (n > kParallelNormals)
+    for (int i = 0; i < n; i++)
+      set_normal(faces[i], faceNormal(faces[i]));
+    n = vertex_normals ? (int)verts.size() : 0;
+#pragma omp parallel for if (n > kParallelNormals)
+    for (int i = 0; i < n; i++) {
+      Normal vn(0, 0, 0);
+      for (ConstVertexFaceIter vf_it = cvf_iter(verts[i]); vf_it.is_valid(); ++vf_it)
+        vn += face_normals ? normal(vf_it.handle()) : faceNormal(vf_it.handle());
+      Scalar len = vn.norm();
+      if (len != 0)
+        vn /= len;
+      if (has_vertex_normals())
+        set_normal(verts[i], vn);
+      if (!oct_normals_.empty())
+        EncodeOctahedral(vn.data(), &oct_normals_[2 * verts[i].idx()]);
+    }
+
+    for (size_t i = 0; i < faces.size(); i++)
+      face_mark_[faces[i].idx()] = 0;
+    for (size_t i = 0; i < verts.size(); i++) {
+      vertex_mark_[verts[i].idx()] = 0;
+      if (vertex_normals)
+        extendChangedRange(verts[i].idx());
+    }
+  }
+
+  Normal TriMesh::faceNormal(FaceHandle fh) const
+  {
+    HalfedgeHandle h0 = halfedge_handle(fh);
+    HalfedgeHandle h1 = next_halfedge_handle(h0);
+    const Point& p0 = point(from_vertex_handle(h0));
+    const Point& p1 = point(to_vertex_handle(h0));
+    const Point& p2 = point(to_vertex_handle(h1));
+    Normal fn = (p1 - p0) % (p2 - p0);
+    Scalar len = fn.norm();
+    if (len != 0)
+      fn /= len;
+    return fn;
   }
 
   void TriMesh::request_curvature()
   {
-    OpenMesh::VPropHandleT<TriMesh::Point> curvature;
-    get_property_handle(curvature, "curvature");
-    TriMesh::VertexIter v_it, v_end(vertices_end());
-    TriMesh::VertexVertexIter vv_it, vv_it2;
-    TriMesh::Scalar voronoiArea;
-    for (v_it = vertices_begin(); v_it != v_end; ++v_it)
-    {
-      property(curvature, v_it)[0] = 0;
-      property(curvature, v_it)[1] = 0;
-      property(curvature, v_it)[2] = 0;
-      voronoiArea = 0;
-      for (vv_it = vv_iter(v_it); vv_it.is_valid(); ++vv_it)
-      {
-        //         (p)  -  p3
-        //        /    \     /  
-        //      p1 -  p2
-        // p is v_it; p2 is vv_it;
-        Point p = point(v_it);
-        Point p2 = point(vv_it);
-        vv_it--;
-        Point p3 = point(vv_it);
-        vv_it++;
-        vv_it++;
-        Point p1 = point(vv_it);
-        vv_it--;
-        TriMesh::Scalar wij = ((p - p1) | (p2 - p1)) / ((p - p1) % (p2 - p1)).length() +
-          ((p - p3) | (p2 - p3)) / ((p - p3) % (p2 - p3)).length();
-        property(curvature, v_it) += wij * (p2 - p);
-        voronoiArea += wij * (p2 - p).length() * (p2 - p).length() / 8;
-      }
-      property(curvature, v_it) /= 2 * voronoiArea;
+    if (!curvature_) {
+      curvature_ = new Curvature(this);
+      curvature_->compute();
     }
+    else
+      needNormals();
+
+    OpenMesh::VPropHandleT<TriMesh::Point> curvature;
+    if (!get_property_handle(curvature, "curvature"))
+      add_property(curvature, "curvature");
+    const std::vector<Vec>& mean_normal = curvature_->meanCurvatureNormal();
+    for (size_t i = 0; i < mean_normal.size(); i++)
+      property(curvature, VertexHandle((int)i)) = mean_normal[i];
   }
 
   void TriMesh::request_curvature_color()
   {
-    OpenMesh::VPropHandleT<TriMesh::Point> curvature;
-    get_property_handle(curvature, "curvature");
+    if (!curvature_)
+      request_curvature();
+    else
+      needNormals();
     OpenMesh::VPropHandleT<TriMesh::Point> curvature_color;
-    get_property_handle(curvature_color, "curvature_color");
-    TriMesh::VertexIter v_it, v_end(vertices_end());
-    std::vector<float> lens;
-    TriMesh::Scalar len;
-    for (v_it = vertices_begin(); v_it != v_end; ++v_it)
+    if (!get_property_handle(curvature_color, "curvature_color"))
+      add_property(curvature_color, "curvature_color");
+    TriMesh::Scalar threshold = curvature_->magnitudePercentile(0.9);
+    const std::vector<Vec>& mean_normal = curvature_->meanCurvatureNormal();
+    for (size_t i = 0; i < mean_normal.size(); i++) {
+      TriMesh::Scalar c = mean_normal[i].norm() > threshold ? 0.0f : 1.0f;
+      property(curvature_color, VertexHandle((int)i)) = Point(c, c, c);
+    }
+  }
+
+  void TriMesh::computeCotWeights()
+  {
+    cot_weights_.assign(n_halfedges(), 0.0f);
+    TriMesh::VertexVertexIter vv_it;
+    TriMesh::VertexIter v_it;
+    TriMesh::Scalar wij;
+    TriMesh::Point p, p1, p2, p3;
+    int pid, p1id, p2id, p3id;
+    size_t wijID = 0;
+    for (v_it = vertices_begin(); v_it != vertices_end(); ++v_it)
     {
-      len = property(curvature, v_it).length();
-      lens.push_back(len);
+      for (vv_it = vv_iter(v_it); vv_it; ++vv_it)
+      {
+        // find alpha and beta (LSO paper), then calculate cotangent weights
+        //    P    -- P3
+        //   |     \     /
+        //   P1-- P2
+        // alpha is P_P1_P2, beta is P_P3_P2
+        p = point(v_it.handle());
+        pid = v_it.handle().idx();
+        p2 = point(vv_it);
+        p2id = vv_it.handle().idx();
+        --vv_it;
+        p3 = point(vv_it);
+        p3id = vv_it.handle().idx();
+        ++vv_it;
+        ++vv_it;
+        p1 = point(vv_it);
+        p1id = vv_it.handle().idx();
+        --vv_it;
+        // wij = 1/2 * (cot(alpha) + cot(beta)), for boundary edge, there is only one such edge
+        wij = 0;
+        if (!is_boundary(find_halfedge(vertex_handle(pid), vertex_handle(p2id)))
+          && !is_boundary(find_halfedge(vertex_handle(p2id), vertex_handle(pid)))) // not a boundary edge
+          wij = ((p - p1) | (p2 - p1)) / ((p - p1) % (p2 - p1)).length() + ((p - p3) | (p2 - p3)) / ((p - p3) % (p2 - p3)).length();
+        else // boundary edge, only have one such angle
+        {
+          if (p1id == p3id) // two angles are the same, eg. corner of a square
+            wij = ((p - p1) | (p2 - p1)) / ((p - p1) % (p2 - p1)).length();
+          else // find the angle not on the boundary
+          {
+            if (!is_boundary(find_halfedge(vertex_handle(pid), vertex_handle(p1id)))
+              && !is_boundary(find_halfedge(vertex_handle(p1id), vertex_handle(pid))))
+              wij = ((p - p1) | (p2 - p1)) / ((p - p1) % (p2 - p1)).length();
+            else
+              wij = ((p - p3) | (p2 - p3)) / ((p - p3) % (p2 - p3)).length();
+          }
+        }
+        if (wijID < cot_weights_.size())
+          cot_weights_[wijID] = wij / 2;
+        wijID++;
+      }
     }
-    std::sort(lens.begin(), lens.end());
-    TriMesh::Scalar threshold = lens[(unsigned int)ceil(9 * n_vertices() / 10.0)];
-    for (v_it = vertices_begin(); v_it != v_end; ++v_it)
+  }
+
+  void TriMesh::buildTriangleIndices()
+  {
+    tri_indices_.resize(n_faces() * 3);
+    size_t i = 0;
+    for (TriMesh::ConstFaceIter fit(faces_begin()), fEnd(faces_end()); fit != fEnd; ++fit)
     {
-      if (property(curvature, v_it).length() > threshold)
-        len = 1;
-      else
-        len = 0;
-      property(curvature_color, v_it)[0] = 1 - len;
-      property(curvature_color, v_it)[1] = 1 - len;
-      property(curvature_color, v_it)[2] = 1 - len;
+      TriMesh::ConstFaceVertexIter fvit = cfv_iter(fit.handle());
+      tri_indices_[i++] = fvit.handle().idx(); ++fvit;
+      tri_indices_[i++] = fvit.handle().idx(); ++fvit;
+      tri_indices_[i++] = fvit.handle().idx();
     }
-    lens.clear();
   }
 
   bool TriMesh::read(const char* filename, OpenMesh::IO::Options* opt)
   {
+    // float normals and texture coordinates as the attributes ask for; the quantized
+    // texture coordinates are made from the float ones
+    bool vertex_normals = (attributes_ & kVertexNormals) && !(attributes_ & kQuantizedNormals);
+    bool face_normals = (attributes_ & kFaceNormals) != 0;
+    bool texcoords = (attributes_ & kTexCoords) != 0;
+    if (vertex_normals && !has_vertex_normals())
+      this->request_vertex_normals();
+    else if (!vertex_normals && has_vertex_normals())
+      this->release_vertex_normals();
+    if (face_normals && !has_face_normals())
+      this->request_face_normals();
+    else if (!face_normals && has_face_normals())
+      this->release_face_normals();
+    if (texcoords && !has_vertex_texcoords2D())
+      this->request_vertex_texcoords2D();
+    else if (!texcoords && has_vertex_texcoords2D())
+      this->release_vertex_texcoords2D();
+    oct_normals_.clear();
+    unorm_texcoords_.clear();
+
     OpenMesh::IO::Options default_opt;
     default_opt += OpenMesh::IO::Options::VertexNormal;
     default_opt += OpenMesh::IO::Options::VertexTexCoord;
@@ -98,41 +410,253 @@ namespace hj
     default_opt += OpenMesh::IO::Options::FaceTexCoord;
     if (!opt)
       opt = &default_opt;
+    if (!vertex_normals)
+      *opt -= OpenMesh::IO::Options::VertexNormal;
+    if (!face_normals)
+      *opt -= OpenMesh::IO::Options::FaceNormal;
+    if (!texcoords)
+      *opt -= OpenMesh::IO::Options::VertexTexCoord;
+
+    invalidateBoundingBox();
+    DEL_PTR(curvature_);
+    original_vertex_.clear();
+    original_face_.clear();
 
-    this->request_vertex_normals();
-    this->request_vertex_texcoords2D();
-    this->request_face_normals();
+    // a cache made from the same file content skips parsing altogether
+    uint64_t source_size = 0, source_hash = 0;
+    std::string cache;
+    if (use_cache_ && attributes_ == kDefaultAttributes) {
+      MappedFile source;
+      if (source.Open(filename)) {
+        source_size = source.GetSize();
+        source_hash = MeshCache::Hash(source.GetData(), source.GetSize());
+        cache = MeshCache::CachePath(filename);
+        if (MeshCache::Read(cache, source_size, source_hash, reorder_, this)) {
+          std::cout << "Mesh loaded from cache " << cache << "\n";
+          *opt = option;
+          resetMoved();
+          return true;
+        }
+      }
+    }
 
-    if (!OpenMesh::IO::read_mesh(*this, filename, *opt)) {
+    // the parallel importer handles the common formats, OpenMesh the rest and
+    // whatever variants the importer declines
+    bool imported = MeshImporter::CanRead(filename) && MeshImporter::Read(filename, this, opt);
+    if (!imported && !OpenMesh::IO::read_mesh(*this, filename, *opt)) {
       return false;
     }
 
-    // update face and vertex normals     
-    if (!opt->check(OpenMesh::IO::Options::FaceNormal))
-      this->update_face_normals();
-    else
+    // update face and vertex normals the file does not provide; updateNormals() also
+    // computes the face normals
+    if ((attributes_ & kQuantizedNormals) && (attributes_ & kVertexNormals))
+      oct_normals_.assign(2 * n_vertices(), 0);
+    bool file_face_normals = face_normals && opt->check(OpenMesh::IO::Options::FaceNormal);
+    bool file_vertex_normals = vertex_normals && opt->check(OpenMesh::IO::Options::VertexNormal);
+    if (file_face_normals)
       std::cout << "File provides face normals\n";
-
-    if (!opt->check(OpenMesh::IO::Options::VertexNormal))
-      this->update_vertex_normals();
-    else
+    if (file_vertex_normals)
       std::cout << "File provides vertex normals\n";
+    if (hasNormals() && !file_vertex_normals) {
+      std::vector<VertexHandle> all(n_vertices());
+      for (size_t i = 0; i < all.size(); i++)
+        all[i] = VertexHandle((int)i);
+      updateNormals(all);
+    }
+    else if (face_normals && !file_face_normals)
+      this->update_face_normals();
 
     // check for texcoord.
     if (opt->check(OpenMesh::IO::Options::VertexTexCoord))
       std::cout << "File provides texture coordinates\n";
 
     option = *opt;
+    if ((attributes_ & kQuantizedTexCoords) && has_vertex_texcoords2D())
+      quantizeTexCoords();
+    buildTriangleIndices();
+    releaseCotWeights();
+    resetMoved();
+    if (reorder_)
+      reorder();
+
+    // the cache keeps the mesh in the order it is used in, a cache hit does not
+    // reorder again
+    if (!cache.empty()) {
+      computeCotWeights();
+      if (!MeshCache::Write(cache, source_size, source_hash, *this))
+        std::cout << "Cannot write mesh cache " << cache << "\n";
+    }
     return true;
   }
 
+  void TriMesh::reorder()
+  {
+    int nv = (int)n_vertices(), nf = (int)n_faces();
+    if (!nv || !nf)
+      return;
+
+    std::vector<int> vorder, forder, rank(nv);
+    MeshReorder::VertexOrder((const float*)points(), nv, vorder);
+    for (int i = 0; i < nv; i++)
+      rank[vorder[i]] = i;
+    std::vector<int> faces(3 * (size_t)nf);
+    for (int c = 0; c < 3 * nf; c++)
+      faces[c] = rank[tri_indices_[c]];
+    MeshReorder::FaceOrder(faces, nv, forder);
+
+    std::vector<int> triangles(3 * (size_t)nf);
+    for (int f = 0; f < nf; f++) {
+      for (int k = 0; k < 3; k++)
+        triangles[3 * f + k] = faces[3 * forder[f] + k];
+    }
+    std::vector<float> positions(3 * (size_t)nv), normals, texcoords;
+    if (has_vertex_normals())
+      normals.resize(3 * (size_t)nv);
+    if (has_vertex_texcoords2D() && option.check(OpenMesh::IO::Options::VertexTexCoord))
+      texcoords.resize(2 * (size_t)nv);
+    std::vector<short> oct(oct_normals_.size());
+    std::vector<unsigned short> unorm(unorm_texcoords_.size());
+    const float* p = (const float*)points();
+    const float* n = has_vertex_normals() ? (const float*)vertex_normals() : NULL;
+    const float* t = has_vertex_texcoords2D() ? (const float*)texcoords2D() : NULL;
+#pragma omp parallel for
+    for (int i = 0; i < nv; i++) {
+      int v = vorder[i];
+      for (int c = 0; c < 3; c++)
+        positions[3 * i + c] = p[3 * v + c];
+      if (!normals.empty()) {
+        for (int c = 0; c < 3; c++)
+          normals[3 * i + c] = n[3 * v + c];
+      }
+      if (!texcoords.empty()) {
+        texcoords[2 * i] = t[2 * v];
+        texcoords[2 * i + 1] = t[2 * v + 1];
+      }
+      if (!oct.empty()) {
+        oct[2 * i] = oct_normals_[2 * v];
+        oct[2 * i + 1] = oct_normals_[2 * v + 1];
+      }
+      if (!unorm.empty()) {
+        unorm[2 * i] = unorm_texcoords_[2 * v];
+        unorm[2 * i + 1] = unorm_texcoords_[2 * v + 1];
+      }
+    }
+    std::vector<Normal> face_normals(has_face_normals() ? nf : 0);
+    for (int f = 0; f < (int)face_normals.size(); f++)
+      face_normals[f] = normal(FaceHandle(forder[f]));
+
+    // the cotangent weights are kept per vertex and one-ring neighbor, in the order
+    // of computeCotWeights(); the neighbor of each weight is noted to find it again
+    // in the new order
+    std::vector<int> ring_start, ring_vertex;
+    std::vector<float> weights;
+    if (!cot_weights_.empty() && cot_weights_.size() == n_halfedges()) {
+      ring_start.assign(nv + 1, 0);
+      ring_vertex.reserve(cot_weights_.size());
+      for (int v = 0; v < nv; v++) {
+        for (TriMesh::VertexVertexIter vv_it = vv_iter(VertexHandle(v)); vv_it; ++vv_it)
+          ring_vertex.push_back(vv_it.handle().idx());
+        ring_start[v + 1] = (int)ring_vertex.size();
+      }
+      if (ring_vertex.size() == cot_weights_.size())
+        weights.swap(cot_weights_);
+    }
+
+    MeshImporter::Build(positions, normals, texcoords, triangles, this);
+    if ((int)n_faces() != nf) {
+      // a non-manifold mesh that add_face() accepts only in its original face order
+      std::cout << "Faces cannot be reordered, keeping the file order\n";
+      for (int f = 0; f < nf; f++)
+        forder[f] = f;
+      MeshImporter::Build(positions, normals, texcoords, faces, this);
+      if (has_face_normals())
+        update_face_normals();
+    } else {
+      for (int f = 0; f < (int)face_normals.size(); f++)
+        set_normal(FaceHandle(f), face_normals[f]);
+    }
+    oct_normals_.swap(oct);
+    unorm_texcoords_.swap(unorm);
+    original_vertex_.swap(vorder);
+    original_face_.swap(forder);
+
+    releaseCotWeights();
+    if (!weights.empty() && n_halfedges() == weights.size()) {
+      cot_weights_.assign(weights.size(), 0.0f);
+      size_t id = 0;
+      for (int v = 0; v < nv; v++) {
+        int old = original_vertex_[v];
+        for (TriMesh::VertexVertexIter vv_it = vv_iter(VertexHandle(v)); vv_it; ++vv_it, ++id) {
+          int neighbor = original_vertex_[vv_it.handle().idx()];
+          for (int k = ring_start[old]; k < ring_start[old + 1]; k++) {
+            if (ring_vertex[k] == neighbor) {
+              cot_weights_[id] = weights[k];
+              break;
+            }
+          }
+        }
+      }
+    }
+
+    buildTriangleIndices();
+    invalidateBoundingBox();
+    resetMoved();
+  }
+
   bool TriMesh::save(const char* filename, OpenMesh::IO::Options* opt)
   {
     OpenMesh::IO::Options default_opt;
     if (!opt)
       opt = &default_opt;
 
-    if (!OpenMesh::IO::write_mesh(*this, filename, *opt))
+    bool reordered = !original_vertex_.empty() && original_face_.size() == n_faces();
+    if (!reordered && attributes_ == kDefaultAttributes) {
+      if (!OpenMesh::IO::write_mesh(*this, filename, *opt))
+        return false;
+      return true;
+    }
+
+    // a copy in the order of the file the mesh came from, with float attributes
+    int nv = (int)n_vertices(), nf = (int)n_faces();
+    std::vector<float> positions(3 * (size_t)nv), normals, texcoords;
+    if (hasNormals())
+      normals.resize(3 * (size_t)nv);
+    if (hasTexCoords())
+      texcoords.resize(2 * (size_t)nv);
+    for (int i = 0; i < nv; i++) {
+      VertexHandle vh(i);
+      int v = reordered ? original_vertex_[i] : i;
+      const Point& p = point(vh);
+      for (int c = 0; c < 3; c++)
+        positions[3 * v + c] = p[c];
+      if (!normals.empty()) {
+        Normal n = vertexNormal(vh);
+        for (int c = 0; c < 3; c++)
+          normals[3 * v + c] = n[c];
+      }
+      if (!texcoords.empty()) {
+        TexCoord2D t = vertexTexCoord(vh);
+        texcoords[2 * v] = t[0];
+        texcoords[2 * v + 1] = t[1];
+      }
+    }
+    std::vector<int> triangles(3 * (size_t)nf);
+    for (int f = 0; f < nf; f++) {
+      int g = reordered ? original_face_[f] : f;
+      for (int k = 0; k < 3; k++) {
+        int v = tri_indices_[3 * f + k];
+        triangles[3 * g + k] = reordered ? original_vertex_[v] : v;
+      }
+    }
+    TriMesh original;
+    if (!normals.empty())
+      original.request_vertex_normals();
+    if (!texcoords.empty())
+      original.request_vertex_texcoords2D();
+    original.request_face_normals();
+    MeshImporter::Build(positions, normals, texcoords, triangles, &original);
+    original.update_face_normals();
+    if (!OpenMesh::IO::write_mesh(original, filename, *opt))
       return false;
     return true;
   }
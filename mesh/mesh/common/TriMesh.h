@@ -1,6 +1,7 @@
 #ifndef HJ_TriMesh_h__
 #define HJ_TriMesh_h__
 
+#include <vector>
 #include "meshext.h"
 
 namespace hj
@@ -10,10 +11,11 @@ namespace hj
   typedef OpenMesh::Vec3f Vec;
   typedef OpenMesh::Vec3f Normal;
 
+  class Curvature;
+
+  /** normals and texture coordinates are requested by read(), see TriMesh::Attribute. */
   struct TriMeshTraits : public OpenMesh::DefaultTraits
   {
-    VertexAttributes(OpenMesh::Attributes::Normal);
-    FaceAttributes(OpenMesh::Attributes::Normal);
   };
 
   class TriMesh : public OpenMesh::TriMesh_ArrayKernelT<TriMeshTraits>
@@ -22,20 +24,259 @@ namespace hj
     TriMesh(void);
     virtual ~TriMesh(void);
 
+    /** number of vertices per bounding box block. */
+    static const size_t kBoundingBlockSize = 1024;
+
+    /**
+    * Attributes read() keeps besides the points, see setAttributes().
+    */
+    enum Attribute
+    {
+      kVertexNormals = 1,       // vertex normals
+      kFaceNormals = 2,         // face normals
+      kTexCoords = 4,           // vertex texture coordinates, if the file has them
+      kQuantizedNormals = 8,    // vertex normals as octahedral 2 x 16-bit, see octNormals()
+      kQuantizedTexCoords = 16, // texture coordinates as 2 x 16-bit unorm, see unormTexCoords()
+      kDefaultAttributes = kVertexNormals | kFaceNormals | kTexCoords
+    };
+
   private:
     Point bbox_min, bbox_max;
     OpenMesh::IO::Options option;
 
+    /**
+    * min and max corners of a complete binary tree over the vertex blocks: node 1 is
+    * the root, the leaves start at bbox_leaves_ and the padding leaves are empty.
+    */
+    std::vector<Point> bbox_tree_min_, bbox_tree_max_;
+    size_t bbox_leaves_;
+
+    /** blocks whose points changed since the last needBoundingBox(), listed once each. */
+    std::vector<unsigned char> block_dirty_;
+    std::vector<int> dirty_blocks_;
+
+    /** vertices whose points changed since the last needNormals(), listed once each. */
+    std::vector<unsigned char> vertex_moved_;
+    std::vector<VertexHandle> moved_vertices_;
+
+    /** scratch marks of updateNormals(), all zero between calls. */
+    std::vector<unsigned char> face_mark_, vertex_mark_;
+
+    /** curvature engine, created by request_curvature() and kept up to date by needNormals(). */
+    Curvature* curvature_;
+
+    /** vertex indices of all faces, 3 per face in face order. */
+    std::vector<unsigned int> tri_indices_;
+
+    /** cotangent weights of the current positions, empty if not computed. */
+    std::vector<float> cot_weights_;
+
+    /** read and write the binary cache next to the mesh file. */
+    bool use_cache_;
+
+    /** Attribute flags of read(). */
+    unsigned int attributes_;
+
+    /** quantized vertex normals and texture coordinates, 2 per vertex, empty if not used. */
+    std::vector<short> oct_normals_;
+    std::vector<unsigned short> unorm_texcoords_;
+    float texcoord_min_[2], texcoord_size_[2];
+
+    /** reorder vertices and faces for locality after read(). */
+    bool reorder_;
+
+    /** file index of every vertex and face after reorder(), empty if not reordered. */
+    std::vector<int> original_vertex_, original_face_;
+
+    /** vertices [changed_first_, changed_last_) hold every point or normal changed since takeChangedRange(). */
+    int changed_first_, changed_last_;
+
+    friend class MeshCache;
+
   public:
+    /**
+    * Brings bbox up to date. Only the blocks of kBoundingBlockSize vertices marked by
+    * markPointDirty() are scanned again, followed by their path to the tree root; all
+    * of them after read() or a change in the number of vertices.
+    */
     void needBoundingBox();
 
+    /**
+    * Records that the position of a vertex was changed through point(), for the
+    * bounding box and the normals. Not thread safe.
+    */
+    void markPointDirty(VertexHandle vh)
+    {
+      size_t b = (size_t)vh.idx() / kBoundingBlockSize;
+      if (b < block_dirty_.size() && !block_dirty_[b]) {
+        block_dirty_[b] = 1;
+        dirty_blocks_.push_back((int)b);
+      }
+      size_t v = (size_t)vh.idx();
+      if (v < vertex_moved_.size() && !vertex_moved_[v]) {
+        vertex_moved_[v] = 1;
+        moved_vertices_.push_back(vh);
+      }
+      extendChangedRange(vh.idx());
+    }
+
+    /**
+    * Sets the position of a vertex, marking it dirty if it changed.
+    */
+    void movePoint(VertexHandle vh, const Point& p)
+    {
+      Point& q = point(vh);
+      if (q != p) {
+        q = p;
+        markPointDirty(vh);
+      }
+    }
+
+    /**
+    * Forgets the bounding box tree, the next needBoundingBox() scans all vertices.
+    */
+    void invalidateBoundingBox();
+
+    /**
+    * Brings the face and vertex normals up to date after the vertices marked by
+    * markPointDirty() moved, see updateNormals(), and the curvature if requested.
+    */
+    void needNormals();
+
+    /**
+    * Recomputes the normals of the faces around the given vertices, then the normals
+    * of all vertices of those faces, the same way update_normals() does, in the forms
+    * the attributes keep. The cost is in the size of the moved region, not of the mesh.
+    */
+    void updateNormals(const std::vector<VertexHandle>& moved);
+
+    /**
+    * Takes the range of vertices whose points or normals changed since the last call,
+    * for keeping copies such as GPU buffers up to date; call needNormals() first.
+    * After reorder() the vertices of a region are close in the arrays, so the range
+    * of a local deformation is a small part of the mesh.
+    * @return: false if nothing changed, then the range is empty.
+    */
+    bool takeChangedRange(int& first, int& last)
+    {
+      first = changed_first_;
+      last = changed_last_;
+      changed_first_ = changed_last_ = 0;
+      return first < last;
+    }
+
+    /** unit normal of a face from its points. */
+    Normal faceNormal(FaceHandle fh) const;
+
     Point getSceneCenter() { return (bbox_min + bbox_max) / 2.0f; };
     float getSceneRadius() { return (bbox_max - bbox_min).norm() / 2.0f; };
+    /**
+    * Computes the curvature (see Curvature) and stores the mean curvature normals in
+    * the vertex property "curvature". Later calls only bring the cached values up to
+    * date with the vertices moved since.
+    */
     void request_curvature();
+
+    /**
+    * Colors the vertices above the 90th percentile of the curvature magnitude black,
+    * the others white, in the vertex property "curvature_color".
+    */
     void request_curvature_color();
 
+    /**
+    * @return: the curvature engine, NULL until request_curvature() was called.
+    */
+    const Curvature* curvature() const { return curvature_; }
+
+    /**
+    * Vertex indices of all faces (3 per face, in face order), as drawn with GL_TRIANGLES.
+    */
+    const std::vector<unsigned int>& triangleIndices() const { return tri_indices_; }
+
+    /**
+    * Cotangent weights wij = 1/2 * (cot(alpha) + cot(beta)) of every vertex's one-ring,
+    * vertex by vertex in vv_iter order (one per halfedge). Empty unless loaded from the
+    * cache or computed by computeCotWeights() since the positions last changed.
+    */
+    const std::vector<float>& cotWeights() const { return cot_weights_; }
+    void computeCotWeights();
+    void releaseCotWeights() { std::vector<float>().swap(cot_weights_); }
+
+    /**
+    * Enables the binary mesh cache (on by default): read() loads <file>.hjmc if it was
+    * made from the same file, and writes it after parsing the file otherwise.
+    */
+    void setUseCache(bool use) { use_cache_ = use; }
+
+    /**
+    * Enables reordering on read() (off by default): the vertices are sorted along a
+    * space-filling curve and the faces for the vertex cache, see MeshReorder, so that
+    * neighbors are close in memory. save() writes the file order back.
+    */
+    void setReorder(bool reorder) { reorder_ = reorder; }
+
+    /**
+    * Selects the attributes read() keeps (kDefaultAttributes by default). A deformation
+    * session needs only the points, and the attributes take more memory than them: 12
+    * bytes per vertex for each of the normals and 8 for texture coordinates, plus 12
+    * per face for the face normals. The quantized forms take 4 bytes per vertex. The
+    * binary cache is used with the default attributes only.
+    */
+    void setAttributes(unsigned int attributes) { attributes_ = attributes; }
+    unsigned int attributes() const { return attributes_; }
+
+    /** True if the mesh has vertex normals, as floats or quantized. */
+    bool hasNormals() const { return has_vertex_normals() || !oct_normals_.empty(); }
+
+    /** True if the mesh has texture coordinates, as floats or quantized. */
+    bool hasTexCoords() const;
+
+    /** normal of a vertex from whichever form is kept, (0, 0, 0) if none. */
+    Normal vertexNormal(VertexHandle vh) const;
+
+    /** texture coordinates of a vertex from whichever form is kept, (0, 0) if none. */
+    TexCoord2D vertexTexCoord(VertexHandle vh) const;
+
+    /**
+    * Quantized normals, 2 per vertex, see EncodeOctahedral(); NULL unless kQuantizedNormals.
+    */
+    const short* octNormals() const { return oct_normals_.empty() ? NULL : &oct_normals_[0]; }
+
+    /**
+    * Quantized texture coordinates, 2 per vertex over the range texCoordMin() to
+    * texCoordMin() + texCoordSize(); NULL unless kQuantizedTexCoords.
+    */
+    const unsigned short* unormTexCoords() const { return unorm_texcoords_.empty() ? NULL : &unorm_texcoords_[0]; }
+    const float* texCoordMin() const { return texcoord_min_; }
+    const float* texCoordSize() const { return texcoord_size_; }
+
+    /**
+    * Index in the file of every vertex and face, empty unless read() reordered them.
+    */
+    const std::vector<int>& originalVertexIndices() const { return original_vertex_; }
+    const std::vector<int>& originalFaceIndices() const { return original_face_; }
+
     bool read(const char* filename, OpenMesh::IO::Options* opt = NULL);
     bool save(const char* filename, OpenMesh::IO::Options* opt = NULL);
+
+  private:
+    void buildTriangleIndices();
+    void resetMoved();
+    void reorder();
+    void quantizeTexCoords();
+
+    /** adds vertex v to the changed range. */
+    void extendChangedRange(int v)
+    {
+      if (changed_first_ >= changed_last_) {
+        changed_first_ = v;
+        changed_last_ = v + 1;
+      } else if (v < changed_first_) {
+        changed_first_ = v;
+      } else if (v >= changed_last_) {
+        changed_last_ = v + 1;
+      }
+    }
   };
 }
 
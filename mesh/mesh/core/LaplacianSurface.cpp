@@ -4,6 +4,9 @@
 
 namespace hj
 {
+  // the handle solve stores n x k values, fall back to full solves above this
+  static const size_t kMaxHandleResponse = 8 * 1024 * 1024;
+
   LaplacianSurface::LaplacianSurface(MeshRenderer* ren)
     : ren_(ren)
     , smoothLSOWeight(0)
@@ -13,13 +16,13 @@ namespace hj
     , xyz(NULL)
     , ctrlmark(NULL)
     , OrigMesh(NULL)
+    , handleSolve(false)
+    , rotationChanged(true)
   {
     InitTaucsInterface();
+    // a factor that cannot fit in memory is kept out of core instead of crashing
+    SetDefaultMemoryBudget(-1, SOLVER_BUDGET_OUT_OF_CORE);
     Lc = CreateMatrix(1, 1);
-    eye = Matrix(3, 3);
-    for (int i = 1; i <= 3; i++)
-    for (int j = 1; j <= 3; j++)
-      i == j ? eye(i, j) = 1 : eye(i, j) = 0;
   }
 
   LaplacianSurface::~LaplacianSurface(void)
@@ -34,59 +37,16 @@ namespace hj
 
   inline void LaplacianSurface::computeCotWij()
   {
+    // the mesh keeps the weights of its current positions (they may come from
+    // the mesh cache), they are only recomputed after a deformation
+    TriMesh* mesh = ren_->GetMesh();
+    if (mesh->cotWeights().size() != mesh->n_halfedges())
+      mesh->computeCotWeights();
+    const std::vector<float>& w = mesh->cotWeights();
     DEL_ARRAY(wijAll);
-    int n = (int)ren_->GetMesh()->n_vertices();
-    wijAll = new float[n * 10];
-    memset(wijAll, 0, sizeof(float)*n * 10);
-    TriMesh::VertexVertexIter vv_it;
-    TriMesh::VertexIter v_it;
-    TriMesh::Scalar wij;
-    TriMesh::Point p, p1, p2, p3;
-    int pid, p1id, p2id, p3id;
-    int wijID = 0;
-    for (v_it = ren_->GetMesh()->vertices_begin(); v_it != ren_->GetMesh()->vertices_end(); ++v_it)
-    {
-      for (vv_it = ren_->GetMesh()->vv_iter(v_it); vv_it; ++vv_it)
-      {
-        // find alpha and beta (LSO paper), then calculate cotangent weights
-        //    P    -- P3
-        //   |     \     /
-        //   P1-- P2
-        // alpha is P_P1_P2, beta is P_P3_P2
-        p = ren_->GetMesh()->point(v_it.handle());
-        pid = v_it.handle().idx();
-        p2 = ren_->GetMesh()->point(vv_it);
-        p2id = vv_it.handle().idx();
-        --vv_it;
-        p3 = ren_->GetMesh()->point(vv_it);
-        p3id = vv_it.handle().idx();
-        ++vv_it;
-        ++vv_it;
-        p1 = ren_->GetMesh()->point(vv_it);
-        p1id = vv_it.handle().idx();
-        --vv_it;
-        // wij = 1/2 * (cot(alpha) + cot(beta)), for boundary edge, there is only one such edge
-        wij = 0;
-        if (!ren_->GetMesh()->is_boundary(ren_->GetMesh()->find_halfedge(ren_->GetMesh()->vertex_handle(pid), ren_->GetMesh()->vertex_handle(p2id)))
-          && !ren_->GetMesh()->is_boundary(ren_->GetMesh()->find_halfedge(ren_->GetMesh()->vertex_handle(p2id), ren_->GetMesh()->vertex_handle(pid)))) // not a boundary edge
-          wij = ((p - p1) | (p2 - p1)) / ((p - p1) % (p2 - p1)).length() + ((p - p3) | (p2 - p3)) / ((p - p3) % (p2 - p3)).length();
-        else // boundary edge, only have one such angle
-        {
-          if (p1id == p3id) // two angles are the same, eg. corner of a square
-            wij = ((p - p1) | (p2 - p1)) / ((p - p1) % (p2 - p1)).length();
-          else // find the angle not on the boundary
-          {
-            if (!ren_->GetMesh()->is_boundary(ren_->GetMesh()->find_halfedge(ren_->GetMesh()->vertex_handle(pid), ren_->GetMesh()->vertex_handle(p1id)))
-              && !ren_->GetMesh()->is_boundary(ren_->GetMesh()->find_halfedge(ren_->GetMesh()->vertex_handle(p1id), ren_->GetMesh()->vertex_handle(pid))))
-              wij = ((p - p1) | (p2 - p1)) / ((p - p1) % (p2 - p1)).length();
-            else
-              wij = ((p - p3) | (p2 - p3)) / ((p - p3) % (p2 - p3)).length();
-          }
-        }
-        wijAll[wijID] = wij / 2;
-        wijID++;
-      }
-    }
+    wijAll = new float[MAX(w.size(), (size_t)1)];
+    if (!w.empty())
+      memcpy(wijAll, &w[0], w.size() * sizeof(float));
   }
 
   void LaplacianSurface::LSOLuXB()
@@ -152,15 +112,20 @@ namespace hj
     }
     DEL_ARRAY(xyz);;
     xyz = new taucsType[ren_->GetMesh()->n_vertices() * 3];
-    SolveATA(Lu, b3, xyz, 3);
+    if (!SolveATA(Lu, b3, xyz, 3))
+    {
+      ReleaseMatrix(Lu);
+      return;
+    }
     TriMesh::Point pttmp;
     // update points in mesh
     for (v_it = ren_->GetMesh()->vertices_begin(); v_it != ren_->GetMesh()->vertices_end(); ++v_it)
     {
-      ren_->GetMesh()->point(v_it.handle())[0] = (float)xyz[v_it.handle().idx()];
-      ren_->GetMesh()->point(v_it.handle())[1] = (float)xyz[v_it.handle().idx() + n];
-      ren_->GetMesh()->point(v_it.handle())[2] = (float)xyz[v_it.handle().idx() + n * 2];
+      int vid = v_it.handle().idx();
+      ren_->GetMesh()->movePoint(v_it.handle(),
+        TriMesh::Point((float)xyz[vid], (float)xyz[vid + n], (float)xyz[vid + n * 2]));
     }
+    ren_->GetMesh()->releaseCotWeights();
     ReleaseMatrix(Lu);
   }
 
@@ -182,17 +147,15 @@ namespace hj
     OrigMesh = new taucsType[n * 3];
     memset(OrigMesh, 0, n * 3 * sizeof(taucsType));
     // control points
-    for (unsigned int i = 0; i<ren_->GetControlPts().size(); i++)
-      ctrlmark[ren_->GetControlPts()[i].idx()] = 1;
+    const SelectionSet& controls = ren_->GetControlPts();
+    for (int i = controls.next(0); i >= 0; i = controls.next(i + 1))
+      ctrlmark[i] = 1;
     // anchor points
-    for (unsigned int i = 0; i<ren_->GetAnchorPts().size(); i++)
-      ctrlmark[ren_->GetAnchorPts()[i].idx()] = 1;
-    // pre-allocate for vector R
-    eye(3, 3) = 1;
-    R.clear();
-    R.reserve(sizeof(eye)*n);
-    for (int i = 0; i<n; i++)
-      R.push_back(eye);
+    const SelectionSet& anchors = ren_->GetAnchorPts();
+    for (int i = anchors.next(0); i >= 0; i = anchors.next(i + 1))
+      ctrlmark[i] = 1;
+    // all rotations start as identity
+    R.assign(n, Mat3d::identity());
     ReleaseMatrix(Lc);
     Lc = CreateMatrix(n, n);
     TriMesh::VertexIter v_it;
@@ -226,51 +189,44 @@ namespace hj
       }
     }
     FactorATA(Lc);
+    // control points are the only rows of b3 that change while dragging with
+    // fixed rotations; precompute their response so a move needs no sparse solve
+    controls.indices(handleIds);
+    handlePos.resize(handleIds.size() * 3);
+    handleSolve = !handleIds.empty()
+      && (size_t)n * handleIds.size() <= kMaxHandleResponse
+      && FactorHandles(Lc, &handleIds[0], (int)handleIds.size());
+    rotationChanged = true;
   }
 
   inline void LaplacianSurface::SVDRotation()
   {
     TriMesh::VertexVertexIter vv_it;
     TriMesh::VertexIter v_it;
-    Matrix U, V;
-    DiagonalMatrix D;
-    Matrix S;
-    Matrix P(1, 1);
-    Matrix Q(1, 1);
     int n = (int)ren_->GetMesh()->n_vertices();
     int vid, vvid;
     int wijID = 0; // index for wij
     for (v_it = ren_->GetMesh()->vertices_begin(); v_it != ren_->GetMesh()->vertices_end(); ++v_it)
     {
-      int degree = 0;
-      for (vv_it = ren_->GetMesh()->vv_iter(v_it); vv_it; ++vv_it)
-        degree++;
-      P.ReSize(3, degree);
-      Q.ReSize(3, degree);
-      degree = 0;
       vid = v_it.handle().idx();
+      // Compute the 3 by 3 covariance matrix S = P * W * Q.t() = sum of wij * pij * qij.t()
+      // as a sum of outer products, P and Q are never formed
+      Mat3d S = Mat3d::zero();
       for (vv_it = ren_->GetMesh()->vv_iter(v_it); vv_it; ++vv_it)
       {
         // eij = pi - pj, pi is v_it, pj is vv_it, including weights wij
-        degree++;
         vvid = vv_it.handle().idx();
-        P(1, degree) = (OrigMesh[vid] - OrigMesh[vvid]) * wijAll[wijID];
-        P(2, degree) = (OrigMesh[vid + n] - OrigMesh[vvid + n]) * wijAll[wijID];
-        P(3, degree) = (OrigMesh[vid + 2 * n] - OrigMesh[vvid + 2 * n]) * wijAll[wijID];
-        Q(1, degree) = xyz[vid] - xyz[vvid];
-        Q(2, degree) = xyz[vid + n] - xyz[vvid + n];
-        Q(3, degree) = xyz[vid + 2 * n] - xyz[vvid + 2 * n];
+        Vec3d pij = MakeVec3(
+          (OrigMesh[vid] - OrigMesh[vvid]) * wijAll[wijID],
+          (OrigMesh[vid + n] - OrigMesh[vvid + n]) * wijAll[wijID],
+          (OrigMesh[vid + 2 * n] - OrigMesh[vvid + 2 * n]) * wijAll[wijID]);
+        Vec3d qij = MakeVec3(xyz[vid] - xyz[vvid], xyz[vid + n] - xyz[vvid + n], xyz[vid + 2 * n] - xyz[vvid + 2 * n]);
+        S.addOuter(pij, qij);
         wijID++;
       }
-      // Compute the 3 by 3 covariance matrix
-      // actually S = (P * W * Q.t()); W is already considerred in the previous step (P=P*W)
-      S = (P * Q.t());
-      // Compute the singular value decomposition S = UDV.t
-      SVD(S, D, U, V);  // X = U * D * V.t()		
-      eye(3, 3) = (V*U.t()).Determinant();
-      // V*U.t may be reflection (determinant = -1). in this case, we need to change the sign of 
-      // column of U corresponding to the smallest singular value (3rd column)
-      R[v_it.handle().idx()] = (V * eye * U.t()); //Ri = (V * eye * U.t());
+      // Ri = V * diag(1, 1, det(V * U.t())) * U.t() for S = U * D * V.t(); V*U.t may be a
+      // reflection, then the column of U of the smallest singular value changes sign
+      R[vid] = FitRotation(S);
     }
   }
 
@@ -280,10 +236,29 @@ namespace hj
     TriMesh::VertexVertexIter vv_it;
     TriMesh::VertexIter v_it;
     int vid, vvid;
-    ColumnVector pijMat(3);
-    ColumnVector RijPijMat(3);
+    int k = (int)handleIds.size();
     for (int iter = 0; iter <= ARAPIteration; iter++)
     {
+      if (handleSolve && !rotationChanged)
+      {
+        // only the control points moved since xyz was solved: k x k solve + GEMV
+        for (int i = 0; i < k; i++)
+        {
+          TriMesh::Point p = ren_->GetMesh()->point(ren_->GetMesh()->vertex_handle(handleIds[i]));
+          handlePos[i] = p[0];
+          handlePos[i + k] = p[1];
+          handlePos[i + 2 * k] = p[2];
+        }
+        if (SolveHandles(Lc, xyz, &handlePos[0], xyz, 3))
+        {
+          if (iter > 0)
+          {
+            SVDRotation();
+            rotationChanged = true;
+          }
+          continue;
+        }
+      }
       int wijID = 0;
       // update vector b3 = wij/2 * (Ri+Rj) * (pi - pj), where pi and pj are coordinates of the original mesh
       for (v_it = ren_->GetMesh()->vertices_begin(); v_it != ren_->GetMesh()->vertices_end(); ++v_it)
@@ -297,14 +272,12 @@ namespace hj
           for (vv_it = ren_->GetMesh()->vv_iter(v_it); vv_it; ++vv_it)
           {
             vvid = vv_it.handle().idx();
-            pijMat(1) = OrigMesh[vid] - OrigMesh[vvid];
-            pijMat(2) = OrigMesh[vid + n] - OrigMesh[vvid + n];
-            pijMat(3) = OrigMesh[vid + 2 * n] - OrigMesh[vvid + 2 * n];
-            RijPijMat = ((R[vid] + R[vvid]) * pijMat);
+            Vec3d pij = MakeVec3(OrigMesh[vid] - OrigMesh[vvid], OrigMesh[vid + n] - OrigMesh[vvid + n], OrigMesh[vid + 2 * n] - OrigMesh[vvid + 2 * n]);
+            Vec3d RijPij = (R[vid] + R[vvid]) * pij;
             double wijtmp = wijAll[wijID] / 2;
-            b3[vid] += RijPijMat(1) * wijtmp;
-            b3[vid + n] += RijPijMat(2) * wijtmp;
-            b3[vid + 2 * n] += RijPijMat(3) * wijtmp;
+            b3[vid] += RijPij[0] * wijtmp;
+            b3[vid + n] += RijPij[1] * wijtmp;
+            b3[vid + 2 * n] += RijPij[2] * wijtmp;
             wijID++;
           }
         }
@@ -317,23 +290,34 @@ namespace hj
           b3[vid + 2 * n] = ren_->GetMesh()->point(v_it.handle())[2];
         }
       }
-      SolveATA(Lc, b3, xyz, 3);
+      if (!SolveATA(Lc, b3, xyz, 3))
+        return; // keep the mesh as it is
+      rotationChanged = false;
       if (iter > 0) // if iter = 0, just means naive LSE (Ri is identity matrix)
+      {
         SVDRotation();
+        rotationChanged = true;
+      }
     }
     // update vertices' coordinates 
     for (v_it = ren_->GetMesh()->vertices_begin(); v_it != ren_->GetMesh()->vertices_end(); ++v_it)
     {
-      ren_->GetMesh()->point(v_it.handle())[0] = (float)xyz[v_it.handle().idx()];
-      ren_->GetMesh()->point(v_it.handle())[1] = (float)xyz[v_it.handle().idx() + n];
-      ren_->GetMesh()->point(v_it.handle())[2] = (float)xyz[v_it.handle().idx() + n * 2];
+      vid = v_it.handle().idx();
+      ren_->GetMesh()->movePoint(v_it.handle(),
+        TriMesh::Point((float)xyz[vid], (float)xyz[vid + n], (float)xyz[vid + n * 2]));
     }
+    ren_->GetMesh()->releaseCotWeights();
   }
 
   void LaplacianSurface::translationDeform(TriMesh::Point &translation)
   {
-    for (unsigned int i = 0; i<ren_->GetControlPts().size(); i++)
-      ren_->GetMesh()->point(ren_->GetControlPts()[i]) = ren_->GetMesh()->point(ren_->GetControlPts()[i]) + translation;
+    const SelectionSet& controls = ren_->GetControlPts();
+    for (int i = controls.next(0); i >= 0; i = controls.next(i + 1))
+    {
+      TriMesh::VHandle vh(i);
+      ren_->GetMesh()->movePoint(vh, ren_->GetMesh()->point(vh) + translation);
+    }
+    ren_->GetMesh()->releaseCotWeights();
   }
 
   void LaplacianSurface::rotationDeform(double angle, TriMesh::Point centroid, TriMesh::Point dir)
@@ -347,19 +331,17 @@ namespace hj
     GLdouble m[16];
     glGetDoublev(GL_MODELVIEW_MATRIX, m);
     glPopMatrix();
-    Matrix transform(4, 4);
-    for (int i = 0; i<4; i++)
-    for (int j = 0; j<4; j++)
-      transform(j + 1, i + 1) = m[i * 4 + j];
-    ColumnVector pt(4);
-    for (unsigned int i = 0; i<ren_->GetControlPts().size(); i++)
+    Mat4d transform = Mat4d::fromColumnMajor(m);
+    const SelectionSet& controls = ren_->GetControlPts();
+    for (int i = controls.next(0); i >= 0; i = controls.next(i + 1))
     {
+      TriMesh::VHandle vh(i);
+      TriMesh::Point& p = ren_->GetMesh()->point(vh);
+      Vec3d pt = transform.transformPoint(MakeVec3((double)p[0], (double)p[1], (double)p[2]));
       for (int j = 0; j<3; j++)
-        pt(j + 1) = (ren_->GetMesh()->point(ren_->GetControlPts()[i]))[j];
-      pt(4) = 1;
-      pt = transform * pt;
-      for (int j = 0; j<3; j++)
-        (ren_->GetMesh()->point(ren_->GetControlPts()[i]))[j] = (float)pt(j + 1);
+        p[j] = (float)pt[j];
+      ren_->GetMesh()->markPointDirty(vh);
     }
+    ren_->GetMesh()->releaseCotWeights();
   }
 }
\ No newline at end of file
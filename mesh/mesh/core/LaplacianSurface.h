@@ -3,7 +3,7 @@
 
 #include "common/macro.h"
 #include "common/TriMesh.h"
-#include "newmatap.h" // need matrix applications
+#include "common/SmallMatrix.h"
 #include "taucs_interface.h"
 
 
@@ -49,13 +49,16 @@ namespace hj
     // matrix id
     int Lu; // for LSO smooth
     int Lc; // for ARAP shape modeling
-    std::vector<Matrix> R; // rotation matrix
+    std::vector<Mat3d> R; // rotation matrix
     int *ctrlmark; // control points' vidmark
     TriMesh::Scalar *wijAll; // cotangent weight matrix
     taucsType *b3; // b matrix
     taucsType *xyz; // solution matrix
     taucsType *OrigMesh; // copy original positions
-    Matrix eye; // identity matrix, defined here since it's frequently used
+    std::vector<int> handleIds; // control points moved by the handle solve
+    std::vector<taucsType> handlePos; // their positions, x,y,z coordinates
+    bool handleSolve; // Lc has the Schur complement data of the control points
+    bool rotationChanged; // R changed since the last full solve, b3 must be rebuilt
 
     int smoothLSOWeight;
     int smoothLSOAnchor; // smooth parameters
@@ -2,15 +2,41 @@
 #include "common/GLOffScreenRender.h"
 #include "common/GLFramebuffer.h"
 #include "common/GLTexture.h"
+#include "common/GLReadback.h"
 #include "roi/GraphicsRenderer.h"
 #include "MeshRenderer.h"
+#include <string.h>
 
 namespace hj
 {
+  // frames in flight with asynchronous readback
+  static const int kReadbackFrames = 2;
 
+  /**
+  * copies the color attachment 0 of from to to, of the same size
+  */
+  static void CopyColor(GLFramebuffer* from, GLFramebuffer* to)
+  {
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, from->GetID());
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, to->GetID());
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glBlitFramebuffer(0, 0, from->GetWidth(), from->GetHeight(),
+      0, 0, to->GetWidth(), to->GetHeight(), GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
 
   Manager::Manager()
     : out_fbo_ptr_(NULL)
+    , layer_fbo_ptr_(NULL)
+    , readback_ptr_(NULL)
+    , async_readback_(false)
+    , frame_valid_(false)
+    , scene_version_(0)
+    , overlay_version_(0)
+    , frames_rendered_(0)
+    , frames_overlay_(0)
+    , frames_skipped_(0)
   {
     offscreen_render_ptr_ = new GLOffScreenRender();
     renderer_ptr_ = new MeshRenderer();
@@ -20,9 +46,11 @@ namespace hj
 
   Manager::~Manager()
   {
+    DEL_PTR(readback_ptr_);
     delete renderer_ptr_;
     delete offscreen_render_ptr_;
     delete graphics_renderer_ptr_;
+    DEL_PTR(layer_fbo_ptr_);
     DEL_PTR(out_fbo_ptr_);
   }
 
@@ -38,21 +66,122 @@ namespace hj
       assert(0);
       return;
     }
-    if (!renderer_ptr_->Run()) {
+    if (!render()) {
       assert(0);
       return;
     }
-    if (!graphics_renderer_ptr_->Run()) {
+    if (readback_ptr_ && readback_ptr_->Read(output_buffer, buffer_len))
+      return;
+    if (view_pixels_.empty())
+      downloadView();
+    if ((size_t)buffer_len < view_pixels_.size()) {
       assert(0);
       return;
     }
-    GLTexture* texture_ptr = out_fbo_ptr_->GetTexture2D(GL_COLOR_ATTACHMENT0);
-    texture_ptr->DownloadTexture(output_buffer, buffer_len);
+    memcpy(output_buffer, &view_pixels_[0], view_pixels_.size());
     return;
   }
 
+  const uint8_t* Manager::MapView(int* buffer_len)
+  {
+    UnmapView();
+    if (!render()) {
+      assert(0);
+      return NULL;
+    }
+    if (readback_ptr_) {
+      const uint8_t* pixels = readback_ptr_->Map();
+      if (pixels) {
+        if (buffer_len)
+          *buffer_len = (int)readback_ptr_->GetSize();
+        return pixels;
+      }
+    }
+    if (view_pixels_.empty())
+      downloadView();
+    if (buffer_len)
+      *buffer_len = (int)view_pixels_.size();
+    return &view_pixels_[0];
+  }
+
+  void Manager::UnmapView()
+  {
+    if (readback_ptr_)
+      readback_ptr_->Unmap();
+  }
+
+  void Manager::SetAsyncReadback(bool async)
+  {
+    async_readback_ = async;
+    frame_valid_ = false;
+    DEL_PTR(readback_ptr_);
+    if (async && out_fbo_ptr_ && GLReadback::IsSupported()) {
+      readback_ptr_ = new GLReadback();
+      readback_ptr_->Create(out_fbo_ptr_, GL_COLOR_ATTACHMENT0, kReadbackFrames);
+    }
+  }
+
+  void Manager::GetFrameStatistics(int stats[3])
+  {
+    stats[0] = frames_rendered_;
+    stats[1] = frames_overlay_;
+    stats[2] = frames_skipped_;
+  }
+
+  bool Manager::render()
+  {
+    unsigned int scene = renderer_ptr_->GetVersion();
+    unsigned int overlay = graphics_renderer_ptr_->GetVersion();
+    bool mesh_layer = false;
+    if (frame_valid_ && scene == scene_version_) {
+      if (overlay == overlay_version_) {
+        // the last frame is still up to date
+        frames_skipped_++;
+        return true;
+      }
+      // only the graphics changed, they are drawn over the last mesh layer
+      mesh_layer = layer_fbo_ptr_ != NULL;
+    }
+
+    frame_valid_ = false;
+    if (mesh_layer) {
+      CopyColor(layer_fbo_ptr_, out_fbo_ptr_);
+      frames_overlay_++;
+    }
+    else {
+      if (!renderer_ptr_->Run())
+        return false;
+      if (layer_fbo_ptr_)
+        CopyColor(out_fbo_ptr_, layer_fbo_ptr_);
+      frames_rendered_++;
+    }
+    if (!graphics_renderer_ptr_->Run())
+      return false;
+
+    view_pixels_.clear();
+    if (readback_ptr_)
+      readback_ptr_->Queue();
+    else
+      downloadView();
+    scene_version_ = scene;
+    overlay_version_ = overlay;
+    frame_valid_ = true;
+    return true;
+  }
+
+  void Manager::downloadView()
+  {
+    GLTexture* texture_ptr = out_fbo_ptr_->GetTexture2D(GL_COLOR_ATTACHMENT0);
+    view_pixels_.resize(out_fbo_ptr_->GetWidth() * out_fbo_ptr_->GetHeight() * texture_ptr->GetBpp());
+    texture_ptr->DownloadTexture(&view_pixels_[0], view_pixels_.size());
+  }
+
   bool Manager::Resize(int new_width, int new_height)
   {
+    // frames of the old size are dropped
+    frame_valid_ = false;
+    DEL_PTR(readback_ptr_);
+    DEL_PTR(layer_fbo_ptr_);
     DEL_PTR(out_fbo_ptr_);
     out_fbo_ptr_ = new GLFramebuffer(new_width, new_height);
     out_fbo_ptr_->CreateColorTexture(GL_COLOR_ATTACHMENT0,
@@ -71,6 +200,22 @@ namespace hj
     }
     renderer_ptr_->SetFBO(out_fbo_ptr_);
     graphics_renderer_ptr_->SetFBO(out_fbo_ptr_);
+    SetAsyncReadback(async_readback_);
+
+    // the mesh without the graphics, for redrawing only the graphics
+    if (GLEW_VERSION_3_0 || GLEW_ARB_framebuffer_object) {
+      layer_fbo_ptr_ = new GLFramebuffer(new_width, new_height);
+      layer_fbo_ptr_->CreateColorTexture(GL_COLOR_ATTACHMENT0,
+        GL_RGB8,
+        GL_RGB,
+        GL_UNSIGNED_BYTE);
+      if (layer_fbo_ptr_->IsOk()) {
+        layer_fbo_ptr_->Unbind();
+      }
+      else {
+        DEL_PTR(layer_fbo_ptr_);
+      }
+    }
 
     return true;
   }
@@ -148,6 +293,21 @@ namespace hj
     renderer_ptr_->SetTexture(t);
   }
 
+  void Manager::SetMeshAttributes(unsigned int attributes)
+  {
+    renderer_ptr_->SetMeshAttributes(attributes);
+  }
+
+  void Manager::SetSelectionMode(int mode)
+  {
+    renderer_ptr_->SetSelectionMode(SelectionSet::Operation(mode));
+  }
+
+  void Manager::SetLassoVisibleOnly(bool v)
+  {
+    renderer_ptr_->SetLassoVisibleOnly(v);
+  }
+
   void Manager::SetAnchorPoints(float *polyx, float *polyy, int count)
   {
     std::vector<glm::vec2> polygon;
@@ -2,12 +2,14 @@
 #define HJ_Manager_h__
 
 #include <string>
+#include <vector>
 #include "common/config.h"
 
 namespace hj
 {
   class GLOffScreenRender;
   class GLFramebuffer;
+  class GLReadback;
   class MeshRenderer;
   class GraphicsRenderer;
 
@@ -38,6 +40,34 @@ namespace hj
     */
     HJ_EXPORT const void GetView(uint8_t* output_buffer, int buffer_len);
 
+    /**
+    * Renders the view and maps the pixels of the newest finished frame, valid until
+    * UnmapView() or the next call of GetView() or MapView(). Without asynchronous
+    * readback the frame is downloaded into a buffer of the manager.
+    * @param buffer_len: receives the size of the pixel data.
+    * @return: the pixel data, NULL if nothing could be read.
+    */
+    HJ_EXPORT const uint8_t* MapView(int* buffer_len);
+
+    /**
+    * Releases the pixels returned by MapView().
+    */
+    HJ_EXPORT void UnmapView();
+
+    /**
+    * Set whether frames are read back asynchronously through pixel buffer objects.
+    * GetView() and MapView() then return the newest frame the GPU has finished, one
+    * or two calls behind, instead of waiting for the frame just rendered.
+    */
+    HJ_EXPORT void SetAsyncReadback(bool async);
+
+    /**
+    * Get frame counts since the view was created: frames rendered in full, frames
+    * where only the graphics were drawn over the cached mesh, and frames skipped
+    * because nothing changed since the last one.
+    */
+    HJ_EXPORT void GetFrameStatistics(int stats[3]);
+
     /**
     * Resizes output image.
     * @param new_width: Width of Rendering View.
@@ -127,6 +157,22 @@ namespace hj
     */
     HJ_EXPORT void SetTexture(bool t);
 
+    /**
+    * Set the attributes kept by meshes loaded afterwards, TriMesh::Attribute flags.
+    */
+    HJ_EXPORT void SetMeshAttributes(unsigned int attributes);
+
+    /**
+    * Set how the next lassos are combined with the selected region,
+    * SelectionSet::Operation: 0 replace, 1 add (shift), 2 subtract (ctrl), 3 intersect.
+    */
+    HJ_EXPORT void SetSelectionMode(int mode);
+
+    /**
+    * Set whether lassos select only the visible vertices under them.
+    */
+    HJ_EXPORT void SetLassoVisibleOnly(bool v);
+
     /**
     * Set anchor points.
     * @param polygon: polygon points array.
@@ -245,10 +291,44 @@ namespace hj
     HJ_EXPORT void SetHeight(float h);
 
   private:
+    /**
+    * Renders the mesh and the graphics into out_fbo_ptr_ and starts reading the
+    * frame back, unless the versions of both are those of the last frame. If only
+    * the graphics changed, they are drawn over the mesh kept in layer_fbo_ptr_.
+    */
+    bool render();
+
+    /** downloads the frame in out_fbo_ptr_ to view_pixels_. */
+    void downloadView();
+
     GLOffScreenRender* offscreen_render_ptr_;
 
     GLFramebuffer* out_fbo_ptr_;
 
+    /** the mesh of the last frame rendered, NULL without framebuffer blits. */
+    GLFramebuffer* layer_fbo_ptr_;
+
+    /** asynchronous readback of out_fbo_ptr_, NULL if disabled or unsupported. */
+    GLReadback* readback_ptr_;
+
+    /** whether asynchronous readback is requested. */
+    bool async_readback_;
+
+    /** last frame downloaded without asynchronous readback. */
+    std::vector<uint8_t> view_pixels_;
+
+    /** out_fbo_ptr_ holds the frame of scene_version_ and overlay_version_. */
+    bool frame_valid_;
+
+    /** MeshRenderer and GraphicsRenderer versions of the last frame. */
+    unsigned int scene_version_;
+    unsigned int overlay_version_;
+
+    /** see GetFrameStatistics(). */
+    int frames_rendered_;
+    int frames_overlay_;
+    int frames_skipped_;
+
     MeshRenderer* renderer_ptr_;
 
     GraphicsRenderer* graphics_renderer_ptr_;
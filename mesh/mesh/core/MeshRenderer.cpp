@@ -1,5 +1,9 @@
 #include "MeshRenderer.h"
 #include "common/GLFramebuffer.h"
+#include "common/GLShader.h"
+#include "common/GLMeshBuffer.h"
+#include "common/MeshBVH.h"
+#include "common/LassoMask.h"
 #include "common/GLTexture.h"
 #include "common/Trackball.h"
 #include "common/Trackball2.h"
@@ -11,12 +15,191 @@
 #include "LaplacianSurface.h"
 #include "roi/GraphicsRenderer.h"
 #include "roi/GraphicsLine.h"
+#include <float.h>
 
 namespace hj
 {
 
   const int kiMeshStencilRef= 1;
 
+  /**
+  * first hit of a ray with a cylinder as drawn by drawSolidCylinder(): the tube
+  * between radii r0 and r1 around the z axis, with z in [-h, h]
+  */
+  static bool RayTube(const glm::vec3 &o, const glm::vec3 &d, float r0, float r1, float h, float *t)
+  {
+    float best = FLT_MAX;
+    float a = d.x * d.x + d.y * d.y;
+    float radii[2] = { r0, r1 };
+    for (int k = 0; k < 2 && a > 0; k++)
+    {
+      float b = o.x * d.x + o.y * d.y;
+      float c = o.x * o.x + o.y * o.y - radii[k] * radii[k];
+      float disc = b * b - a * c;
+      if (disc < 0)
+        continue;
+      float s = std::sqrt(disc);
+      float roots[2] = { (-b - s) / a, (-b + s) / a };
+      for (int j = 0; j < 2; j++)
+      {
+        if (roots[j] > 0 && roots[j] < best && std::fabs(o.z + roots[j] * d.z) <= h)
+          best = roots[j];
+      }
+    }
+    for (int k = 0; k < 2 && d.z != 0; k++)
+    {
+      float tz = ((k ? h : -h) - o.z) / d.z;
+      float x = o.x + tz * d.x, y = o.y + tz * d.y;
+      float rr = x * x + y * y;
+      if (tz > 0 && tz < best && rr >= r0 * r0 && rr <= r1 * r1)
+        best = tz;
+    }
+    *t = best;
+    return best < FLT_MAX;
+  }
+
+  // vertex attribute slots of the quantized normals and texture coordinates, clear
+  // of the ones drivers alias with the fixed function arrays
+  static const int kOctNormalAttrib = 6;
+  static const int kUnormTexCoordAttrib = 7;
+  // and of the selection flags, in the slot of the unused fog coordinate
+  static const int kSelectionAttrib = 5;
+
+  // fixed function lighting of GL_LIGHT0 with GL_COLOR_MATERIAL, with the normals and
+  // texture coordinates decoded from their quantized forms
+  static const char* kLeanVertexShader =
+    "#version 120\n"
+    "attribute vec2 oct_normal;\n"
+    "attribute vec2 unorm_texcoord;\n"
+    "uniform bool use_oct_normal;\n"
+    "uniform bool use_unorm_texcoord;\n"
+    "uniform vec4 texcoord_range;\n"
+    "vec3 decodeOctahedral(vec2 e)\n"
+    "{\n"
+    "  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+    "  if (n.z < 0.0)\n"
+    "    n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+    "  return normalize(n);\n"
+    "}\n"
+    "void main()\n"
+    "{\n"
+    "  vec3 n = normalize(gl_NormalMatrix * (use_oct_normal ? decodeOctahedral(oct_normal) : gl_Normal));\n"
+    "  vec4 eye = gl_ModelViewMatrix * gl_Vertex;\n"
+    "  vec4 light = gl_LightSource[0].position;\n"
+    "  vec3 l = normalize(light.w == 0.0 ? light.xyz : light.xyz - eye.xyz);\n"
+    "  vec4 c = gl_LightModel.ambient + gl_LightSource[0].ambient + gl_LightSource[0].diffuse * max(dot(n, l), 0.0);\n"
+    "  gl_FrontColor = vec4(gl_Color.rgb * c.rgb, gl_Color.a);\n"
+    "  gl_TexCoord[0] = use_unorm_texcoord ? vec4(texcoord_range.xy + unorm_texcoord * texcoord_range.zw, 0.0, 1.0) : gl_MultiTexCoord0;\n"
+    "  gl_Position = ftransform();\n"
+    "}\n";
+
+  static const char* kLeanFragmentShader =
+    "#version 120\n"
+    "uniform sampler2D tex_image;\n"
+    "uniform bool textured;\n"
+    "void main()\n"
+    "{\n"
+    "  gl_FragColor = textured ? gl_Color * texture2D(tex_image, gl_TexCoord[0].st) : gl_Color;\n"
+    "}\n";
+
+  // solid shading, wireframe and ROI highlighting in one pass: the vertex shader
+  // lights like the lean one, the geometry shader gives every fragment its window
+  // distances to the edges of its triangle, and the fragment shader blends the
+  // wire color in near the edges. The distances are multiplied by w here and by
+  // 1/w in the fragment shader, which undoes the perspective interpolation. With
+  // GL_FLAT the whole face gets the lighting of its last vertex, the provoking
+  // vertex of the fixed function.
+  static const char* kSurfaceVertexShader =
+    "#version 120\n"
+    "attribute vec2 oct_normal;\n"
+    "attribute vec2 unorm_texcoord;\n"
+    "attribute float selection;\n"
+    "uniform bool use_oct_normal;\n"
+    "uniform bool use_unorm_texcoord;\n"
+    "uniform vec4 texcoord_range;\n"
+    "varying vec3 vertex_light;\n"
+    "varying float vertex_selection;\n"
+    "vec3 decodeOctahedral(vec2 e)\n"
+    "{\n"
+    "  vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));\n"
+    "  if (n.z < 0.0)\n"
+    "    n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);\n"
+    "  return normalize(n);\n"
+    "}\n"
+    "void main()\n"
+    "{\n"
+    "  vec3 n = normalize(gl_NormalMatrix * (use_oct_normal ? decodeOctahedral(oct_normal) : gl_Normal));\n"
+    "  vec4 eye = gl_ModelViewMatrix * gl_Vertex;\n"
+    "  vec4 light = gl_LightSource[0].position;\n"
+    "  vec3 l = normalize(light.w == 0.0 ? light.xyz : light.xyz - eye.xyz);\n"
+    "  vertex_light = (gl_LightModel.ambient + gl_LightSource[0].ambient + gl_LightSource[0].diffuse * max(dot(n, l), 0.0)).rgb;\n"
+    "  vertex_selection = selection;\n"
+    "  gl_TexCoord[0] = use_unorm_texcoord ? vec4(texcoord_range.xy + unorm_texcoord * texcoord_range.zw, 0.0, 1.0) : gl_MultiTexCoord0;\n"
+    "  gl_Position = ftransform();\n"
+    "}\n";
+
+  static const char* kSurfaceGeometryShader =
+    "#version 120\n"
+    "#extension GL_EXT_geometry_shader4 : enable\n"
+    "uniform vec2 half_viewport;\n"
+    "uniform bool flat_shading;\n"
+    "varying in vec3 vertex_light[];\n"
+    "varying in float vertex_selection[];\n"
+    "varying out vec3 light;\n"
+    "varying out vec3 edge_distance;\n"
+    "varying out float selected;\n"
+    "void main()\n"
+    "{\n"
+    "  vec3 h = vec3(1.0e6);\n"
+    "  if (gl_PositionIn[0].w > 0.0 && gl_PositionIn[1].w > 0.0 && gl_PositionIn[2].w > 0.0)\n"
+    "  {\n"
+    "    vec2 p0 = half_viewport * gl_PositionIn[0].xy / gl_PositionIn[0].w;\n"
+    "    vec2 p1 = half_viewport * gl_PositionIn[1].xy / gl_PositionIn[1].w;\n"
+    "    vec2 p2 = half_viewport * gl_PositionIn[2].xy / gl_PositionIn[2].w;\n"
+    "    vec2 e0 = p2 - p1, e1 = p0 - p2, e2 = p1 - p0;\n"
+    "    float area = abs(e1.x * e2.y - e1.y * e2.x);\n"
+    "    h = area / max(vec3(length(e0), length(e1), length(e2)), vec3(1.0e-6));\n"
+    "  }\n"
+    "  float s = min(vertex_selection[0], min(vertex_selection[1], vertex_selection[2]));\n"
+    "  for (int i = 0; i < 3; i++)\n"
+    "  {\n"
+    "    vec3 d = vec3(0.0);\n"
+    "    d[i] = h[i];\n"
+    "    gl_Position = gl_PositionIn[i];\n"
+    "    gl_TexCoord[0] = gl_TexCoordIn[i][0];\n"
+    "    light = flat_shading ? vertex_light[2] : vertex_light[i];\n"
+    "    edge_distance = d * gl_PositionIn[i].w;\n"
+    "    selected = s;\n"
+    "    EmitVertex();\n"
+    "  }\n"
+    "  EndPrimitive();\n"
+    "}\n";
+
+  static const char* kSurfaceFragmentShader =
+    "#version 120\n"
+    "uniform sampler2D tex_image;\n"
+    "uniform bool textured;\n"
+    "uniform bool solid;\n"
+    "uniform bool wireframe;\n"
+    "uniform vec3 solid_color;\n"
+    "uniform vec3 wire_color;\n"
+    "uniform vec3 roi_color;\n"
+    "varying vec3 light;\n"
+    "varying vec3 edge_distance;\n"
+    "varying float selected;\n"
+    "void main()\n"
+    "{\n"
+    "  vec3 d = edge_distance * gl_FragCoord.w;\n"
+    "  float wire = wireframe ? 1.0 - smoothstep(0.5, 1.5, min(d.x, min(d.y, d.z))) : 0.0;\n"
+    "  if (!solid && wire <= 0.0)\n"
+    "    discard;\n"
+    "  bool roi = selected > 0.5;\n"
+    "  vec3 face = roi ? roi_color : solid_color;\n"
+    "  vec3 line = roi ? roi_color : wire_color;\n"
+    "  vec4 c = vec4(mix(face, line, solid ? wire : 1.0) * light, 1.0);\n"
+    "  gl_FragColor = textured ? c * texture2D(tex_image, gl_TexCoord[0].st) : c;\n"
+    "}\n";
+
   MeshRenderer::MeshRenderer()
     : out_fbo_ptr_(NULL)
     , mesh_(NULL)
@@ -24,7 +207,8 @@ namespace hj
     , pcaAnchor_(NULL)
     , pcaControl_(NULL)
     , ls_(NULL)
-    , depth_buffer_(NULL)
+    , bvh_(NULL)
+    , bvh_dirty_(false)
     , center_(Point(0, 0, 0))
     , radius_(1)
     , fovy_(45)
@@ -34,6 +218,17 @@ namespace hj
     , isPreComputed_(false)
     , meshfile_("")
     , gren_(NULL)
+    , mesh_attributes_(TriMesh::kDefaultAttributes)
+    , lean_program_(NULL)
+    , surface_program_(NULL)
+    , mesh_buffer_(NULL)
+    , selection_mode_(SelectionSet::kReplace)
+    , lasso_visible_only_(false)
+    , camera_version_(0)
+    , mesh_version_(0)
+    , selection_version_(0)
+    , cylinder_version_(0)
+    , display_version_(0)
   {
     glDisable(GL_DITHER);
     glDepthFunc(GL_LESS);
@@ -61,15 +256,16 @@ namespace hj
     DEL_PTR(pcaAnchor_);
     DEL_PTR(pcaControl_);
     DEL_PTR(ls_);
-    DEL_ARRAY(depth_buffer_);
+    DEL_PTR(bvh_);
+    DEL_PTR(lean_program_);
+    DEL_PTR(surface_program_);
+    DEL_PTR(mesh_buffer_);
   }
 
   bool MeshRenderer::SetFBO(GLFramebuffer* fbo)
   {
     out_fbo_ptr_ = fbo;
-
-    DEL_ARRAY(depth_buffer_);
-    depth_buffer_ = new float[out_fbo_ptr_->GetWidth() * out_fbo_ptr_->GetHeight()];
+    ++camera_version_;
     return true;
   }
 
@@ -118,45 +314,57 @@ namespace hj
     if (mesh_)
     {
       glEnable(GL_DEPTH_TEST);
-      glEnableClientState(GL_VERTEX_ARRAY);
-      glVertexPointer(3, GL_FLOAT, 0, mesh_->points());
-      glEnableClientState(GL_NORMAL_ARRAY);
-      glNormalPointer(GL_FLOAT, 0, mesh_->vertex_normals());
 
       // texture
-      if (texture_ && texture_image_ && mesh_->has_vertex_texcoords2D())
+      bool textured = texture_ && texture_image_ && mesh_->hasTexCoords();
+      GLMeshBuffer* buffer = needMeshBuffer();
+      buffer->SetSelection(roi_first_, roi_count_);
+      buffer->Bind(textured);
+      if (textured)
       {
-        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-        glTexCoordPointer(2, GL_FLOAT, 0, mesh_->texcoords2D());
         glEnable(GL_TEXTURE_2D);
         glBindTexture(GL_TEXTURE_2D, texture_image_->GetTexture()->GetId());
         glTexEnvf(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
       }
 
-      // draw solid mesh, with polygon offset
       glStencilFunc(GL_ALWAYS, kiMeshStencilRef, (GLuint)-1);
-      if (solid_)
+      if ((solid_ || wireframe_) && bindSurfaceProgram(textured))
       {
+        // solid, wireframe and ROI in one pass
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        glEnable(GL_POLYGON_OFFSET_FILL);
-        glPolygonOffset(2.5f, 2.5f);
-        drawROI(0.8, 0, 0);
-        drawMainObject(0.8f, 1.0f, 1.0f);
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        buffer->Draw();
+        surface_program_->Unbind();
       }
-      if (wireframe_)
+      else
       {
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        drawROI(0.8, 0, 0);
-        drawMainObject(0.5f, 0.5f, 0.5f);
+        // quantized attributes are decoded by a shader
+        bool lean = (mesh_->octNormals() || mesh_->unormTexCoords()) && bindLeanProgram(textured);
+
+        // draw solid mesh, with polygon offset
+        if (solid_)
+        {
+          glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+          glEnable(GL_POLYGON_OFFSET_FILL);
+          glPolygonOffset(2.5f, 2.5f);
+          drawROI(0.8, 0, 0);
+          drawMainObject(0.8f, 1.0f, 1.0f);
+        }
+        if (wireframe_)
+        {
+          glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+          drawROI(0.8, 0, 0);
+          drawMainObject(0.5f, 0.5f, 0.5f);
+        }
+        if (lean)
+          lean_program_->Unbind();
       }
+      buffer->Unbind();
 
       // draw control and anchor points.
       glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
       drawAnchorAndControl();
 
-      glDisableClientState(GL_VERTEX_ARRAY);
-      glDisableClientState(GL_NORMAL_ARRAY);
-      glDisableClientState(GL_TEXTURE_COORD_ARRAY);
       glDisable(GL_TEXTURE_2D);
       glDisable(GL_DEPTH_TEST);
     }
@@ -166,8 +374,13 @@ namespace hj
 
   bool MeshRenderer::LoadMesh(const std::string& filename)
   {
+    DEL_PTR(bvh_);
+    DEL_PTR(mesh_buffer_);
     DEL_PTR(mesh_);
+    screen_.invalidate();
     mesh_ = new TriMesh();
+    mesh_->setAttributes(mesh_attributes_);
+    mesh_->setReorder(true);
     if (!mesh_->read(filename.c_str())) {
       assert(0);
       return false;
@@ -177,21 +390,22 @@ namespace hj
     center_ = mesh_->getSceneCenter();
     radius_ = (float)mesh_->getSceneRadius();
 
-    TriMesh::ConstFaceIter fit(mesh_->faces_begin()), fEnd(mesh_->faces_end());
-    triverts_.clear();
-    for (; fit != fEnd; ++fit)
-    {
-      TriMesh::ConstFaceVertexIter fvit = mesh_->cfv_iter(fit.handle());
-      triverts_.push_back(fvit.handle().idx()); ++fvit;
-      triverts_.push_back(fvit.handle().idx()); ++fvit;
-      triverts_.push_back(fvit.handle().idx());
-    }
-
     ResetCamera();
 
     pcaAnchor_->SetMesh(mesh_);
     pcaControl_->SetMesh(mesh_);
 
+    // selections of the last mesh do not apply to this one
+    anchorFRoi_.clear();
+    controlFRoi_.clear();
+    anchorPts_.clear();
+    controlPts_.clear();
+    controlList_.clear();
+    roi_first_.clear();
+    roi_count_.clear();
+    ++mesh_version_;
+    ++selection_version_;
+
     meshfile_ = filename;
     return true;
   }
@@ -206,6 +420,7 @@ namespace hj
       return false;
     }
     texture_image_->CreateTexture();
+    ++display_version_;
     if (glm::any(glm::lessThanEqual(texture_image_->GetSize(), glm::ivec2(0)))) {
       assert(0);
       return false;
@@ -237,6 +452,7 @@ namespace hj
       zFar);
 
     trackball_.SetCamera(&camera_);
+    ++camera_version_;
     return true;
   }
 
@@ -265,12 +481,14 @@ namespace hj
 
       cyl->rotate = rotate_matrix * cyl->rotate;
       cyl->model_matrix = glm::translate(cyl->center_world) * cyl->rotate;
+      ++cylinder_version_;
       return;
     }
 
     trackball_.Rotate(glm::vec2(newMouseX, newMouseY),
       glm::vec2(lastMouseX, lastMouseY),
       w, h);
+    ++camera_version_;
   }
 
   void MeshRenderer::Zoom(float newMouseX,
@@ -283,6 +501,7 @@ namespace hj
     trackball_.Zoom(glm::vec2(newMouseX, newMouseY),
       glm::vec2(lastMouseX, lastMouseY),
       w, h);
+    ++camera_version_;
   }
 
   void MeshRenderer::Move(float newMouseX,
@@ -304,30 +523,30 @@ namespace hj
       Vec motion = p1_world - p2_world;
       cyl->center_world += glm::vec3(motion[0], motion[1], motion[2]);
       cyl->model_matrix = glm::translate(cyl->center_world) * cyl->rotate;
-
+      ++cylinder_version_;
       return;
     }
 
     trackball_.Move(glm::vec2(newMouseX, newMouseY),
       glm::vec2(lastMouseX, lastMouseY),
       w, h);
+    ++camera_version_;
   }
 
   void MeshRenderer::drawMainObject(float r, float g, float b)
   {
     glColor3f(r, g, b);
-    if (triverts_.size()>0)
-      glDrawElements(GL_TRIANGLES, (GLsizei)triverts_.size(), GL_UNSIGNED_INT, &(triverts_[0]));
+    mesh_buffer_->Draw();
   }
 
   void MeshRenderer::drawAnchorAndControl()
   {
-    if (anchorPts_.size()>0)
+    if (!anchorPts_.empty())
     {
       glColor3d(1, 0, 0);
       pcaAnchor_->drawPCAOBB();
     }
-    if (controlPts_.size()>0)
+    if (!controlList_.empty())
     {
       glColor3d(0, 1, 0);
       pcaControl_->drawControlSphere();
@@ -337,169 +556,269 @@ namespace hj
   void MeshRenderer::drawROI(double r, double g, double b)
   {
     glColor3d(r, g, b);
-    if (roiverts_.size() > 0)
-      glDrawElements(GL_TRIANGLES, (GLsizei)roiverts_.size(), GL_UNSIGNED_INT, &(roiverts_[0]));
+    mesh_buffer_->DrawRanges(roi_first_, roi_count_);
+  }
+
+  bool MeshRenderer::bindLeanProgram(bool textured)
+  {
+    if (!lean_program_)
+    {
+      if (!GLEW_VERSION_2_0)
+        return false;
+      lean_program_ = new GLProgram();
+      lean_program_->BindAttribLocation("oct_normal", kOctNormalAttrib);
+      lean_program_->BindAttribLocation("unorm_texcoord", kUnormTexCoordAttrib);
+      if (lean_program_->AddVertexShader(kLeanVertexShader) &&
+        lean_program_->AddFragmentShader(kLeanFragmentShader))
+        lean_program_->Link();
+    }
+    if (!lean_program_->IsOk())
+      return false;
+
+    const short* normals = mesh_->octNormals();
+    const unsigned short* texcoords = mesh_->unormTexCoords();
+    lean_program_->Bind();
+    lean_program_->SetUniform1i("use_oct_normal", normals ? 1 : 0);
+    lean_program_->SetUniform1i("use_unorm_texcoord", texcoords ? 1 : 0);
+    lean_program_->SetUniform4f("texcoord_range", mesh_->texCoordMin()[0], mesh_->texCoordMin()[1],
+      mesh_->texCoordSize()[0], mesh_->texCoordSize()[1]);
+    lean_program_->SetUniform1i("textured", textured ? 1 : 0);
+    lean_program_->SetUniform1i("tex_image", 0);
+    return true;
+  }
+
+  bool MeshRenderer::bindSurfaceProgram(bool textured)
+  {
+    if (!surface_program_)
+    {
+      if (!GLEW_VERSION_2_0 || !GLEW_EXT_geometry_shader4)
+        return false;
+      surface_program_ = new GLProgram();
+      surface_program_->BindAttribLocation("oct_normal", kOctNormalAttrib);
+      surface_program_->BindAttribLocation("unorm_texcoord", kUnormTexCoordAttrib);
+      surface_program_->BindAttribLocation("selection", kSelectionAttrib);
+      surface_program_->SetParameteri(GL_GEOMETRY_INPUT_TYPE_EXT, GL_TRIANGLES);
+      surface_program_->SetParameteri(GL_GEOMETRY_OUTPUT_TYPE_EXT, GL_TRIANGLE_STRIP);
+      surface_program_->SetParameteri(GL_GEOMETRY_VERTICES_OUT_EXT, 3);
+      if (surface_program_->AddVertexShader(kSurfaceVertexShader) &&
+        surface_program_->AddGeometryShader(kSurfaceGeometryShader) &&
+        surface_program_->AddFragmentShader(kSurfaceFragmentShader))
+        surface_program_->Link();
+    }
+    if (!surface_program_->IsOk())
+      return false;
+
+    surface_program_->Bind();
+    surface_program_->SetUniform1i("use_oct_normal", mesh_->octNormals() ? 1 : 0);
+    surface_program_->SetUniform1i("use_unorm_texcoord", mesh_->unormTexCoords() ? 1 : 0);
+    surface_program_->SetUniform4f("texcoord_range", mesh_->texCoordMin()[0], mesh_->texCoordMin()[1],
+      mesh_->texCoordSize()[0], mesh_->texCoordSize()[1]);
+    surface_program_->SetUniform1i("textured", textured ? 1 : 0);
+    surface_program_->SetUniform1i("tex_image", 0);
+    surface_program_->SetUniform1i("solid", solid_ ? 1 : 0);
+    surface_program_->SetUniform1i("wireframe", wireframe_ ? 1 : 0);
+    GLint shade_model = GL_SMOOTH;
+    glGetIntegerv(GL_SHADE_MODEL, &shade_model);
+    surface_program_->SetUniform1i("flat_shading", shade_model == GL_FLAT ? 1 : 0);
+    surface_program_->SetUniform2f("half_viewport", 0.5f * out_fbo_ptr_->GetWidth(),
+      0.5f * out_fbo_ptr_->GetHeight());
+    surface_program_->SetUniform3f("solid_color", 0.8f, 1.0f, 1.0f);
+    surface_program_->SetUniform3f("wire_color", 0.5f, 0.5f, 0.5f);
+    surface_program_->SetUniform3f("roi_color", 0.8f, 0.0f, 0.0f);
+    return true;
   }
 
   void MeshRenderer::SetSmooth()
   {
     glShadeModel(GL_SMOOTH);
+    ++display_version_;
   }
 
   void MeshRenderer::SetFlat()
   {
     glShadeModel(GL_FLAT);
+    ++display_version_;
   }
 
   void MeshRenderer::SetWireframe(bool w)
   {
     wireframe_ = w;
+    ++display_version_;
   }
 
   void MeshRenderer::SetSolid(bool s)
   {
     solid_ = s;
+    ++display_version_;
   }
 
   void MeshRenderer::SetTexture(bool t)
   {
     texture_ = t;
+    ++display_version_;
   }
 
-  void MeshRenderer::getLasso2dRegion(const std::vector<glm::vec2> &polygon)
+  void MeshRenderer::SetMeshAttributes(unsigned int attributes)
   {
-    if (polygon.size() <= 2) return;
+    mesh_attributes_ = attributes;
+  }
 
-    double maxx = -DBL_MAX;
-    double maxy = -DBL_MAX;
-    double minx = DBL_MAX;
-    double miny = DBL_MAX;
-    for (size_t i = 0; i < polygon.size(); i++)
-    {
-      if (maxx< polygon[i].x) maxx = polygon[i].x;
-      if (maxy< polygon[i].y) maxy = polygon[i].y;
-      if (minx> polygon[i].x) minx = polygon[i].x;
-      if (miny> polygon[i].y) miny = polygon[i].y;
-    }
+  void MeshRenderer::SetSelectionMode(SelectionSet::Operation mode)
+  {
+    selection_mode_ = mode;
+  }
 
-    //glm::mat4 volume2ClipCoord = projection_ * modelview_;
-    glm::mat4 volume2ClipCoord = camera_.GetViewProjectionMatrix() * model_;
-    int view_width = out_fbo_ptr_->GetWidth();
-    int view_height = out_fbo_ptr_->GetHeight();
+  void MeshRenderer::SetLassoVisibleOnly(bool v)
+  {
+    lasso_visible_only_ = v;
+  }
 
-    std::vector<TriMesh::VHandle> vset;
-    TriMesh::VertexIter v_it;
-    for (v_it = mesh_->vertices_begin(); v_it != mesh_->vertices_end(); ++v_it)
-    {
-      TriMesh::Point p = mesh_->point(v_it.handle());
-
-      // convert to view coordinate.
-      glm::vec4 point(p[0], p[1], p[2], 1);
-      point = volume2ClipCoord * point;
-      // NDC
-      point /= point.w;
-      // Window Coordinate
-      point.x = point.x * view_width * 0.5f + view_width * 0.5f;
-      point.y = point.y * view_height * 0.5f + view_height * 0.5f;
-
-      if (point[0] < minx || point[0] > maxx || point[1] < miny || point[1] > maxy)
-        continue;
-      if (ScanLine::PointInPolygon(polygon, glm::dvec2(point)))
-        vset.push_back(v_it.handle());
-    }
-    vertex2Face(vset, curFRoi_);
-    vset.clear();
+  void MeshRenderer::getLasso2dRegion(const std::vector<glm::vec2> &polygon, SelectionSet &roi)
+  {
+    if (polygon.size() <= 2) return;
+
+    LassoMask lasso;
+    lasso.build(polygon);
+
+    SelectionSet vset;
+    lasso.select(needScreen(), vset);
+    if (lasso_visible_only_)
+      removeHidden(vset);
+    SelectionSet::VerticesToFaces(*mesh_, vset, curFRoi_);
 
     // boolean operations
-    allFRoi_ = curFRoi_;
+    roi.resize((int)mesh_->n_faces());
+    roi.combine(curFRoi_, selection_mode_);
 
-    roiverts_.clear();
-    for (unsigned int i = 0; i<allFRoi_.size(); i++)
-    {
-      TriMesh::ConstFaceVertexIter fvit = mesh_->cfv_iter(allFRoi_[i]);
-      roiverts_.push_back(fvit.handle().idx());	++fvit;
-      roiverts_.push_back(fvit.handle().idx());	++fvit;
-      roiverts_.push_back(fvit.handle().idx());
-    }
+    setROIRanges(roi);
   }
 
-  void MeshRenderer::vertex2Face(std::vector<TriMesh::VHandle> &vset,
-    std::vector<TriMesh::FHandle> &bfs)
+  void MeshRenderer::removeHidden(SelectionSet &vertices)
   {
-    bfs.clear();
-    TriMesh::VertexFaceIter vf_it;
-    for (unsigned int i = 0; i<vset.size(); i++)
+    glm::vec4 eye = glm::inverse(camera_.GetViewMatrix() * model_) * glm::vec4(0, 0, 0, 1);
+    Point eye_point(eye.x / eye.w, eye.y / eye.w, eye.z / eye.w);
+
+    // front-facing ones
+    std::vector<int> candidates;
+    vertices.indices(candidates);
+    if (mesh_->hasNormals())
     {
-      for (vf_it = mesh_->vf_iter(vset[i]); vf_it; ++vf_it)
+      size_t k = 0;
+      for (size_t i = 0; i < candidates.size(); i++)
       {
-        if (vf_it.handle().is_valid())
-          bfs.push_back(vf_it.handle());
+        TriMesh::VHandle vh(candidates[i]);
+        if ((mesh_->vertexNormal(vh) | (eye_point - mesh_->point(vh))) > 0)
+          candidates[k++] = candidates[i];
+        else
+          vertices.erase(candidates[i]);
       }
+      candidates.resize(k);
+    }
+
+    // visible ones: nothing is hit before the vertex on the ray from the eye
+    int count = (int)candidates.size();
+    if (!count) return;
+    std::vector<float> origins(3 * count), dirs(3 * count);
+    for (int i = 0; i < count; i++)
+    {
+      const Point& p = mesh_->point(TriMesh::VHandle(candidates[i]));
+      for (int k = 0; k < 3; k++)
+      {
+        origins[3 * i + k] = eye_point[k];
+        dirs[3 * i + k] = p[k] - eye_point[k];
+      }
+    }
+    std::vector<MeshBVH::Hit> hits(count);
+    needBVH()->intersect(&origins[0], &dirs[0], count, &hits[0]);
+    for (int i = 0; i < count; i++)
+    {
+      if (hits[i].face >= 0 && hits[i].t < 1 - 1e-3f)
+        vertices.erase(candidates[i]);
     }
-    std::vector<TriMesh::FHandle>::iterator it;
-    std::sort(bfs.begin(), bfs.end());
-    it = std::unique(bfs.begin(), bfs.end());
-    bfs.resize(it - bfs.begin());
   }
 
-  void MeshRenderer::face2Vertex(std::vector<TriMesh::VHandle> &vset,
-    std::vector<TriMesh::FHandle> &fset)
+  void MeshRenderer::setROIRanges(const SelectionSet &faces)
   {
-    TriMesh::FaceVertexIter fv_it;
-    for (unsigned int i = 0; i<fset.size(); i++)
+    ++selection_version_;
+    roi_first_.clear();
+    roi_count_.clear();
+    for (int f = faces.next(0); f >= 0; f = faces.next(f + 1))
     {
-      for (fv_it = mesh_->fv_iter(fset[i]); fv_it; ++fv_it)
+      if (!roi_first_.empty() && roi_first_.back() + roi_count_.back() == f)
       {
-        if (fv_it.handle().is_valid())
-          vset.push_back(fv_it.handle());
+        roi_count_.back()++;
+      }
+      else
+      {
+        roi_first_.push_back(f);
+        roi_count_.push_back(1);
       }
     }
-    std::vector<TriMesh::VHandle>::iterator it;
-    std::sort(vset.begin(), vset.end());
-    it = std::unique(vset.begin(), vset.end());
-    vset.resize(it - vset.begin());
   }
 
   void MeshRenderer::SetAnchorPoints(const std::vector<glm::vec2> &polygon)
   {
     if (!mesh_) return;
-    getLasso2dRegion(polygon); // get ROI
+    getLasso2dRegion(polygon, anchorFRoi_); // get ROI
 
-    allVRoi_.clear();
-    face2Vertex(allVRoi_, allFRoi_);
+    SelectionSet::FacesToVertices(*mesh_, anchorFRoi_, allVRoi_);
 
     anchorPts_ = allVRoi_;
-    pcaAnchor_->getPCAOBB(anchorPts_);
-
-    roiverts_.clear();
+    std::vector<TriMesh::VHandle> anchors;
+    anchorPts_.handles(anchors);
+    if (!anchors.empty())
+      pcaAnchor_->getPCAOBB(anchors);
+
+    roi_first_.clear();
+    roi_count_.clear();
+    ++selection_version_;
     isPreComputed_ = false;
   }
 
   void MeshRenderer::SetControlPoints(const std::vector<glm::vec2> &polygon)
   {
     if (!mesh_) return;
-    getLasso2dRegion(polygon); // get ROI
+    getLasso2dRegion(polygon, controlFRoi_); // get ROI
 
-    allVRoi_.clear();
-    face2Vertex(allVRoi_, allFRoi_);
+    SelectionSet::FacesToVertices(*mesh_, controlFRoi_, allVRoi_);
 
     controlPts_ = allVRoi_;
-    pcaControl_->getControlSphere(controlPts_);
+    controlPts_.handles(controlList_);
+    pcaControl_->getControlSphere(controlList_);
 
-    roiverts_.clear();
+    roi_first_.clear();
+    roi_count_.clear();
+    ++selection_version_;
     isPreComputed_ = false;
   }
 
   bool MeshRenderer::PostSelection(const glm::vec2 &point)
   {
+    if (!mesh_ || controlList_.empty() || anchorPts_.empty())
+      return false;
+
+    // grab the control region where the mouse is on it, in front of the rest
+    Point origin;
+    Vec dir;
+    MeshBVH::Hit hit;
+    mouseRay(point, origin, dir);
+    if (needBVH()->intersect(origin, dir, &hit)) {
+      for (TriMesh::ConstFaceVertexIter fv_it = mesh_->cfv_iter(TriMesh::FaceHandle(hit.face)); fv_it.is_valid(); ++fv_it) {
+        if (controlPts_.contains(fv_it.handle().idx())) {
+          curPointInWorld_ = origin + hit.t * dir;
+          initialPointInCam_ = Model2View(curPointInWorld_);
+          return true;
+        }
+      }
+    }
+
+    // or by the control sphere around it
     Vec centroid_world = pcaControl_->getCentroid();
     Vec centroid_view = Model2View(centroid_world);
     double length = std::sqrt((centroid_view[0] - point[0]) * (centroid_view[0] - point[0]) +
       (centroid_view[1] - point[1]) * (centroid_view[1] - point[1]));
 
-    if (length <= 30
-      && controlPts_.size() > 0
-      && anchorPts_.size() > 0) {
+    if (length <= 30) {
       // select control points for deformation
       curPointInWorld_ = pcaControl_->getCentroid();
       initialPointInCam_ = Model2View(curPointInWorld_);
@@ -525,7 +844,11 @@ namespace hj
     curPointInWorld_ = movingPointInWorld_; // update 
     ls_->translationDeform(translationInWorld_); // deformation caused by translation
     ARAPIteration_<3 ? ls_->ARAPDeform(ARAPIteration_) : ls_->ARAPDeform(3); // intermediate result, naive LSE
-    pcaControl_->getControlSphere(controlPts_);
+    pcaControl_->getControlSphere(controlList_);
+    mesh_->needNormals();
+    bvh_dirty_ = true;
+    screen_.invalidate();
+    ++mesh_version_;
 
     // update mesh center and radius.
     mesh_->needBoundingBox();
@@ -590,8 +913,12 @@ namespace hj
 
   void MeshRenderer::CancelDeform()
   {
+    anchorFRoi_.clear();
+    controlFRoi_.clear();
     anchorPts_.clear();
     controlPts_.clear();
+    controlList_.clear();
+    ++selection_version_;
   }
 
   void MeshRenderer::RestoreMesh()
@@ -616,61 +943,96 @@ namespace hj
     glm::vec2 end = gline->GetEnd();
 
     if (!mesh_) return;
+    curFRoi_.resize((int)mesh_->n_faces());
     curFRoi_.clear();
-    roiverts_.clear();
-
-    // get depth buffer
-    int width = out_fbo_ptr_->GetWidth();
-    int height = out_fbo_ptr_->GetHeight();
-    out_fbo_ptr_->Bind();
-    glReadPixels(0, 0, width, height, GL_DEPTH_COMPONENT, GL_FLOAT, depth_buffer_);
-    out_fbo_ptr_->Unbind();
+    roi_first_.clear();
+    roi_count_.clear();
+    ++selection_version_;
+
+    // the faces crossing the plane through the eye and the line, between the planes
+    // through the eye rays at its ends
+    Point s0 = View2Model(Vec(start.x, start.y, 0)), s1 = View2Model(Vec(start.x, start.y, 1));
+    Point e0 = View2Model(Vec(end.x, end.y, 0)), e1 = View2Model(Vec(end.x, end.y, 1));
+    Vec n = (s1 - s0) % (e0 - s0);
+    if (n.norm() == 0)
+    {
+      gren_->RemoveAll();
+      return;
+    }
+    n.normalize();
+    MeshBVH::Plane planes[4];
+    planes[0].n = n;
+    planes[0].d = -(n | s0);
+    planes[1].n = -n;
+    planes[1].d = n | s0;
+    Vec side = n % (s1 - s0);
+    planes[2].n = (side | (e0 - s0)) < 0 ? -side : side;
+    planes[2].d = -(planes[2].n | s0);
+    side = n % (e1 - e0);
+    planes[3].n = (side | (s0 - e0)) < 0 ? -side : side;
+    planes[3].d = -(planes[3].n | e0);
+    MeshBVH* bvh = needBVH();
+    std::vector<int> candidates;
+    bvh->query(planes, 4, candidates);
+
+    // candidates in front of the eye the line crosses on screen
+    const ScreenSpace& screen = needScreen();
+    const std::vector<unsigned int>& indices = mesh_->triangleIndices();
+    const SelectionSet& front = screen.front();
+    size_t kept = 0;
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+      const unsigned int* t = &indices[3 * candidates[i]];
+      if (front.contains((int)t[0]) && front.contains((int)t[1]) && front.contains((int)t[2]))
+        candidates[kept++] = candidates[i];
+    }
+    candidates.resize(kept);
+    std::vector<unsigned char> crossing(candidates.size());
+    if (!candidates.empty())
+      ScanLine::Intersecting(start, end, screen.x(), screen.y(), &indices[0],
+        &candidates[0], (int)candidates.size(), &crossing[0]);
+    std::vector<int> crossed;
+    for (size_t i = 0; i < candidates.size(); i++)
+    {
+      if (crossing[i])
+        crossed.push_back(candidates[i]);
+    }
 
-    TriMesh::FaceIter f_it;
-    TriMesh::FaceVertexIter fv_it;
-    TriMesh::Point p;
-    std::vector<TriMesh::Point> triangle;
-    for (f_it = mesh_->faces_begin(); f_it != mesh_->faces_end(); ++f_it)
+    // visible ones: nothing is hit before one of the vertices on the ray from the eye
+    glm::vec4 eye = glm::inverse(camera_.GetViewMatrix() * model_) * glm::vec4(0, 0, 0, 1);
+    int count = (int)crossed.size();
+    std::vector<float> origins(9 * count), dirs(9 * count);
+    for (int i = 0; i < count; i++)
     {
-      // get face vertices.
-      triangle.clear();
-      for (fv_it = mesh_->fv_iter(f_it); fv_it.is_valid(); ++fv_it)
+      const unsigned int* t = &indices[3 * crossed[i]];
+      for (int j = 0; j < 3; j++)
       {
-        p = mesh_->point(fv_it);  // model
-        p = Model2View(p);        // view
-        triangle.push_back(p);
-      }
-
-      if (triangle.size() != 3) {
-        assert(0);
-        return;
+        const Point& p = mesh_->point(TriMesh::VertexHandle((int)t[j]));
+        for (int k = 0; k < 3; k++)
+        {
+          origins[9 * i + 3 * j + k] = eye[k] / eye.w;
+          dirs[9 * i + 3 * j + k] = p[k] - origins[9 * i + 3 * j + k];
+        }
       }
-
-      // judge intersection with line.
-      if (ScanLine::Intersecting(start, end,
-        glm::vec2(triangle[0][0], triangle[0][1]),
-        glm::vec2(triangle[1][0], triangle[1][1]),
-        glm::vec2(triangle[2][0], triangle[2][1])))
+    }
+    std::vector<MeshBVH::Hit> hits(3 * count);
+    if (count)
+      bvh->intersect(&origins[0], &dirs[0], 3 * count, &hits[0]);
+    for (int i = 0; i < count; i++)
+    {
+      for (int j = 0; j < 3; j++)
       {
-        // depth test
-        //if (triangle[0][2] <= depth_ //depth_buffer_[(int)triangle[0][1] * width + (int)triangle[0][0]]
-        //  || triangle[1][2] <= depth_ // depth_buffer_[(int)triangle[1][1] * width + (int)triangle[1][0]]
-        //  || triangle[2][2] <= depth_) // depth_buffer_[(int)triangle[2][1] * width + (int)triangle[2][0]])
-        if (triangle[0][2] <= depth_buffer_[(int)triangle[0][1] * width + (int)triangle[0][0]]
-          || triangle[1][2] <= depth_buffer_[(int)triangle[1][1] * width + (int)triangle[1][0]]
-          || triangle[2][2] <= depth_buffer_[(int)triangle[2][1] * width + (int)triangle[2][0]])
-          curFRoi_.push_back(f_it);
+        const MeshBVH::Hit& hit = hits[3 * i + j];
+        if (hit.face == crossed[i] || hit.t >= 1 - 1e-3f)
+        {
+          curFRoi_.insert(crossed[i]);
+          break;
+        }
       }
     }
 
     // face to vertices
-    for (unsigned int i = 0; i<curFRoi_.size(); i++)
-    {
-      TriMesh::ConstFaceVertexIter fvit = mesh_->cfv_iter(curFRoi_[i]);
-      roiverts_.push_back(fvit.handle().idx());	++fvit;
-      roiverts_.push_back(fvit.handle().idx());	++fvit;
-      roiverts_.push_back(fvit.handle().idx());
-    }
+    setROIRanges(curFRoi_);
 
     gren_->RemoveAll();
   }
@@ -704,6 +1066,56 @@ namespace hj
     cyl.selected = true;
 
     cylinders_.push_back(cyl);
+    ++cylinder_version_;
+  }
+
+  void MeshRenderer::mouseRay(const glm::vec2 &point, Point &origin, Vec &dir)
+  {
+    origin = View2Model(Vec(point.x, point.y, 0));
+    dir = View2Model(Vec(point.x, point.y, 1)) - origin;
+  }
+
+  MeshBVH* MeshRenderer::needBVH()
+  {
+    if (!mesh_)
+      return NULL;
+    if (!bvh_)
+    {
+      bvh_ = new MeshBVH();
+      bvh_->build(mesh_);
+    }
+    else if (bvh_dirty_)
+      bvh_->refit();
+    bvh_dirty_ = false;
+    return bvh_;
+  }
+
+  GLMeshBuffer* MeshRenderer::needMeshBuffer()
+  {
+    mesh_->needNormals();
+    int first, last;
+    bool changed = mesh_->takeChangedRange(first, last);
+    if (!mesh_buffer_)
+    {
+      mesh_buffer_ = new GLMeshBuffer();
+      mesh_buffer_->Create(mesh_, kOctNormalAttrib, kUnormTexCoordAttrib, kSelectionAttrib);
+    }
+    else if (changed)
+    {
+      mesh_buffer_->Update(first, last);
+    }
+    return mesh_buffer_;
+  }
+
+  const ScreenSpace& MeshRenderer::needScreen()
+  {
+    glm::mat4 volume2ClipCoord = camera_.GetViewProjectionMatrix() * model_;
+    int width = out_fbo_ptr_->GetWidth();
+    int height = out_fbo_ptr_->GetHeight();
+    if (!screen_.isValid(&volume2ClipCoord[0][0], width, height))
+      screen_.project((const float*)mesh_->points(), (int)mesh_->n_vertices(),
+        &volume2ClipCoord[0][0], width, height);
+    return screen_;
   }
 
   void MeshRenderer::DeSelectAll()
@@ -712,6 +1124,7 @@ namespace hj
     {
       cylinders_[i].selected = false;
     }
+    ++cylinder_version_;
   }
 
   bool MeshRenderer::CheckSelection(float mouseX, float mouseY)
@@ -723,17 +1136,39 @@ namespace hj
     if (mouseX < 0 || mouseX > width || mouseY < 0 || mouseY > height) 
       return false;
     
-    char index = 0;
-    out_fbo_ptr_->Bind();
-    glReadPixels(int(mouseX), int(mouseY), 1, 1, GL_STENCIL_INDEX, GL_BYTE, &index);
-    out_fbo_ptr_->Unbind();
+    // the nearest cylinder under the mouse, unless the mesh is in front of it
+    Vec o = View2World(Vec(mouseX, mouseY, 0));
+    Vec d = View2World(Vec(mouseX, mouseY, 1)) - o;
+    int nearest = -1;
+    float nearest_t = FLT_MAX, t;
+    for (size_t i = 0; i < cylinders_.size(); ++i)
+    {
+      const Cylinder& c = cylinders_[i];
+      glm::mat4 world2cyl = glm::inverse(c.model_matrix);
+      glm::vec4 oc = world2cyl * glm::vec4(o[0], o[1], o[2], 1);
+      glm::vec4 dc = world2cyl * glm::vec4(d[0], d[1], d[2], 0);
+      if (RayTube(glm::vec3(oc), glm::vec3(dc), c.inner_radius, c.outer_radius, c.height / 2, &t) && t < nearest_t)
+      {
+        nearest = (int)i;
+        nearest_t = t;
+      }
+    }
+    if (nearest < 0)
+      return false;
 
-    if (index > kiMeshStencilRef && index <= (char)cylinders_.size() + kiMeshStencilRef) {
-      cylinders_[index - 1 - kiMeshStencilRef].selected = true;
-      return true;
+    // the model ray between the same window points has the same t
+    if (mesh_)
+    {
+      Point origin;
+      Vec dir;
+      MeshBVH::Hit hit;
+      mouseRay(glm::vec2(mouseX, mouseY), origin, dir);
+      if (needBVH()->intersect(origin, dir, &hit, nearest_t))
+        return false;
     }
-      
-    return false;
+    cylinders_[nearest].selected = true;
+    ++cylinder_version_;
+    return true;
   }
 
   Cylinder* MeshRenderer::GetSelection()
@@ -764,6 +1199,7 @@ namespace hj
     if (cyl) {
       if (r < cyl->outer_radius)
         cyl->inner_radius = r;
+      ++cylinder_version_;
     }
   }
 
@@ -773,6 +1209,7 @@ namespace hj
     if (cyl) {
       if (r > cyl->inner_radius)
         cyl->outer_radius = r;
+      ++cylinder_version_;
     }
   }
 
@@ -781,6 +1218,7 @@ namespace hj
     Cylinder* cyl = GetSelection();
     if (cyl) {
       cyl->height = h;
+      ++cylinder_version_;
     }
   }
 }
\ No newline at end of file
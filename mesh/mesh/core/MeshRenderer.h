@@ -4,6 +4,8 @@
 #include "common/macro.h"
 #include "common/glmext.h"
 #include "common/TriMesh.h"
+#include "common/SelectionSet.h"
+#include "common/ScreenSpace.h"
 #include "common/Camera.h"
 #include "common/Trackball.h"
 
@@ -11,6 +13,8 @@ namespace hj
 {
   class GLFramebuffer;
   class GLProgram;
+  class MeshBVH;
+  class GLMeshBuffer;
   class Image;
   class PCA;
   class LaplacianSurface;
@@ -138,6 +142,23 @@ namespace hj
     */
     void SetTexture(bool t);
 
+    /**
+    * Set the attributes kept by meshes loaded afterwards, TriMesh::Attribute flags.
+    */
+    void SetMeshAttributes(unsigned int attributes);
+
+    /**
+    * Set how the next lassos are combined with the anchor or control region:
+    * replace, add (shift), subtract (ctrl) or intersect.
+    */
+    void SetSelectionMode(SelectionSet::Operation mode);
+
+    /**
+    * Set whether lassos select only the vertices that can be seen, or all the
+    * vertices under them.
+    */
+    void SetLassoVisibleOnly(bool v);
+
     /**
     * Set anchor points.
     * @param polygon: polygon points array.
@@ -212,9 +233,20 @@ namespace hj
     
     TriMesh* GetMesh() { return mesh_; }
 
-    std::vector<TriMesh::VHandle>& GetControlPts() { return controlPts_; }
+    const SelectionSet& GetControlPts() { return controlPts_; }
+
+    const SelectionSet& GetAnchorPts() { return anchorPts_; }
 
-    std::vector<TriMesh::VHandle>& GetAnchorPts() { return anchorPts_; }
+    /**
+    * Version of everything Run() draws: the sum of the camera, mesh, selection,
+    * cylinder and display counters, each counting its changes.
+    * @return: a number that changes whenever the drawing would.
+    */
+    unsigned int GetVersion() const
+    {
+      return camera_version_ + mesh_version_ + selection_version_ +
+        cylinder_version_ + display_version_;
+    }
 
   private:
 
@@ -233,27 +265,46 @@ namespace hj
     */
     void drawROI(double r, double g, double b);
 
+    /**
+    * Binds the program that decodes quantized normals and texture coordinates,
+    * creating it on first use.
+    * @return: True if bound, false if shaders are not supported.
+    */
+    bool bindLeanProgram(bool textured);
+
+    /**
+    * Binds the program that draws the solid mesh, its wireframe and the ROI in one
+    * pass, creating it on first use.
+    * @return: True if bound, false if geometry shaders are not supported; the mesh
+    * is then drawn by the fixed function passes.
+    */
+    bool bindSurfaceProgram(bool textured);
+
     /**
     * get ROI region from lasso 2d
-    * project vertices to camera coordinate system, then project these points to near plane,
-    * then check if they're inside of the lasso lines (which is a polygon).
-    * check if point is inside of polygon
-    * http://www.ecse.rpi.edu/Homepages/wrf/Research/Short_Notes/isInsideOfPolygon.html
+    * the lasso is rasterized into a LassoMask, vertices are projected to window
+    * coordinates and kept if their pixel is covered; with SetLassoVisibleOnly, the
+    * back-facing and occluded ones are then left out.
     * @param polygon: lasso3d point set.
+    * @param roi: face set the lasso is combined into with the selection mode.
+    */
+    void getLasso2dRegion(const std::vector<glm::vec2> &polygon, SelectionSet &roi);
+
+    /**
+    * ROI face ranges for drawing the faces of a set.
     */
-    void getLasso2dRegion(const std::vector<glm::vec2> &polygon);
+    void setROIRanges(const SelectionSet &faces);
 
     /**
-    * vertex set -> face set
+    * @return: the GPU buffers of the mesh, created on first use and updated with
+    * the vertices changed since.
     */
-    void vertex2Face(std::vector<TriMesh::VHandle> &vset,
-      std::vector<TriMesh::FHandle> &bfs);
+    GLMeshBuffer* needMeshBuffer();
 
     /**
-    * face set -> vertex set
+    * Removes the vertices facing away from the eye or hidden behind other faces.
     */
-    void face2Vertex(std::vector<TriMesh::VHandle> &vset,
-      std::vector<TriMesh::FHandle> &fset);
+    void removeHidden(SelectionSet &vertices);
 
     /**
     * Transform point form view coordiante to model coordinate.
@@ -283,6 +334,24 @@ namespace hj
     */
     Vec World2View(const Vec &point);
 
+    /**
+    * Ray under a window point in model coordinates, from the near plane (t = 0) to
+    * the far plane (t = 1).
+    */
+    void mouseRay(const glm::vec2 &point, Point &origin, Vec &dir);
+
+    /**
+    * @return: the BVH of the mesh, built on first use and refitted after deformation;
+    * NULL without a mesh.
+    */
+    MeshBVH* needBVH();
+
+    /**
+    * @return: window positions of the vertices under the current camera, projected
+    * again only when the camera, the window or the mesh changed.
+    */
+    const ScreenSpace& needScreen();
+
     /**
     * de select all cylinders.
     */
@@ -307,11 +376,8 @@ namespace hj
     /** mesh radius in world coordinate. */
     float radius_;
 
-    /** All vertices for drawing. */
-    std::vector<unsigned int> triverts_;
-
-    /** ROI vertices for drawing. */
-    std::vector<unsigned int> roiverts_;
+    /** ROI for drawing, as ranges [first, first + count) of faces. */
+    std::vector<int> roi_first_, roi_count_;
 
     PerspectiveCamera camera_;
     Trackball trackball_;
@@ -331,12 +397,32 @@ namespace hj
 
     Image* texture_image_;
 
-    std::vector<TriMesh::FHandle> curFRoi_; // current bfs result, face list
-    std::vector<TriMesh::FHandle> allFRoi_; // all Roi with boolean operations in every step, face list
-    std::vector<TriMesh::VHandle> allVRoi_; // all Roi, vertex list
+    /** TriMesh::Attribute flags of loaded meshes. */
+    unsigned int mesh_attributes_;
+
+    /** lighting for quantized attributes, NULL until first used. */
+    GLProgram* lean_program_;
+
+    /** single pass solid, wireframe and ROI shading, NULL until first used. */
+    GLProgram* surface_program_;
+
+    /** vertex and index buffers of the mesh, NULL until needMeshBuffer(). */
+    GLMeshBuffer* mesh_buffer_;
+
+    SelectionSet curFRoi_; // faces of the current lasso
+    SelectionSet anchorFRoi_; // anchor Roi with boolean operations in every step, face set
+    SelectionSet controlFRoi_; // control Roi with boolean operations in every step, face set
+    SelectionSet allVRoi_; // vertices of the last edited Roi
 
-    std::vector<TriMesh::VHandle> controlPts_; // control points, for deformation
-    std::vector<TriMesh::VHandle> anchorPts_; // anchor points, for deformation
+    SelectionSet controlPts_; // control points, for deformation
+    SelectionSet anchorPts_; // anchor points, for deformation
+    std::vector<TriMesh::VHandle> controlList_; // control points in order, for the control sphere
+
+    /** how a lasso is combined with the selected region. */
+    SelectionSet::Operation selection_mode_;
+
+    /** lassos leave out back-facing and occluded vertices. */
+    bool lasso_visible_only_;
 
     PCA* pcaAnchor_;
     PCA *pcaControl_;
@@ -354,13 +440,27 @@ namespace hj
     /** hold mesh file name for mesh restore. */
     std::string meshfile_;
 
-    /** depth buffer. */
-    float* depth_buffer_;
+    /** faces of the mesh for picking and cutting, NULL until needBVH(). */
+    MeshBVH* bvh_;
+
+    /** the mesh moved since the BVH was fitted. */
+    bool bvh_dirty_;
+
+    /** vertex window positions, see needScreen(). */
+    ScreenSpace screen_;
 
     GraphicsRenderer* gren_;
 
     /** cylinder array. */
     std::vector<Cylinder> cylinders_;
+
+    /** changes of the view, the mesh positions, the ROI and control/anchor
+    regions, the cylinders, and the display options, see GetVersion(). */
+    unsigned int camera_version_;
+    unsigned int mesh_version_;
+    unsigned int selection_version_;
+    unsigned int cylinder_version_;
+    unsigned int display_version_;
   };
 }
 #endif // HJ_MeshRenderer_h__
\ No newline at end of file
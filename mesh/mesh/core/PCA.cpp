@@ -1,5 +1,6 @@
 #include "PCA.h"
 #include "common/glgeometry.h"
+#include <float.h>
 
 namespace hj
 {
@@ -38,23 +39,26 @@ namespace hj
     getPCACentroid(allVRoi);
     axis_.clear();
     obb_.clear();
-    Matrix X((int)allVRoi.size(), 3);
+    // S = X.t() * X, X is the n by 3 matrix of centered positions
+    Mat3d S = Mat3d::zero();
     for (unsigned int i = 0; i<allVRoi.size(); i++)
     {
-      X(i + 1, 1) = (mesh_->point(allVRoi[i]))[0] - centroid_[0];
-      X(i + 1, 2) = (mesh_->point(allVRoi[i]))[1] - centroid_[1];
-      X(i + 1, 3) = (mesh_->point(allVRoi[i]))[2] - centroid_[2];
+      Vec3d x = MakeVec3(
+        (double)((mesh_->point(allVRoi[i]))[0] - centroid_[0]),
+        (double)((mesh_->point(allVRoi[i]))[1] - centroid_[1]),
+        (double)((mesh_->point(allVRoi[i]))[2] - centroid_[2]));
+      S.addOuter(x, x);
     }
-    Matrix S; S << X.t() * X;
-    Matrix U, V;
-    DiagonalMatrix D;
-    SVD(S, D, U, V);  // X = U * D * V.t()
+    // S is symmetric, its SVD U * D * U.t() is the eigen decomposition
+    double D[3];
+    Mat3d U;
+    SymmetricEigen(S, D, U);
     Point ptmp;
     for (int i = 0; i<3; i++)
     {
-      ptmp[0] = (float)U(1, i + 1);
-      ptmp[1] = (float)U(2, i + 1);
-      ptmp[2] = (float)U(3, i + 1);
+      ptmp[0] = (float)U(0, i);
+      ptmp[1] = (float)U(1, i);
+      ptmp[2] = (float)U(2, i);
       ptmp.normalize();
       axis_.push_back(ptmp);
     }
@@ -63,53 +67,51 @@ namespace hj
   void PCA::getPCAOBB(std::vector<TriMesh::VHandle> &allVRoi)
   {
     getPCAAxis(allVRoi);
-    Matrix rotate(4, 4);
-    Matrix transformation = getPCATransformation();
+    Mat4d transformation = getPCATransformation();
+    Mat4d inverse;
+    if (!transformation.inverse(inverse))
+      inverse = Mat4d::identity();
     double xmax = -DBL_MAX, ymax = -DBL_MAX, zmax = -DBL_MAX;
     double xmin = DBL_MAX, ymin = DBL_MAX, zmin = DBL_MAX;
-    ColumnVector pt(4);
     // find unoriented bounding box in original coordinate system
     for (unsigned int i = 0; i<allVRoi.size(); i++)
     {
-      for (int j = 0; j<3; j++)
-        pt(j + 1) = (mesh_->point(allVRoi[i]))[j];
-      pt(4) = 1;
-      pt = transformation * pt;
-      if (pt(1)>xmax)
-        xmax = pt(1);
-      if (pt(1)<xmin)
-        xmin = pt(1);
-      if (pt(2)>ymax)
-        ymax = pt(2);
-      if (pt(2)<ymin)
-        ymin = pt(2);
-      if (pt(3)>zmax)
-        zmax = pt(3);
-      if (pt(3)<zmin)
-        zmin = pt(3);
+      const Point& p = mesh_->point(allVRoi[i]);
+      Vec3d pt = transformation.transformPoint(MakeVec3((double)p[0], (double)p[1], (double)p[2]));
+      if (pt[0]>xmax)
+        xmax = pt[0];
+      if (pt[0]<xmin)
+        xmin = pt[0];
+      if (pt[1]>ymax)
+        ymax = pt[1];
+      if (pt[1]<ymin)
+        ymin = pt[1];
+      if (pt[2]>zmax)
+        zmax = pt[2];
+      if (pt[2]<zmin)
+        zmin = pt[2];
     }
     // front face:
     // 1 -- 2
     //  |      |
     // 3 -- 4
-    addOneOBBPoint(xmin, ymax, zmax, transformation, pt);
-    addOneOBBPoint(xmax, ymax, zmax, transformation, pt);
-    addOneOBBPoint(xmax, ymax, zmin, transformation, pt);
-    addOneOBBPoint(xmin, ymax, zmin, transformation, pt);
+    addOneOBBPoint(xmin, ymax, zmax, inverse);
+    addOneOBBPoint(xmax, ymax, zmax, inverse);
+    addOneOBBPoint(xmax, ymax, zmin, inverse);
+    addOneOBBPoint(xmin, ymax, zmin, inverse);
     // back face:
     // 5 -- 6
     //  |     |
     // 7 -- 8
-    addOneOBBPoint(xmin, ymin, zmax, transformation, pt);
-    addOneOBBPoint(xmax, ymin, zmax, transformation, pt);
-    addOneOBBPoint(xmax, ymin, zmin, transformation, pt);
-    addOneOBBPoint(xmin, ymin, zmin, transformation, pt);
+    addOneOBBPoint(xmin, ymin, zmax, inverse);
+    addOneOBBPoint(xmax, ymin, zmax, inverse);
+    addOneOBBPoint(xmax, ymin, zmin, inverse);
+    addOneOBBPoint(xmin, ymin, zmin, inverse);
   }
 
-  Matrix PCA::getPCATransformation()
+  Mat4d PCA::getPCATransformation()
   {
-    Matrix rotate(4, 4);
-    rotate = 0;
+    Mat4d rotate = Mat4d::identity();
     // rotation matrix is defined as:
     // ux1 ux2 ux3 0
     // uy1 uy2 uy3 0
@@ -118,10 +120,8 @@ namespace hj
     // Here u is the axis, this matrix will rotate axis to original coordinate system
     for (int i = 0; i<3; i++)
     for (int j = 0; j<3; j++)
-      rotate(i + 1, j + 1) = (axis_[i])[j];
-    rotate(4, 4) = 1;
-    Matrix translate(4, 4);
-    translate = 0;
+      rotate(i, j) = (axis_[i])[j];
+    Mat4d translate = Mat4d::identity();
     // translation matrix is defined as:
     // 1 0 0 tx
     // 0 1 0 ty
@@ -129,23 +129,16 @@ namespace hj
     // 0 0 0 1
     // Here t is centroid, this matrix will translate centroid to original point (0,0,0)
     for (int i = 0; i<3; i++)
-    {
-      translate(i + 1, i + 1) = 1;
-      translate(i + 1, 4) = centroid_[i];
-    }
-    translate(4, 4) = 1;
-    Matrix transformation;
-    transformation << rotate * translate;
-    return transformation;
+      translate(i, 3) = centroid_[i];
+    return rotate * translate;
   }
 
-  void PCA::addOneOBBPoint(double x, double y, double z, Matrix &transformation, ColumnVector & pt)
+  void PCA::addOneOBBPoint(double x, double y, double z, const Mat4d &inverse)
   {
-    pt(1) = x; pt(2) = y; pt(3) = z;
     // transform vertices back, now they'll be vertices on OBB
-    pt = transformation.i() * pt;
+    Vec3d pt = inverse.transformPoint(MakeVec3(x, y, z));
     Point ptobb;
-    ptobb[0] = (float)pt(1); ptobb[1] = (float)pt(2); ptobb[2] = (float)pt(3);
+    ptobb[0] = (float)pt[0]; ptobb[1] = (float)pt[1]; ptobb[2] = (float)pt[2];
     obb_.push_back(ptobb);
   }
 
@@ -2,7 +2,7 @@
 #define HJ_PCA_h__
 
 #include "common/TriMesh.h"
-#include "newmatap.h" // need matrix applications
+#include "common/SmallMatrix.h"
 
 namespace hj
 {
@@ -51,9 +51,12 @@ namespace hj
     */
     void drawControlSphere();
 
-    Matrix getPCATransformation();
+    Mat4d getPCATransformation();
 
-    void addOneOBBPoint(double x, double y, double z, Matrix &transformation, ColumnVector & pt);
+    /**
+    * maps (x, y, z) back with the inverse of the PCA transformation and appends it to obb_
+    */
+    void addOneOBBPoint(double x, double y, double z, const Mat4d &inverse);
 
     void getControlSphere(std::vector<TriMesh::VHandle> &controlPts);
 
@@ -11,6 +11,7 @@ namespace hj
   GraphicsRenderer::GraphicsRenderer()
     : out_fbo_ptr_(NULL)
     , tool_type_(ToolType::Pointer)
+    , version_(0)
   {
     tools_[ToolType::Pointer] = new ToolPointer();
     tools_[ToolType::Line] = new ToolLine();
@@ -31,6 +32,7 @@ namespace hj
   bool GraphicsRenderer::SetFBO(GLFramebuffer* fbo)
   {
     out_fbo_ptr_ = fbo;
+    ++version_;
     return true;
   }
 
@@ -64,8 +66,11 @@ namespace hj
     if (tool_type_ < 0 || tool_type_ >= ToolType::Max
       || tools_[tool_type_] == NULL) return false;
 
-    return tools_[tool_type_]->OnMouseDown(this,
+    bool changed = tools_[tool_type_]->OnMouseDown(this,
       point);
+    if (changed)
+      ++version_;
+    return changed;
   }
 
   bool GraphicsRenderer::OnMouseMove(const glm::vec2 &point)
@@ -73,8 +78,11 @@ namespace hj
     if (tool_type_ < 0 || tool_type_ >= ToolType::Max
       || tools_[tool_type_] == NULL) return false;
 
-    return tools_[tool_type_]->OnMouseMove(this,
+    bool changed = tools_[tool_type_]->OnMouseMove(this,
       point);
+    if (changed)
+      ++version_;
+    return changed;
   }
 
   bool GraphicsRenderer::OnMouseUp(const glm::vec2 &point)
@@ -82,8 +90,11 @@ namespace hj
     if (tool_type_ < 0 || tool_type_ >= ToolType::Max
       || tools_[tool_type_] == NULL) return false;
 
-    return tools_[tool_type_]->OnMouseUp(this,
+    bool changed = tools_[tool_type_]->OnMouseUp(this,
       point);
+    if (changed)
+      ++version_;
+    return changed;
   }
 
   void GraphicsRenderer::UnselectAll()
@@ -92,11 +103,13 @@ namespace hj
     for (size_t i = 0; i < count; ++i) {
       graphics_array_[i]->SetSelection(false);
     }
+    ++version_;
   }
 
   void GraphicsRenderer::RemoveAll()
   {
     graphics_array_.clear();
+    ++version_;
   }
 
   void GraphicsRenderer::RemoveSelection()
@@ -106,6 +119,7 @@ namespace hj
       if ((*iter)->GetSelection()) {
         delete (*iter);
         graphics_array_.erase(iter);
+        ++version_;
         return;
       }
     }
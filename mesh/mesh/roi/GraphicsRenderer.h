@@ -95,6 +95,12 @@ namespace hj
     std::vector<GraphicsBase*>& GetGraphics() 
     { return graphics_array_; }
 
+    /**
+    * Get version of the graphic objects, which changes whenever Run() would draw
+    * them differently.
+    */
+    unsigned int GetVersion() const { return version_; }
+
   private:
     /** Output frame buffer. */
     GLFramebuffer* out_fbo_ptr_;
@@ -104,6 +110,9 @@ namespace hj
     ToolType tool_type_;
 
     ToolBase* tools_[ToolType::Max];
+
+    /** count of changes to the graphic objects. */
+    unsigned int version_;
   };
 
 }
@@ -31,6 +31,30 @@ namespace hj
       output_buffer->Length);
   }
 
+  IntPtr ManagerCLR::MapView(int% buffer_len)
+  {
+    int len = 0;
+    const uint8_t* pixels = mgr_ptr_->MapView(&len);
+    buffer_len = len;
+    return IntPtr((void*)pixels);
+  }
+
+  void ManagerCLR::UnmapView()
+  {
+    mgr_ptr_->UnmapView();
+  }
+
+  void ManagerCLR::SetAsyncReadback(bool async)
+  {
+    mgr_ptr_->SetAsyncReadback(async);
+  }
+
+  void ManagerCLR::GetFrameStatistics(array<int>^ stats)
+  {
+    pin_ptr<int> pinned_stats = &stats[0];
+    mgr_ptr_->GetFrameStatistics(pinned_stats);
+  }
+
   bool ManagerCLR::Resize(int new_width, int new_height)
   {
     return mgr_ptr_->Resize(new_width, new_height);
@@ -129,6 +153,21 @@ namespace hj
     mgr_ptr_->SetTexture(t);
   }
 
+  void ManagerCLR::SetMeshAttributes(unsigned int attributes)
+  {
+    mgr_ptr_->SetMeshAttributes(attributes);
+  }
+
+  void ManagerCLR::SetSelectionMode(int mode)
+  {
+    mgr_ptr_->SetSelectionMode(mode);
+  }
+
+  void ManagerCLR::SetLassoVisibleOnly(bool v)
+  {
+    mgr_ptr_->SetLassoVisibleOnly(v);
+  }
+
   void ManagerCLR::SetAnchorPoints(array<float>^ polyx,
     array<float>^ polyy,
     int count)
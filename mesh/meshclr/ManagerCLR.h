@@ -42,6 +42,29 @@ namespace hj
     */
     void GetView(array<unsigned char>^ output_buffer);
 
+    /**
+    * Renders the view and maps its pixels, see Manager::MapView(); read them in
+    * place, e.g. with WriteableBitmap.WritePixels, then call UnmapView().
+    * @param buffer_len: receives the size of the pixel data.
+    * @return: the pixel data, IntPtr::Zero if nothing could be read.
+    */
+    IntPtr MapView(int% buffer_len);
+
+    /**
+    * Releases the pixels returned by MapView().
+    */
+    void UnmapView();
+
+    /**
+    * Set whether frames are read back asynchronously, see Manager::SetAsyncReadback().
+    */
+    void SetAsyncReadback(bool async);
+
+    /**
+    * Get frame counts: rendered in full, graphics only, and skipped.
+    */
+    void GetFrameStatistics(array<int>^ stats);
+
     /**
     * Resizes output image.
     * @param new_width: Width of Rendering View.
@@ -131,6 +154,22 @@ namespace hj
     */
     void SetTexture(bool t);
 
+    /**
+    * Set the attributes kept by meshes loaded afterwards, TriMesh::Attribute flags.
+    */
+    void SetMeshAttributes(unsigned int attributes);
+
+    /**
+    * Set how the next lassos are combined with the selected region:
+    * 0 replace, 1 add (shift), 2 subtract (ctrl), 3 intersect.
+    */
+    void SetSelectionMode(int mode);
+
+    /**
+    * Set whether lassos select only the visible vertices under them.
+    */
+    void SetLassoVisibleOnly(bool v);
+
     /**
     * Set anchor points.
     * @param polygon: polygon points array.
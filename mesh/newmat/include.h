@@ -28,6 +28,9 @@
 
 //#define DO_FREE_CHECK                   // check news and deletes balance
 
+//#define NO_TRACER                       // Tracer objects do nothing;
+					// exceptions are reported without trace
+
 #define USING_DOUBLE                    // elements of type double
 //#define USING_FLOAT                   // elements of type float
 
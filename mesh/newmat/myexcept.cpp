@@ -47,24 +47,13 @@ void Throw()
 #endif                                 // end of simulate exceptions
 
 
-unsigned long BaseException::Select;
-char* BaseException::what_error;
-int BaseException::SoFar;
-int BaseException::LastOne;
+RBD_THREAD_LOCAL unsigned long BaseException::Select;
+RBD_THREAD_LOCAL char BaseException::what_error[LastOne+1];
+RBD_THREAD_LOCAL int BaseException::SoFar;
 
 BaseException::BaseException(const char* a_what)
 {
-   Select++; SoFar = 0;
-   if (!what_error)                   // make space for exception message
-   {
-      LastOne = 511;
-      what_error = new char[512];
-      if (!what_error)                // fail to make space
-      {
-         LastOne = 0;
-         what_error = (char *)"No heap space for exception message\n";
-      }
-   }
+   Select++; SoFar = 0; what_error[0] = 0;
    AddMessage("\n\nAn exception has been thrown\n");
    AddMessage(a_what);
    if (a_what) Tracer::AddTrace();
@@ -108,13 +97,16 @@ void BaseException::AddInt(int value)
 
 void Tracer::PrintTrace()
 {
+#ifndef NO_TRACER
    cout << "\n";
    for (Tracer* et = last; et; et=et->previous)
       cout << "  * " << et->entry << "\n";
+#endif
 }
 
 void Tracer::AddTrace()
 {
+#ifndef NO_TRACER
    if (last)
    {
       BaseException::AddMessage("Trace: ");
@@ -126,6 +118,7 @@ void Tracer::AddTrace()
       }
       BaseException::AddMessage(".\n");
    }
+#endif
 }
 
 #ifdef SimulateExceptions
@@ -220,7 +213,8 @@ JanitorInitializer::JanitorInitializer()
 
 #endif                              // end of SimulateExceptions
 
-Tracer* Tracer::last;               // will be set to zero
+RBD_THREAD_LOCAL Tracer* Tracer::last;
+                                    // will be set to zero in each thread
 
 
 void Terminate()
@@ -475,17 +469,17 @@ Bad_alloc::Bad_alloc(const char* a_what) : BaseException()
 
 
 
-unsigned long Logic_error::Select;
-unsigned long Runtime_error::Select;
-unsigned long Domain_error::Select;
-unsigned long Invalid_argument::Select;
-unsigned long Length_error::Select;
-unsigned long Out_of_range::Select;
+RBD_THREAD_LOCAL unsigned long Logic_error::Select;
+RBD_THREAD_LOCAL unsigned long Runtime_error::Select;
+RBD_THREAD_LOCAL unsigned long Domain_error::Select;
+RBD_THREAD_LOCAL unsigned long Invalid_argument::Select;
+RBD_THREAD_LOCAL unsigned long Length_error::Select;
+RBD_THREAD_LOCAL unsigned long Out_of_range::Select;
 //unsigned long Bad_cast::Select;
 //unsigned long Bad_typeid::Select;
-unsigned long Range_error::Select;
-unsigned long Overflow_error::Select;
-unsigned long Bad_alloc::Select;
+RBD_THREAD_LOCAL unsigned long Range_error::Select;
+RBD_THREAD_LOCAL unsigned long Overflow_error::Select;
+RBD_THREAD_LOCAL unsigned long Bad_alloc::Select;
 
 #ifdef use_namespace
 }
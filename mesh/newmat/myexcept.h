@@ -42,7 +42,18 @@
 //
 //   For each exceptions class, EX_1, some .cpp file must include
 //
-//      unsigned long EX_1::Select;
+//      RBD_THREAD_LOCAL unsigned long EX_1::Select;
+//
+//   (the RBD_THREAD_LOCAL qualifier goes on the declaration as well).
+//
+//   The Tracer list and the exception record are kept per thread, so
+//   with UseExceptions or DisableExceptions matrices can be used from
+//   several threads at once (each thread with its own matrices).
+//   SimulateExceptions keeps a single global jump list and must only be
+//   used from one thread.
+//
+//   With NO_TRACER defined in include.h Tracer objects do nothing and
+//   exception messages carry no trace.
 //
 
 
@@ -51,6 +62,12 @@
 
 #include "include.h"
 
+#if defined(_MSC_VER)
+#define RBD_THREAD_LOCAL __declspec(thread)
+#else
+#define RBD_THREAD_LOCAL __thread
+#endif
+
 #ifdef use_namespace
 namespace RBD_COMMON {
 #endif
@@ -73,7 +90,7 @@ public:
    void ReName(const char*);
    static void PrintTrace();             // for printing trace
    static void AddTrace();               // insert trace in exception record
-   static Tracer* last;                  // points to Tracer list
+   static RBD_THREAD_LOCAL Tracer* last; // points to this thread s list
    static void clear() {}                // for compatibility
    friend class BaseException;
 };
@@ -82,14 +99,16 @@ public:
 class BaseException                          // The base exception class
 {
 protected:
-   static char* what_error;              // error message
-   static int SoFar;                     // no. characters already entered
-   static int LastOne;                   // last location in error buffer
+   enum { LastOne = 511 };               // last location in error buffer
+   static RBD_THREAD_LOCAL char what_error[LastOne+1];
+                                         // error message
+   static RBD_THREAD_LOCAL int SoFar;    // no. characters already entered
 public:
    static void AddMessage(const char* a_what);
                                          // messages about exception
    static void AddInt(int value);        // integer to error message
-   static unsigned long Select;          // for identifying exception
+   static RBD_THREAD_LOCAL unsigned long Select;
+                                         // for identifying exception
    BaseException(const char* a_what = 0);
    static const char* what() { return what_error; }
                                          // for getting error message
@@ -100,6 +119,8 @@ public:
 typedef BaseException Exception;        // for compatibility with my older libraries
 #endif
 
+#ifndef NO_TRACER
+
 inline Tracer::Tracer(const char* e)
    : entry(e), previous(last) { last = this; }
 
@@ -107,6 +128,16 @@ inline Tracer::~Tracer() { last = previous; }
 
 inline void Tracer::ReName(const char* e) { entry=e; }
 
+#else                                    // Tracer compiled out
+
+inline Tracer::Tracer(const char*) {}
+
+inline Tracer::~Tracer() {}
+
+inline void Tracer::ReName(const char*) {}
+
+#endif
+
 #ifdef SimulateExceptions                // SimulateExceptions
 
 #include <setjmp.h>
@@ -359,42 +390,42 @@ public:                                                                    \
 class Logic_error : public BaseException
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    Logic_error(const char* a_what = 0);
 };
 
 class Runtime_error : public BaseException
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    Runtime_error(const char* a_what = 0);
 };
 
 class Domain_error : public Logic_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    Domain_error(const char* a_what = 0);
 };
 
 class Invalid_argument : public Logic_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    Invalid_argument(const char* a_what = 0);
 };
 
 class Length_error : public Logic_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    Length_error(const char* a_what = 0);
 };
 
 class Out_of_range : public Logic_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    Out_of_range(const char* a_what = 0);
 };
 
@@ -415,21 +446,21 @@ public:
 class Range_error : public Runtime_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    Range_error(const char* a_what = 0);
 };
 
 class Overflow_error : public Runtime_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    Overflow_error(const char* a_what = 0);
 };
 
 class Bad_alloc : public BaseException
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    Bad_alloc(const char* a_what = 0);
 };
 
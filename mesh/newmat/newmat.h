@@ -42,6 +42,45 @@ class MatrixInput;                              // defined later
 
 void MatrixErrorNoSpace(const void*);           ///< test for allocation fails
 
+// ************************** storage allocation ***************************/
+
+Real* newmat_real_new(int n);                   ///< storage for n Reals
+void newmat_real_delete(Real* p);               ///< free newmat_real_new storage
+void newmat_pool_release();                     ///< free this thread's cache
+
+/// Storage requests of the calling thread, see newmat_alloc_stats.
+struct NewmatAllocStats
+{
+   long requests;                               ///< blocks requested
+   long heap;                                   ///< of them, heap allocations
+   long pooled;                                 ///< served from the free lists
+   long arena;                                  ///< served from an arena
+};
+
+void newmat_alloc_stats(NewmatAllocStats& stats);
+void newmat_reset_alloc_stats();
+
+/// Scoped arena for matrix storage.
+/// While the object is alive, matrices and row/column buffers created by
+/// the thread take their storage from large chunks, and releasing it costs
+/// nothing; reset() recycles all the chunks at once, e.g. once per frame.
+/// Storage still in use at reset (a result kept beyond the scope) stays
+/// valid, its chunk is freed with the last block in it.
+/// Arenas nest; they must be destroyed in reverse order by the same thread.
+class NewmatArena
+{
+   void* chunks;
+   NewmatArena* previous;
+   Real* allocate(int n);
+   NewmatArena(const NewmatArena&);
+   void operator=(const NewmatArena&);
+public:
+   NewmatArena();
+   ~NewmatArena();
+   void reset();                                ///< drop all storage
+   friend Real* newmat_real_new(int n);
+};
+
 /// Return from LogDeterminant function.
 /// Members are the log of the absolute value and the sign (+1, -1 or 0)
 class LogAndSign
@@ -297,6 +336,8 @@ protected:
 public:
    virtual GeneralMatrix* Evaluate(MatrixType mt=MatrixTypeUnSp) = 0;
 						// evaluate temporary
+   /// the operand of A.t(), 0 for other expressions (used by products)
+   virtual const BaseMatrix* transposed_base() const { return 0; }
    // for old version of G++
    //   virtual GeneralMatrix* Evaluate(MatrixType mt) = 0;
    //   GeneralMatrix* Evaluate() { return Evaluate(MatrixTypeUnSp); }
@@ -1690,6 +1731,7 @@ class TransposedMatrix : public NegatedMatrix
 public:
    ~TransposedMatrix() {}
    GeneralMatrix* Evaluate(MatrixType mt=MatrixTypeUnSp);
+   const BaseMatrix* transposed_base() const { return bm; }
    MatrixBandWidth bandwidth() const;
    NEW_DELETE(TransposedMatrix)
 };
@@ -1954,7 +1996,7 @@ public:
 class NPDException : public Runtime_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    NPDException(const GeneralMatrix&);
 };
 
@@ -1962,7 +2004,7 @@ public:
 class ConvergenceException : public Runtime_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    ConvergenceException(const GeneralMatrix& A);
    ConvergenceException(const char* c);
 };
@@ -1971,7 +2013,7 @@ public:
 class SingularException : public Runtime_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    SingularException(const GeneralMatrix& A);
 };
 
@@ -1979,7 +2021,7 @@ public:
 class OverflowException : public Runtime_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    OverflowException(const char* c);
 };
 
@@ -1989,7 +2031,7 @@ class ProgramException : public Logic_error
 protected:
    ProgramException();
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    ProgramException(const char* c);
    ProgramException(const char* c, const GeneralMatrix&);
    ProgramException(const char* c, const GeneralMatrix&, const GeneralMatrix&);
@@ -2000,7 +2042,7 @@ public:
 class IndexException : public Logic_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    IndexException(int i, const GeneralMatrix& A);
    IndexException(int i, int j, const GeneralMatrix& A);
    // next two are for access via element function
@@ -2012,7 +2054,7 @@ public:
 class VectorException : public Logic_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    VectorException();
    VectorException(const GeneralMatrix& A);
 };
@@ -2021,7 +2063,7 @@ public:
 class NotSquareException : public Logic_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    NotSquareException(const GeneralMatrix& A);
    NotSquareException();
 };
@@ -2030,7 +2072,7 @@ public:
 class SubMatrixDimensionException : public Logic_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    SubMatrixDimensionException();
 };
 
@@ -2038,7 +2080,7 @@ public:
 class IncompatibleDimensionsException : public Logic_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    IncompatibleDimensionsException();
    IncompatibleDimensionsException(const GeneralMatrix&);
    IncompatibleDimensionsException(const GeneralMatrix&, const GeneralMatrix&);
@@ -2048,7 +2090,7 @@ public:
 class NotDefinedException : public Logic_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    NotDefinedException(const char* op, const char* matrix);
 };
 
@@ -2056,7 +2098,7 @@ public:
 class CannotBuildException : public Logic_error
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    CannotBuildException(const char* matrix);
 };
 
@@ -2065,7 +2107,7 @@ public:
 class InternalException : public Logic_error
 {
 public:
-   static unsigned long Select;          // for identifying exception
+   static RBD_THREAD_LOCAL unsigned long Select; // for identifying exception
    InternalException(const char* c);
 };
 
@@ -132,7 +132,7 @@ void Matrix::GetCol(MatrixRowCol& mrc)
       if ( !(mrc.cw*(HaveStore+StoreHere)) )
       {
          REPORT
-         ColCopy = new Real [nrows_val]; MatrixErrorNoSpace(ColCopy);
+         ColCopy = newmat_real_new(nrows_val); MatrixErrorNoSpace(ColCopy);
          MONITOR_REAL_NEW("Make (MatGetCol)",nrows_val,ColCopy)
          mrc.data = ColCopy; mrc.cw += HaveStore;
       }
@@ -290,7 +290,7 @@ void UpperTriangularMatrix::GetCol(MatrixRowCol& mrc)
    if ( !(mrc.cw*(StoreHere+HaveStore)) )
    {
       REPORT                                              // not accessed
-      ColCopy = new Real [nrows_val]; MatrixErrorNoSpace(ColCopy);
+      ColCopy = newmat_real_new(nrows_val); MatrixErrorNoSpace(ColCopy);
       MONITOR_REAL_NEW("Make (UT GetCol)",nrows_val,ColCopy)
       mrc.data = ColCopy; mrc.cw += HaveStore;
    }
@@ -353,7 +353,7 @@ void LowerTriangularMatrix::GetCol(MatrixRowCol& mrc)
    else
    {
       REPORT                                            // not accessed
-      ColCopy = new Real [nrows_val]; MatrixErrorNoSpace(ColCopy);
+      ColCopy = newmat_real_new(nrows_val); MatrixErrorNoSpace(ColCopy);
       MONITOR_REAL_NEW("Make (LT GetCol)",nrows_val,ColCopy)
       mrc.cw += HaveStore; mrc.data = ColCopy;
    }
@@ -414,7 +414,7 @@ void SymmetricMatrix::GetRow(MatrixRowCol& mrc)
       if (!(mrc.cw*HaveStore))
       {
          REPORT
-         RowCopy = new Real [ncols_val]; MatrixErrorNoSpace(RowCopy);
+         RowCopy = newmat_real_new(ncols_val); MatrixErrorNoSpace(RowCopy);
          MONITOR_REAL_NEW("Make (SymGetRow)",ncols_val,RowCopy)
          mrc.cw += HaveStore; mrc.data = RowCopy;
       }
@@ -454,7 +454,7 @@ void SymmetricMatrix::GetCol(MatrixRowCol& mrc)
       else
       {
          REPORT                                      // not accessed
-         ColCopy = new Real [ncols_val]; MatrixErrorNoSpace(ColCopy);
+         ColCopy = newmat_real_new(ncols_val); MatrixErrorNoSpace(ColCopy);
          MONITOR_REAL_NEW("Make (SymGetCol)",ncols_val,ColCopy)
          mrc.cw += HaveStore; mrc.data = ColCopy;
       }
@@ -603,7 +603,7 @@ void BandMatrix::GetCol(MatrixRowCol& mrc)
    else
    {
       REPORT
-      ColCopy = new Real [n+1]; MatrixErrorNoSpace(ColCopy);
+      ColCopy = newmat_real_new(n+1); MatrixErrorNoSpace(ColCopy);
       MONITOR_REAL_NEW("Make (BMGetCol)",n+1,ColCopy)
       mrc.cw += HaveStore; mrc.data = ColCopy;
    }
@@ -671,7 +671,7 @@ void SymmetricBandMatrix::GetRow(MatrixRowCol& mrc)
       if (!(mrc.cw*HaveStore))
       {
          REPORT
-         RowCopy = new Real [2*lower_val+1]; MatrixErrorNoSpace(RowCopy);
+         RowCopy = newmat_real_new(2*lower_val+1); MatrixErrorNoSpace(RowCopy);
          MONITOR_REAL_NEW("Make (SmBGetRow)",2*lower_val+1,RowCopy)
          mrc.cw += HaveStore; mrc.data = RowCopy;
       }
@@ -713,7 +713,7 @@ void SymmetricBandMatrix::GetCol(MatrixRowCol& mrc)
       if ( +(mrc.cw*HaveStore) ) { REPORT ColCopy = mrc.data; }
       else
       {
-         REPORT ColCopy = new Real [2*lower_val+1]; MatrixErrorNoSpace(ColCopy);
+         REPORT ColCopy = newmat_real_new(2*lower_val+1); MatrixErrorNoSpace(ColCopy);
          MONITOR_REAL_NEW("Make (SmBGetCol)",2*lower_val+1,ColCopy)
          mrc.cw += HaveStore; mrc.data = ColCopy;
       }
@@ -832,7 +832,7 @@ MatrixRowCol::~MatrixRowCol()
    if (+(cw*HaveStore))
    {
       MONITOR_REAL_DELETE("Free    (RowCol)",-1,data)  // do not know length
-      delete [] data;
+      newmat_real_delete(data);
    }
 }
 
@@ -46,7 +46,7 @@ GeneralMatrix::GeneralMatrix(ArrayLengthSpecifier s)
    storage=s.Value(); tag_val=-1;
    if (storage)
    {
-      store = new Real [storage]; MatrixErrorNoSpace(store);
+      store = newmat_real_new(storage); MatrixErrorNoSpace(store);
       MONITOR_REAL_NEW("Make (GenMatrix)",storage,store)
    }
    else store = 0;
@@ -170,7 +170,7 @@ GeneralMatrix::~GeneralMatrix()
    if (store)
    {
       MONITOR_REAL_DELETE("Free (GenMatrix)",storage,store)
-      delete [] store;
+      newmat_real_delete(store);
    }
 }
 
@@ -275,12 +275,12 @@ void GeneralMatrix::resize(int nr, int nc, int s)
    if (store)
    {
       MONITOR_REAL_DELETE("Free (ReDimensi)",storage,store)
-      delete [] store;
+      newmat_real_delete(store);
    }
    storage=s; nrows_val=nr; ncols_val=nc; tag_val=-1;
    if (s)
    {
-      store = new Real [storage]; MatrixErrorNoSpace(store);
+      store = newmat_real_new(storage); MatrixErrorNoSpace(store);
       MONITOR_REAL_NEW("Make (ReDimensi)",storage,store)
    }
    else store = 0;
@@ -795,7 +795,7 @@ void GeneralMatrix::tDelete()
       if (store)
       {
          REPORT  MONITOR_REAL_DELETE("Free   (tDelete)",storage,store)
-         delete [] store;
+         newmat_real_delete(store);
       }
       MiniCleanUp(); return;                           // CleanUp
    }
@@ -823,7 +823,7 @@ bool GeneralMatrix::reuse()
       if (storage)
       {
          REPORT
-         Real* s = new Real [storage]; MatrixErrorNoSpace(s);
+         Real* s = newmat_real_new(storage); MatrixErrorNoSpace(s);
          MONITOR_REAL_NEW("Make     (reuse)",storage,s)
          newmat_block_copy(storage, store, s); store = s;
       }
@@ -842,7 +842,7 @@ Real* GeneralMatrix::GetStore()
       Real* s;
       if (storage)
       {
-         s = new Real [storage]; MatrixErrorNoSpace(s);
+         s = newmat_real_new(storage); MatrixErrorNoSpace(s);
          MONITOR_REAL_NEW("Make  (GetStore)",storage,s)
          newmat_block_copy(storage, store, s);
       }
@@ -899,7 +899,7 @@ void GeneralMatrix::Eq(const BaseMatrix& X, MatrixType mt)
       if (store)
       {
          MONITOR_REAL_DELETE("Free (operator=)",storage,store)
-         REPORT delete [] store; storage = 0; store = 0;
+         REPORT newmat_real_delete(store); storage = 0; store = 0;
       }
    }
    else { REPORT Release(counter); }
@@ -915,7 +915,7 @@ void GeneralMatrix::Eq(const BaseMatrix& X, MatrixType mt)
       if (store)
       {
          MONITOR_REAL_DELETE("Free (operator=)",storage,store)
-         REPORT delete [] store; storage = 0; store = 0;
+         REPORT newmat_real_delete(store); storage = 0; store = 0;
       }
       GetMatrix(gmx);
    }
@@ -934,7 +934,7 @@ void GeneralMatrix::Eq(const GeneralMatrix& X)
       if (store)
       {
          MONITOR_REAL_DELETE("Free (operator=)",storage,store)
-         REPORT delete [] store; storage = 0; store = 0;
+         REPORT newmat_real_delete(store); storage = 0; store = 0;
       }
       GetMatrix(gmx);
    }
@@ -1108,7 +1108,7 @@ void GeneralMatrix::cleanup()
    if (store && storage)
    {
       MONITOR_REAL_DELETE("Free (cleanup)    ",storage,store)
-      REPORT delete [] store;
+      REPORT newmat_real_delete(store);
    }
    store=0; storage=0; nrows_val=0; ncols_val=0; tag_val = -1;
 }
@@ -11,6 +11,11 @@
 #include "newmat.h"
 #include "newmatrc.h"
 
+#if defined(USING_DOUBLE) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+#define NM_SSE2
+#include <emmintrin.h>
+#endif
+
 #ifdef use_namespace
 namespace NEWMAT {
 #endif
@@ -101,12 +106,26 @@ static GeneralMatrix*
 static GeneralMatrix*
    GeneralKP(GeneralMatrix*,GeneralMatrix*,KPMatrix*,MatrixType);
 
+static GeneralMatrix* mmTMult(GeneralMatrix* gm1, GeneralMatrix* gm2);
+
 GeneralMatrix* MultipliedMatrix::Evaluate(MatrixType mt)
 {
    REPORT
    gm2 = ((BaseMatrix*&)bm2)->Evaluate();
    gm2 = gm2->Evaluate(gm2->type().MultRHS());     // no symmetric on RHS
-   gm1 = ((BaseMatrix*&)bm1)->Evaluate();
+   const BaseMatrix* bt = bm1->transposed_base();
+   if (bt)
+   {
+      // A.t() * B: multiply by A directly rather than forming its transpose
+      TransposedMatrix* tm = (TransposedMatrix*)bm1;
+      GeneralMatrix* gmt = ((BaseMatrix*)bt)->Evaluate();
+      if (Rectangular(gmt->type(), gm2->type(), mt))
+         { REPORT gm1 = gmt; return mmTMult(gm1, gm2); }
+      REPORT
+      MatrixType mtt = MatrixTypeUnSp; Compare(gmt->type().t(), mtt);
+      gm1 = gmt->Transpose(tm, mtt);
+   }
+   else { REPORT gm1 = ((BaseMatrix*&)bm1)->Evaluate(); }
    return GeneralMult(gm1, gm2, this, mt);
 }
 
@@ -347,6 +366,133 @@ static GeneralMatrix* GeneralMult2(GeneralMatrix* gm1, GeneralMatrix* gm2,
    gmx->ReleaseAndDelete(); gm1->tDelete(); gm2->tDelete(); return gmx;
 }
 
+// Kernels for products of rectangular matrices stored by rows.
+// The right hand factor is processed in blocks of NM_BLOCK_K rows by
+// NM_BLOCK_J columns (128 KB), small enough to stay in cache while every row
+// of the left hand factor goes through it; each pass over a row of the
+// product accumulates four rows of the block.
+
+#define NM_BLOCK_K 64
+#define NM_BLOCK_J 256
+
+// c[j] += a0 * b0[j] + a1 * b1[j] + a2 * b2[j] + a3 * b3[j], j < n
+static void axpy4(int n, Real* c, Real a0, const Real* b0, Real a1,
+   const Real* b1, Real a2, const Real* b2, Real a3, const Real* b3)
+{
+   int j = 0;
+#ifdef NM_SSE2
+   __m128d x0 = _mm_set1_pd(a0); __m128d x1 = _mm_set1_pd(a1);
+   __m128d x2 = _mm_set1_pd(a2); __m128d x3 = _mm_set1_pd(a3);
+   for (; j + 2 <= n; j += 2)
+   {
+      __m128d s0 = _mm_add_pd(_mm_mul_pd(x0, _mm_loadu_pd(b0 + j)),
+         _mm_mul_pd(x1, _mm_loadu_pd(b1 + j)));
+      __m128d s1 = _mm_add_pd(_mm_mul_pd(x2, _mm_loadu_pd(b2 + j)),
+         _mm_mul_pd(x3, _mm_loadu_pd(b3 + j)));
+      _mm_storeu_pd(c + j,
+         _mm_add_pd(_mm_loadu_pd(c + j), _mm_add_pd(s0, s1)));
+   }
+#endif
+   for (; j < n; ++j)
+      c[j] += (a0 * b0[j] + a1 * b1[j]) + (a2 * b2[j] + a3 * b3[j]);
+}
+
+// c[j] += a * b[j], j < n
+static void axpy1(int n, Real* c, Real a, const Real* b)
+{
+   int j = 0;
+#ifdef NM_SSE2
+   __m128d x = _mm_set1_pd(a);
+   for (; j + 2 <= n; j += 2)
+      _mm_storeu_pd(c + j,
+         _mm_add_pd(_mm_loadu_pd(c + j), _mm_mul_pd(x, _mm_loadu_pd(b + j))));
+#endif
+   for (; j < n; ++j) c[j] += a * b[j];
+}
+
+// sum of a[k] * b[k], k < n
+static Real dot(int n, const Real* a, const Real* b)
+{
+   int k = 0; Real sum = 0.0;
+#ifdef NM_SSE2
+   __m128d s0 = _mm_setzero_pd(); __m128d s1 = _mm_setzero_pd();
+   for (; k + 4 <= n; k += 4)
+   {
+      s0 = _mm_add_pd(s0, _mm_mul_pd(_mm_loadu_pd(a + k), _mm_loadu_pd(b + k)));
+      s1 = _mm_add_pd(s1,
+         _mm_mul_pd(_mm_loadu_pd(a + k + 2), _mm_loadu_pd(b + k + 2)));
+   }
+   s0 = _mm_add_pd(s0, s1);
+   Real t[2]; _mm_storeu_pd(t, s0); sum = t[0] + t[1];
+#endif
+   for (; k < n; ++k) sum += a[k] * b[k];
+   return sum;
+}
+
+// c (nr x nc) = a (nr x ncr) * b (ncr x nc)
+static void mm_kernel(int nr, int ncr, int nc, const Real* a, const Real* b,
+   Real* c)
+{
+   if (nc == 1)                                    // matrix times vector
+   {
+      REPORT
+      for (int i = 0; i < nr; ++i) c[i] = dot(ncr, a + i * ncr, b);
+      return;
+   }
+   REPORT
+   for (int i = 0; i < nr * nc; ++i) c[i] = 0.0;
+   for (int j0 = 0; j0 < nc; j0 += NM_BLOCK_J)
+   {
+      int nj = (nc - j0 < NM_BLOCK_J) ? nc - j0 : NM_BLOCK_J;
+      for (int k0 = 0; k0 < ncr; k0 += NM_BLOCK_K)
+      {
+         int nk = (ncr - k0 < NM_BLOCK_K) ? ncr - k0 : NM_BLOCK_K;
+         for (int i = 0; i < nr; ++i)
+         {
+            const Real* ai = a + i * ncr + k0; Real* ci = c + i * nc + j0;
+            const Real* bk = b + k0 * nc + j0; int k = 0;
+            for (; k + 4 <= nk; k += 4, bk += 4 * nc)
+               axpy4(nj, ci, ai[k], bk, ai[k+1], bk + nc,
+                  ai[k+2], bk + 2 * nc, ai[k+3], bk + 3 * nc);
+            for (; k < nk; ++k, bk += nc) axpy1(nj, ci, ai[k], bk);
+         }
+      }
+   }
+}
+
+// c (p x q) = a.t() * b, a is m x p, b is m x q.
+// if symmetric (a and b are the same matrix) only the upper triangle is
+// computed and then copied to the lower one.
+static void mtm_kernel(int m, int p, int q, const Real* a, const Real* b,
+   Real* c, bool symmetric)
+{
+   REPORT
+   for (int i = 0; i < p * q; ++i) c[i] = 0.0;
+   for (int j0 = 0; j0 < q; j0 += NM_BLOCK_J)
+   {
+      int j1 = (q - j0 < NM_BLOCK_J) ? q : j0 + NM_BLOCK_J;
+      for (int r0 = 0; r0 < m; r0 += NM_BLOCK_K)
+      {
+         int r1 = (m - r0 < NM_BLOCK_K) ? m : r0 + NM_BLOCK_K;
+         for (int i = 0; i < p; ++i)
+         {
+            int js = (symmetric && i > j0) ? i : j0;
+            if (js >= j1) continue;
+            int nj = j1 - js; Real* ci = c + i * q + js;
+            const Real* ar = a + r0 * p + i; const Real* br = b + r0 * q + js;
+            int r = r0;
+            for (; r + 4 <= r1; r += 4, ar += 4 * p, br += 4 * q)
+               axpy4(nj, ci, ar[0], br, ar[p], br + q,
+                  ar[2 * p], br + 2 * q, ar[3 * p], br + 3 * q);
+            for (; r < r1; ++r, ar += p, br += q) axpy1(nj, ci, *ar, br);
+         }
+      }
+   }
+   if (symmetric)
+      for (int i = 1; i < p; ++i)
+         for (int j = 0; j < i; ++j) c[i * q + j] = c[j * q + i];
+}
+
 static GeneralMatrix* mmMult(GeneralMatrix* gm1, GeneralMatrix* gm2)
 {
    // matrix multiplication for type Matrix only
@@ -358,20 +504,26 @@ static GeneralMatrix* mmMult(GeneralMatrix* gm1, GeneralMatrix* gm2)
 
    Matrix* gm = new Matrix(nr,nc); MatrixErrorNoSpace(gm);
 
-   Real* s1=gm1->Store(); Real* s2=gm2->Store(); Real* s=gm->Store();
+   if (ncr) mm_kernel(nr, ncr, nc, gm1->Store(), gm2->Store(), gm->Store());
+   else *gm = 0.0;
 
-   if (ncr)
-   {
-      while (nr--)
-      {
-         Real* s2x = s2; int j = ncr;
-         Real* sx = s; Real f = *s1++; int k = nc;
-         while (k--) *sx++ = f * *s2x++;
-         while (--j)
-            { sx = s; f = *s1++; k = nc; while (k--) *sx++ += f * *s2x++; }
-         s = sx;
-      }
-   }
+   gm->ReleaseAndDelete(); gm1->tDelete(); gm2->tDelete(); return gm;
+}
+
+static GeneralMatrix* mmTMult(GeneralMatrix* gm1, GeneralMatrix* gm2)
+{
+   // gm1.t() * gm2 for type Matrix only
+   REPORT
+   Tracer tr("MatrixTMult");
+
+   int m=gm1->Nrows(); int p=gm1->Ncols(); int q=gm2->Ncols();
+   if (m != gm2->Nrows()) Throw(IncompatibleDimensionsException(*gm1,*gm2));
+
+   Matrix* gm = new Matrix(p,q); MatrixErrorNoSpace(gm);
+
+   if (m)
+      mtm_kernel(m, p, q, gm1->Store(), gm2->Store(), gm->Store(),
+         gm1->Store() == gm2->Store() && p == q);
    else *gm = 0.0;
 
    gm->ReleaseAndDelete(); gm1->tDelete(); gm2->tDelete(); return gm;
@@ -421,7 +573,7 @@ static GeneralMatrix* GeneralSolv(GeneralMatrix* gm1, GeneralMatrix* gm2,
    if (gm1->Ncols() != gm2->Nrows())
       Throw(IncompatibleDimensionsException(*gm1, *gm2));
    GeneralMatrix* gmx = mtx.New(nr,nc,sm); MatrixErrorNoSpace(gmx);
-   Real* r = new Real [nr]; MatrixErrorNoSpace(r);
+   Real* r = newmat_real_new(nr); MatrixErrorNoSpace(r);
    MONITOR_REAL_NEW("Make   (GenSolv)",nr,r)
    GeneralMatrix* gms = gm1->MakeSolver();
    Try
@@ -439,13 +591,13 @@ static GeneralMatrix* GeneralSolv(GeneralMatrix* gm1, GeneralMatrix* gm2,
       gm2->tDelete();
       MONITOR_REAL_DELETE("Delete (GenSolv)",nr,r)
                           // AT&T version 2.1 gives an internal error
-      delete [] r;
+      newmat_real_delete(r);
       ReThrow;
    }
    gms->tDelete(); gmx->ReleaseAndDelete(); gm2->tDelete();
    MONITOR_REAL_DELETE("Delete (GenSolv)",nr,r)
                           // AT&T version 2.1 gives an internal error
-   delete [] r;
+   newmat_real_delete(r);
    return gmx;
 }
 
@@ -462,7 +614,7 @@ static GeneralMatrix* GeneralSolvI(GeneralMatrix* gm1, BaseMatrix* sm,
    // DiagonalMatrix I(nr); I = 1;
    IdentityMatrix I(nr);
    GeneralMatrix* gmx = mtx.New(nr,nc,sm); MatrixErrorNoSpace(gmx);
-   Real* r = new Real [nr]; MatrixErrorNoSpace(r);
+   Real* r = newmat_real_new(nr); MatrixErrorNoSpace(r);
    MONITOR_REAL_NEW("Make   (GenSolvI)",nr,r)
    GeneralMatrix* gms = gm1->MakeSolver();
    Try
@@ -479,13 +631,13 @@ static GeneralMatrix* GeneralSolvI(GeneralMatrix* gm1, BaseMatrix* sm,
       delete gmx;
       MONITOR_REAL_DELETE("Delete (GenSolvI)",nr,r)
                           // AT&T version 2.1 gives an internal error
-      delete [] r;
+      newmat_real_delete(r);
       ReThrow;
    }
    gms->tDelete(); gmx->ReleaseAndDelete();
    MONITOR_REAL_DELETE("Delete (GenSolvI)",nr,r)
                           // AT&T version 2.1 gives an internal error
-   delete [] r;
+   newmat_real_delete(r);
    return gmx;
 }
 
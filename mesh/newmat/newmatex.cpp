@@ -12,19 +12,19 @@
 namespace NEWMAT {
 #endif
 
-unsigned long OverflowException::Select;
-unsigned long SingularException::Select;
-unsigned long NPDException::Select;
-unsigned long ConvergenceException::Select;
-unsigned long ProgramException::Select;
-unsigned long IndexException::Select;
-unsigned long VectorException::Select;
-unsigned long NotSquareException::Select;
-unsigned long SubMatrixDimensionException::Select;
-unsigned long IncompatibleDimensionsException::Select;
-unsigned long NotDefinedException::Select;
-unsigned long CannotBuildException::Select;
-unsigned long InternalException::Select;
+RBD_THREAD_LOCAL unsigned long OverflowException::Select;
+RBD_THREAD_LOCAL unsigned long SingularException::Select;
+RBD_THREAD_LOCAL unsigned long NPDException::Select;
+RBD_THREAD_LOCAL unsigned long ConvergenceException::Select;
+RBD_THREAD_LOCAL unsigned long ProgramException::Select;
+RBD_THREAD_LOCAL unsigned long IndexException::Select;
+RBD_THREAD_LOCAL unsigned long VectorException::Select;
+RBD_THREAD_LOCAL unsigned long NotSquareException::Select;
+RBD_THREAD_LOCAL unsigned long SubMatrixDimensionException::Select;
+RBD_THREAD_LOCAL unsigned long IncompatibleDimensionsException::Select;
+RBD_THREAD_LOCAL unsigned long NotDefinedException::Select;
+RBD_THREAD_LOCAL unsigned long CannotBuildException::Select;
+RBD_THREAD_LOCAL unsigned long InternalException::Select;
 
 
 
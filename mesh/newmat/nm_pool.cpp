@@ -0,0 +1,264 @@
+/// \ingroup newmat
+///@{
+
+/// \file nm_pool.cpp
+/// Storage allocator for matrices and row/column buffers.
+///
+/// Small and medium blocks are rounded up to a power of two and recycled
+/// through per-thread free lists, so expression temporaries of the same shape
+/// reuse each other's storage instead of going back to the heap. While a
+/// NewmatArena is active on a thread its requests are carved out of large
+/// chunks instead, and are all dropped at once when the arena is reset.
+/// Every block is preceded by a header telling where it came from, so blocks
+/// may be freed after the arena that made them is gone, or by another thread:
+/// arena chunks are reference counted atomically, by their live blocks and by
+/// the arena while it holds them. The free lists of all threads together keep at
+/// most NM_POOL_MAX_CACHED_REALS, as the lists of a finished thread are only
+/// released by newmat_pool_release() on that thread.
+
+#include <stdlib.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "include.h"
+
+#include "newmat.h"
+
+#ifdef use_namespace
+namespace NEWMAT {
+#endif
+
+
+#ifdef DO_REPORT
+#define REPORT { static ExeCounter ExeCount(__LINE__,22); ++ExeCount; }
+#else
+#define REPORT {}
+#endif
+
+// size classes 4, 8, 16, ..., 4096 Reals; larger blocks go to the heap
+#define NM_POOL_MIN_SHIFT 2
+#define NM_POOL_CLASSES 11
+// free blocks kept per size class and thread
+#define NM_POOL_MAX_CACHED 64
+// Reals kept in the free lists of all threads together
+#define NM_POOL_MAX_CACHED_REALS (1L << 22)
+// Reals per arena chunk (blocks that do not fit get a chunk of their own)
+#define NM_ARENA_CHUNK 65536
+
+#define NM_BLOCK_HEAP -1
+#define NM_BLOCK_ARENA -2
+
+// adds v to *p atomically, returns the new value
+#ifdef _MSC_VER
+static long atomic_add(volatile long* p, long v)
+   { return _InterlockedExchangeAdd(p, v) + v; }
+#else
+static long atomic_add(volatile long* p, long v)
+   { return __sync_add_and_fetch(p, v); }
+#endif
+
+struct ArenaChunk
+{
+   ArenaChunk* next;
+   int capacity;                    // in Reals, after the chunk header
+   int used;
+   volatile long refs;              // live blocks, plus 1 while the arena holds it
+};
+
+// kept two Reals long so the storage after it is aligned like a Real array
+union BlockHeader
+{
+   Real align[2];
+   struct { int size_class; ArenaChunk* chunk; } h;
+};
+
+struct FreeBlock { FreeBlock* next; };
+
+static RBD_THREAD_LOCAL FreeBlock* free_list[NM_POOL_CLASSES];
+static RBD_THREAD_LOCAL int free_count[NM_POOL_CLASSES];
+static RBD_THREAD_LOCAL NewmatArena* current_arena;
+static RBD_THREAD_LOCAL NewmatAllocStats alloc_stats;
+static volatile long cached_reals;  // in the free lists of all threads
+
+static const int header_reals = (int)(sizeof(BlockHeader) / sizeof(Real));
+
+// the chunk header is padded to a whole number of block headers
+static const size_t chunk_header_bytes = sizeof(BlockHeader)
+   * ((sizeof(ArenaChunk) + sizeof(BlockHeader) - 1) / sizeof(BlockHeader));
+
+static Real* chunk_data(ArenaChunk* c)
+   { return (Real*)((char*)c + chunk_header_bytes); }
+
+static ArenaChunk* new_chunk(int capacity)
+{
+   REPORT
+   ArenaChunk* c = (ArenaChunk*)malloc(
+      chunk_header_bytes + (size_t)capacity * sizeof(Real));
+   if (!c) return 0;
+   c->next = 0; c->capacity = capacity; c->used = 0; c->refs = 1;
+   return c;
+}
+
+static int size_class(int n)
+{
+   int c = 0; int s = 1 << NM_POOL_MIN_SHIFT;
+   while (s < n) { s <<= 1; ++c; }
+   return c;
+}
+
+static long class_reals(int c) { return 1L << (c + NM_POOL_MIN_SHIFT); }
+
+Real* newmat_real_new(int n)
+{
+   ++alloc_stats.requests;
+   if (current_arena) { REPORT return current_arena->allocate(n); }
+   BlockHeader* b;
+   int c = size_class(n);
+   if (c < NM_POOL_CLASSES)
+   {
+      if (free_list[c])
+      {
+         REPORT
+         b = (BlockHeader*)free_list[c]; free_list[c] = free_list[c]->next;
+         --free_count[c]; ++alloc_stats.pooled;
+         atomic_add(&cached_reals, -class_reals(c));
+      }
+      else
+      {
+         REPORT
+         b = (BlockHeader*)malloc(sizeof(BlockHeader)
+            + (size_t)class_reals(c) * sizeof(Real));
+         if (!b) return 0;
+         ++alloc_stats.heap;
+      }
+   }
+   else
+   {
+      REPORT
+      c = NM_BLOCK_HEAP;
+      b = (BlockHeader*)malloc(sizeof(BlockHeader) + (size_t)n * sizeof(Real));
+      if (!b) return 0;
+      ++alloc_stats.heap;
+   }
+   b->h.size_class = c; b->h.chunk = 0;
+   return (Real*)(b + 1);
+}
+
+void newmat_real_delete(Real* p)
+{
+   if (!p) return;
+   BlockHeader* b = (BlockHeader*)p - 1;
+   int c = b->h.size_class;
+   if (c == NM_BLOCK_ARENA)
+   {
+      REPORT
+      // the last reference is that of the last block of a reset chunk
+      ArenaChunk* chunk = b->h.chunk;
+      if (atomic_add(&chunk->refs, -1) == 0) free(chunk);
+   }
+   else if (c == NM_BLOCK_HEAP || free_count[c] >= NM_POOL_MAX_CACHED)
+      { REPORT free(b); }
+   else if (atomic_add(&cached_reals, class_reals(c))
+      > NM_POOL_MAX_CACHED_REALS)
+   {
+      REPORT
+      atomic_add(&cached_reals, -class_reals(c)); free(b);
+   }
+   else
+   {
+      REPORT
+      FreeBlock* f = (FreeBlock*)b; f->next = free_list[c]; free_list[c] = f;
+      ++free_count[c];
+   }
+}
+
+void newmat_pool_release()
+{
+   REPORT
+   for (int c = 0; c < NM_POOL_CLASSES; ++c)
+   {
+      while (free_list[c])
+         { FreeBlock* f = free_list[c]; free_list[c] = f->next; free(f); }
+      atomic_add(&cached_reals, -free_count[c] * class_reals(c));
+      free_count[c] = 0;
+   }
+}
+
+void newmat_alloc_stats(NewmatAllocStats& stats) { stats = alloc_stats; }
+
+void newmat_reset_alloc_stats()
+{
+   alloc_stats.requests = 0; alloc_stats.heap = 0;
+   alloc_stats.pooled = 0; alloc_stats.arena = 0;
+}
+
+// ***************************** NewmatArena *******************************/
+
+NewmatArena::NewmatArena() : chunks(0), previous(current_arena)
+   { REPORT current_arena = this; }
+
+NewmatArena::~NewmatArena()
+{
+   REPORT
+   reset();
+   ArenaChunk* c = (ArenaChunk*)chunks;
+   while (c) { ArenaChunk* n = c->next; free(c); c = n; }
+   current_arena = previous;
+}
+
+Real* NewmatArena::allocate(int n)
+{
+   int need = n + header_reals;
+   if (need & 1) ++need;                            // keep headers aligned
+   ArenaChunk* c = (ArenaChunk*)chunks;
+   if (!c || c->capacity - c->used < need)
+   {
+      // first look for a recycled chunk with room, then make a new one
+      ArenaChunk* prev = 0; ArenaChunk* f = c;
+      while (f && f->capacity - f->used < need) { prev = f; f = f->next; }
+      if (f)
+      {
+         REPORT
+         prev->next = f->next; f->next = c; c = f;
+      }
+      else
+      {
+         REPORT
+         c = new_chunk(need > NM_ARENA_CHUNK ? need : NM_ARENA_CHUNK);
+         if (!c) return 0;
+         c->next = (ArenaChunk*)chunks;
+         ++alloc_stats.heap;
+      }
+      chunks = c;
+   }
+   BlockHeader* b = (BlockHeader*)(chunk_data(c) + c->used);
+   c->used += need; atomic_add(&c->refs, 1);
+   b->h.size_class = NM_BLOCK_ARENA; b->h.chunk = c;
+   ++alloc_stats.arena;
+   return (Real*)(b + 1);
+}
+
+void NewmatArena::reset()
+{
+   // the arena drops its reference; chunks still holding live blocks then
+   // belong to their blocks, and the last one freed frees the chunk
+   ArenaChunk* c = (ArenaChunk*)chunks; ArenaChunk* keep = 0;
+   while (c)
+   {
+      ArenaChunk* n = c->next;
+      if (atomic_add(&c->refs, -1) == 0)
+         { REPORT c->refs = 1; c->used = 0; c->next = keep; keep = c; }
+      else { REPORT }
+      c = n;
+   }
+   chunks = keep;
+}
+
+
+#ifdef use_namespace
+}
+#endif
+
+
+///@}
@@ -34,7 +34,7 @@ R1_R1::operator Real()
    return y;
 }
 
-unsigned long SolutionException::Select;
+RBD_THREAD_LOCAL unsigned long SolutionException::Select;
 
 SolutionException::SolutionException(const char* a_what) : BaseException()
 {
@@ -48,7 +48,7 @@ public:
 class SolutionException : public BaseException
 {
 public:
-   static unsigned long Select;
+   static RBD_THREAD_LOCAL unsigned long Select;
    SolutionException(const char* a_what = 0);
 };
 
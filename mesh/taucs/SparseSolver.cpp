@@ -1,9 +1,22 @@
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
 #include "SparseSolver.h"
 
 extern "C" {
-    void chol_update(void *vF, int index, double val,void**vetree);
+    int chol_updown(void *vF, int count, const int *index, const double *val, int update, void **vetree);
+    int cholesky_analysis(taucs_ccs_matrix *A, int *perm, int *invperm,
+                          double *nnzL, double *flops, double *maxColCount);
+    int factor_statistics(void *vF, double *nnzL, double *bytes);
 }
 
+// convergence of the iterative solver used when a factor does not fit the budget
+static const double kIterativeTolerance = 1e-8;
+static const int kIterativeMaxIterations = 10000;
+
 // Will create A^T A and its factorization, as well as store A^T
 // returns true on success, false otherwise
 bool SparseSolver::FactorATA() {
@@ -14,6 +27,10 @@ bool SparseSolver::FactorATA() {
 	if (m_ATA == NULL)
 		CreateATA();
 
+	// the factor may not fit the memory budget
+	if (!AdmitFactor())
+		return m_outOfCore? FactorOutOfCore(m_ATA) : m_iterative;
+
 	// factorization
 	int	rc = taucs_linsolve(m_ATA, &m_factorATA,0,NULL,NULL,SIVANfactor,SIVANopt_arg);
 	if (rc != TAUCS_SUCCESS) 
@@ -106,6 +123,10 @@ bool SparseSolver::FactorA() {
 	if (m_A == NULL)
 		CreateA();
 
+	// the Cholesky factor may not fit the memory budget
+	if (m_SPD && !AdmitFactor())
+		return m_outOfCore? FactorOutOfCore(m_A) : m_iterative;
+
 	// factorization
 	int	rc;
 	if (m_SPD)
@@ -140,9 +161,7 @@ bool SparseSolver::SolveATA_UseFactor(void * factor,
 			m_ATb.resize(m_numCols*numRhs);
 
 		// multiply right-hand side
-		for (int i = 0; i < numRhs; ++i) {
-			MulMatrixVector(m_AT, b + i*m_numRows, (taucsType *)&(m_ATb.front()) + i*m_numCols);
-		}
+		MulTransposeMatrixVectors(m_A, b, (taucsType *)&(m_ATb.front()), numRhs);
 	}
 
 	//	 solve the system:
@@ -190,7 +209,7 @@ bool SparseSolver::SolveATA(const taucsType * b, taucsType * x, const int numRhs
 		return SolveA(b, x, numRhs);
 	}
 	else {
-		if (m_factorATA == NULL) {
+		if (!IsFactored(m_factorATA)) {
 			bool rc = FactorATA();
 			if (!rc)
 				return false;
@@ -202,39 +221,21 @@ bool SparseSolver::SolveATA(const taucsType * b, taucsType * x, const int numRhs
 		m_ATb.resize(m_numCols*numRhs);
 
 	// multiply right-hand side
-	for (int i = 0; i < numRhs; ++i) {
-		MulMatrixVector(m_AT, b + i*m_numRows, (taucsType *)&(m_ATb.front()) + i*m_numCols);
-	}
+	MulTransposeMatrixVectors(m_A, b, (taucsType *)&(m_ATb.front()), numRhs);
 
-	int rc;
 	// solve the system
-	rc = taucs_linsolve(m_ATA,
-						&m_factorATA,
-						numRhs,
-						x,
-						(taucsType *)&(m_ATb.front()),
-						SIVANsolve,
-						SIVANopt_arg);
-	return (rc == TAUCS_SUCCESS); 
+	return SolveFactored(m_ATA, &m_factorATA, numRhs, x, (taucsType *)&(m_ATb.front()));
 }
 
 // Same as SolveATA only that this solves the actual system Ax = b
 // It is assumed that A is rectangular and invertible
 bool SparseSolver::SolveA(const taucsType * b, taucsType * x, const int numRhs) {
-	if (m_factorA == NULL) 
+	if (!IsFactored(m_factorA)) 
 		if (!FactorA())
 			return false;
 
 	// solve the system
-	int	rc = taucs_linsolve(m_A,
-							&m_factorA,
-							numRhs,
-							x,
-							(void *)b,
-							SIVANsolve,
-							SIVANopt_arg);
-
-	return (rc == TAUCS_SUCCESS);
+	return SolveFactored(m_A, &m_factorA, numRhs, x, b);
 }
 
 // The version of SolveATA with 3 right-hand sides
@@ -242,7 +243,7 @@ bool SparseSolver::SolveA(const taucsType * b, taucsType * x, const int numRhs)
 bool SparseSolver::SolveATA3(const taucsType * bx, const taucsType * by, const taucsType * bz,
 							       taucsType * x,        taucsType * y,        taucsType * z) 
 {
-	if (m_factorATA == NULL) {
+	if (!IsFactored(m_factorATA)) {
 		bool rc = FactorATA();
 		if (!rc)
 			return false;
@@ -253,43 +254,25 @@ bool SparseSolver::SolveATA3(const taucsType * bx, const taucsType * by, const t
 		m_ATb.resize(m_numCols*3);
 
 	// multiply right-hand side
-	MulMatrixVector(m_AT, bx, (taucsType *)&(m_ATb.front()));
-	MulMatrixVector(m_AT, by, (taucsType *)&(m_ATb.front()) + m_numCols);
-	MulMatrixVector(m_AT, bz, (taucsType *)&(m_ATb.front()) + 2*m_numCols);
+	MulTransposeMatrixVectors(m_A, bx, (taucsType *)&(m_ATb.front()), 1);
+	MulTransposeMatrixVectors(m_A, by, (taucsType *)&(m_ATb.front()) + m_numCols, 1);
+	MulTransposeMatrixVectors(m_A, bz, (taucsType *)&(m_ATb.front()) + 2*m_numCols, 1);
 	
 
 	// solve the system
-	int	rc = taucs_linsolve(m_ATA,
-							&m_factorATA,
-							1,
-							x,
-							(taucsType *)&(m_ATb.front()),
-							SIVANsolve,
-							SIVANopt_arg);
-
-	if (rc != TAUCS_SUCCESS)
+	bool	rc = SolveFactored(m_ATA, &m_factorATA, 1, x, (taucsType *)&(m_ATb.front()));
+
+	if (!rc)
 		return false;
 
-	rc = taucs_linsolve(m_ATA,
-							&m_factorATA,
-							1,
-							y,
-							(taucsType *)&(m_ATb.front()) + m_numCols,
-							SIVANsolve,
-							SIVANopt_arg);
+	rc = SolveFactored(m_ATA, &m_factorATA, 1, y, (taucsType *)&(m_ATb.front()) + m_numCols);
 
-	if (rc != TAUCS_SUCCESS)
+	if (!rc)
 		return false;
 
-	rc = taucs_linsolve(m_ATA,
-							&m_factorATA,
-							1,
-							z,
-							(taucsType *)&(m_ATb.front()) +  2*m_numCols,
-							SIVANsolve,
-							SIVANopt_arg);
+	rc = SolveFactored(m_ATA, &m_factorATA, 1, z, (taucsType *)&(m_ATb.front()) +  2*m_numCols);
 
-	return (rc == TAUCS_SUCCESS);
+	return rc;
 }
 
 // The version of SolveATA with 2 right-hand sides
@@ -297,7 +280,7 @@ bool SparseSolver::SolveATA3(const taucsType * bx, const taucsType * by, const t
 bool SparseSolver::SolveATA2(const taucsType * bx, const taucsType * by,
 								   taucsType * x,        taucsType * y)
 {
-	if (m_factorATA == NULL) {
+	if (!IsFactored(m_factorATA)) {
 		bool rc = FactorATA();
 		if (!rc)
 			return false;
@@ -308,38 +291,30 @@ bool SparseSolver::SolveATA2(const taucsType * bx, const taucsType * by,
 		m_ATb.resize(m_numCols*2);
 
 	// multiply right-hand side
-	MulMatrixVector(m_AT, bx, (taucsType *)&(m_ATb.front()));
-	MulMatrixVector(m_AT, by, (taucsType *)&(m_ATb.front()) + m_numCols);
+	MulTransposeMatrixVectors(m_A, bx, (taucsType *)&(m_ATb.front()), 1);
+	MulTransposeMatrixVectors(m_A, by, (taucsType *)&(m_ATb.front()) + m_numCols, 1);
 	
 
 	// solve the system
-	int	rc = taucs_linsolve(m_ATA,
-							&m_factorATA,
-							1,
-							x,
-							(taucsType *)&(m_ATb.front()),
-							SIVANsolve,
-							SIVANopt_arg);
-
-	if (rc != TAUCS_SUCCESS)
+	bool	rc = SolveFactored(m_ATA, &m_factorATA, 1, x, (taucsType *)&(m_ATb.front()));
+
+	if (!rc)
 		return false;
 
-	rc = taucs_linsolve(m_ATA,
-							&m_factorATA,
-							1,
-							y,
-							(taucsType *)&(m_ATb.front()) + m_numCols,
-							SIVANsolve,
-							SIVANopt_arg);
+	rc = SolveFactored(m_ATA, &m_factorATA, 1, y, (taucsType *)&(m_ATb.front()) + m_numCols);
 
-	return (rc == TAUCS_SUCCESS);
+	return rc;
 }
 
 void SparseSolver::ClearFactorATA() {
 	// release the factor
 	taucs_linsolve(NULL,&m_factorATA,0, NULL,NULL,SIVANfactor,SIVANopt_arg);
 	m_factorATA = NULL;
+	m_iterative = false;
+	ClearOutOfCore();
+	free(m_etree);
 	m_etree = NULL;
+	ClearHandles();
 }
 
 void SparseSolver::ClearFactorA() {
@@ -349,7 +324,18 @@ void SparseSolver::ClearFactorA() {
 	else
 		taucs_linsolve(NULL,&m_factorA,0, NULL,NULL,SIVANfactorLU,SIVANopt_arg);
 	m_factorA = NULL;
+	m_iterative = false;
+	ClearOutOfCore();
+	// the etree belongs to whichever factor was updated last
+	free(m_etree);
+	m_etree = NULL;
+	ClearHandles();
+}
 
+void SparseSolver::ClearHandles() {
+	m_handles.clear();
+	m_handleZ.clear();
+	m_handleS.clear();
 }
 
 void SparseSolver::ClearMatricesATA() {
@@ -358,12 +344,20 @@ void SparseSolver::ClearMatricesATA() {
 	m_AT = NULL;
 	taucs_free(m_ATA);
 	m_ATA = NULL;
+	taucs_free(m_rowsM);
+	m_rowsM = NULL;
+	m_statsValid = false;
 }
 
 void SparseSolver::ClearMatricesA() {
 	// free the matrices
 	taucs_free(m_A);
 	m_A = NULL;
+	taucs_free(m_rowsA);
+	m_rowsA = NULL;
+	taucs_free(m_rowsM);
+	m_rowsM = NULL;
+	m_statsValid = false;
 }
 
 // allows to add an anchored vertex without destroying the factor, if there was one
@@ -373,76 +367,624 @@ void SparseSolver::ClearMatricesA() {
 // if there was a factor, the factor will be updated, approximately at the cost of
 // a single solve.
 void SparseSolver::AddAnchor(const int i, const taucsType w) {
+	AddAnchors(&i, &w, 1);
+}
+
+// adds count anchored vertices at once, updating the factor (if any) by a
+// single batched rank-count update
+// returns true on success, false otherwise
+bool SparseSolver::AddAnchors(const int * indices, const taucsType * weights, const int count) {
+	if (count <= 0)
+		return true;
+
+	// the handle data depends on the matrix
+	ClearHandles();
+
+	for (int k = 0; k < count; ++k)
+		if (indices[k] < 0 || indices[k] >= m_numCols)
+			return false;
+
 	if (m_SPD) {
 		// update the columns
-		if (m_colsA[i].find(i) == m_colsA[i].end())
-			m_colsA[i][i] = w*w;
-		else
-			m_colsA[i][i] += w*w;
+		for (int k = 0; k < count; ++k) {
+			const int i = indices[k];
+			const taucsType w = weights[k];
+			if (m_colsA[i].find(i) == m_colsA[i].end())
+				m_colsA[i][i] = w*w;
+			else
+				m_colsA[i][i] += w*w;
+		}
 
 		if (m_factorA != NULL) {
 			// the matrix is SPD so we update the factor of A
-			chol_update(m_factorA, i, w, &m_etree);
+			if (chol_updown(m_factorA, count, indices, weights, 1, &m_etree) != 0) {
+				ClearFactorA();
+				ClearMatricesA();
+				return false;
+			}
 			// update the matrix
-			m_A->taucs_values[ m_A->colptr[i] ] += w*w;
+			for (int k = 0; k < count; ++k)
+				m_A->taucs_values[ m_A->colptr[indices[k]] ] += weights[k]*weights[k];
+		}
+		else {
+			// no factor to update, but an iterative or out-of-core one is stale too
+			ClearFactorA();
+			ClearMatricesA();
 		}
 	}
 	else {
-		m_colsA[i][m_numRows] = w;
-		m_numRows++;
+		for (int k = 0; k < count; ++k) {
+			m_colsA[indices[k]][m_numRows] = weights[k];
+			m_numRows++;
+		}
 
 		if (m_factorATA != NULL) {
 			// update the ATA factor
-			chol_update(m_factorATA, i, w, &m_etree);
+			if (chol_updown(m_factorATA, count, indices, weights, 1, &m_etree) != 0) {
+				ClearFactorATA();
+				ClearMatricesATA();
+				ClearMatricesA();
+				return false;
+			}
 			// update ATA
-			m_ATA->taucs_values[ m_ATA->colptr[i] ] += w*w;
-			// update A and AT (for multiplying rhs)
+			for (int k = 0; k < count; ++k)
+				m_ATA->taucs_values[ m_ATA->colptr[indices[k]] ] += weights[k]*weights[k];
+			// update A and AT (for multiplying rhs), once for the whole batch
 			CreateA();
 			taucs_free(m_AT);
-            m_AT = MatrixTranspose(m_A);
+			m_AT = MatrixTranspose(m_A);
+		}
+		else {
+			ClearFactorATA();
+			ClearMatricesATA();
+			ClearMatricesA();
 		}
-	}	
+	}
+	return true;
 }
 
-void SparseSolver::MultiplyMatrixVector(const taucsType * v, taucsType * result, const int numCols) const {
-	// make result all zero
-	memset(result, 0, m_numRows * numCols * sizeof(taucsType));
-
-	std::map<int,taucsType>::const_iterator iter;
-	int										offset_v;
-	int										offset_r;
-
-	if (m_SPD) { // the matrix is symmetric
-		for (int c = 0; c < numCols; ++c) {
-			offset_v = m_numCols*c;
-			for (int col = 0; col < m_numCols; ++col) {
-				// going over column col of the matrix, multiplying
-				// it by v[col] and setting the appropriate values
-				// of vector result; also mirroring the other triangle
-				for (iter = m_colsA[col].begin(); iter->first < col; ++iter) {
-					result[iter->first + offset_v]	+= v[col + offset_v]*(iter->second);
-					// mirroring
-					result[col + offset_v]			+= v[iter->first + offset_v]*(iter->second);
-				}
-				if (iter->first == col)
-					result[iter->first + offset_v]	+= v[col + offset_v]*(iter->second);
+// removes count anchors previously added with the same indices and weights,
+// downdating the factor (if any) in place
+// returns true on success, false otherwise
+bool SparseSolver::RemoveAnchors(const int * indices, const taucsType * weights, const int count) {
+	if (count <= 0)
+		return true;
+
+	// the handle data depends on the matrix
+	ClearHandles();
+
+	for (int k = 0; k < count; ++k)
+		if (indices[k] < 0 || indices[k] >= m_numCols)
+			return false;
+
+	if (m_SPD) {
+		for (int k = 0; k < count; ++k)
+			if (m_colsA[indices[k]].find(indices[k]) == m_colsA[indices[k]].end())
+				return false;
+		for (int k = 0; k < count; ++k)
+			m_colsA[indices[k]][indices[k]] -= weights[k]*weights[k];
+
+		if (m_factorA != NULL) {
+			if (chol_updown(m_factorA, count, indices, weights, 0, &m_etree) != 0) {
+				// the modified matrix is not positive definite (or we ran out of
+				// memory); the factor is no longer valid
+				ClearFactorA();
+				ClearMatricesA();
+				return false;
 			}
+			for (int k = 0; k < count; ++k)
+				m_A->taucs_values[ m_A->colptr[indices[k]] ] -= weights[k]*weights[k];
+		}
+		else {
+			// no factor to update, but an iterative or out-of-core one is stale too
+			ClearFactorA();
+			ClearMatricesA();
 		}
 	}
 	else {
-		for (int c = 0; c < numCols; ++c) {
-			offset_v = m_numCols*c;
-			offset_r = m_numRows*c;
-			for (int col = 0; col < m_numCols; ++col) {
-				// going over column col of the matrix, multiplying
-				// it by v[col] and setting the appropriate values
-				// of vector result
-				for (iter = m_colsA[col].begin(); iter != m_colsA[col].end(); ++iter) {
-					result[iter->first + offset_r] += v[col + offset_v]*(iter->second);
-				}
+		// find the anchor rows first so that nothing is changed on failure.
+		// anchors are appended at the bottom of A, so the last matching row is taken
+		std::vector<int> rows(count);
+		for (int k = 0; k < count; ++k) {
+			const std::map<int,taucsType> & col = m_colsA[indices[k]];
+			std::map<int,taucsType>::const_reverse_iterator riter = col.rbegin();
+			for (; riter != col.rend(); ++riter) {
+				if (riter->second != weights[k])
+					continue;
+				// the same anchor may appear several times in one batch
+				bool taken = false;
+				for (int l = 0; l < k; ++l)
+					taken = taken || (indices[l] == indices[k] && rows[l] == riter->first);
+				if (!taken)
+					break;
+			}
+			if (riter == col.rend())
+				return false;
+			rows[k] = riter->first;
+		}
+		for (int k = 0; k < count; ++k)
+			m_colsA[indices[k]].erase(rows[k]);
+
+		if (m_factorATA != NULL) {
+			if (chol_updown(m_factorATA, count, indices, weights, 0, &m_etree) != 0) {
+				ClearFactorATA();
+				ClearMatricesATA();
+				ClearMatricesA();
+				return false;
 			}
+			for (int k = 0; k < count; ++k)
+				m_ATA->taucs_values[ m_ATA->colptr[indices[k]] ] -= weights[k]*weights[k];
+			CreateA();
+			taucs_free(m_AT);
+			m_AT = MatrixTranspose(m_A);
+		}
+		else {
+			ClearFactorATA();
+			ClearMatricesATA();
+			ClearMatricesA();
 		}
 	}
+	return true;
+}
+
+// Precomputes the response operator and the Schur complement for the handles
+// returns true on success, false otherwise
+bool SparseSolver::FactorHandles(const int * handles, const int count) {
+	ClearHandles();
+
+	if (count <= 0)
+		return false;
+	for (int h = 0; h < count; ++h)
+		if (handles[h] < 0 || handles[h] >= m_numCols)
+			return false;
+
+	// the matrix that is actually factored
+	taucs_ccs_matrix *	M;
+	void **				factor;
+	if (m_SPD) {
+		if (!IsFactored(m_factorA) && !FactorA())
+			return false;
+		M = m_A;
+		factor = &m_factorA;
+	}
+	else {
+		if (!IsFactored(m_factorATA) && !FactorATA())
+			return false;
+		M = m_ATA;
+		factor = &m_factorATA;
+	}
+	// one iterative or out-of-core solve per handle is not worth it
+	if (*factor == NULL)
+		return false;
+
+	const int n = m_numCols;
+	std::vector<taucsType> Z((size_t)n * count);
+
+	// Z = M^-1 C^T, solving for a few unit vectors at a time to bound the memory
+	const int blockSize = 16;
+	std::vector<taucsType> E((size_t)n * blockSize), X((size_t)n * blockSize);
+	for (int first = 0; first < count; first += blockSize) {
+		const int numRhs = (count - first < blockSize)? (count - first) : blockSize;
+		E.assign(E.size(), 0.0);
+		for (int c = 0; c < numRhs; ++c)
+			E[(size_t)c*n + handles[first + c]] = 1.0;
+
+		if (!SolveFactored(M, factor, numRhs, &X[0], &E[0]))
+			return false;
+
+		for (int c = 0; c < numRhs; ++c)
+			for (int i = 0; i < n; ++i)
+				Z[(size_t)i*count + first + c] = X[(size_t)c*n + i];
+	}
+
+	// S = C Z, the rows of Z at the handles; symmetric positive definite
+	// as long as the handles are distinct
+	std::vector<taucsType> S((size_t)count * count);
+	for (int r = 0; r < count; ++r)
+		for (int c = 0; c < count; ++c)
+			S[(size_t)r*count + c] = Z[(size_t)handles[r]*count + c];
+
+	// dense Cholesky S = L L^T, L stored in the lower triangle
+	for (int j = 0; j < count; ++j) {
+		taucsType d = S[(size_t)j*count + j];
+		for (int p = 0; p < j; ++p)
+			d -= S[(size_t)j*count + p] * S[(size_t)j*count + p];
+		if (d <= 0)
+			return false;
+		d = sqrt(d);
+		S[(size_t)j*count + j] = d;
+		for (int i = j + 1; i < count; ++i) {
+			taucsType v = S[(size_t)i*count + j];
+			for (int p = 0; p < j; ++p)
+				v -= S[(size_t)i*count + p] * S[(size_t)j*count + p];
+			S[(size_t)i*count + j] = v / d;
+		}
+	}
+
+	m_handles.assign(handles, handles + count);
+	m_handleZ.swap(Z);
+	m_handleS.swap(S);
+	return true;
+}
+
+// x = x0 + Z S^-1 (u - C x0) for every right-hand side
+// returns true on success, false otherwise
+bool SparseSolver::SolveHandles(const taucsType * x0, const taucsType * u, taucsType * x, const int numRhs) const {
+	if (m_handles.empty())
+		return false;
+
+	const int n = m_numCols;
+	const int k = (int)m_handles.size();
+	const taucsType * S = &m_handleS[0];
+
+	// lambda = S^-1 (u - C x0) by forward and back substitution
+	std::vector<taucsType> lambda((size_t)k * numRhs);
+	for (int c = 0; c < numRhs; ++c) {
+		taucsType * l = &lambda[(size_t)c*k];
+		for (int i = 0; i < k; ++i) {
+			taucsType v = u[(size_t)c*k + i] - x0[(size_t)c*n + m_handles[i]];
+			for (int p = 0; p < i; ++p)
+				v -= S[(size_t)i*k + p] * l[p];
+			l[i] = v / S[(size_t)i*k + i];
+		}
+		for (int i = k - 1; i >= 0; --i) {
+			taucsType v = l[i];
+			for (int p = i + 1; p < k; ++p)
+				v -= S[(size_t)p*k + i] * l[p];
+			l[i] = v / S[(size_t)i*k + i];
+		}
+	}
+
+	// x = x0 + Z lambda; every row of Z is contiguous, rows are independent
+	const taucsType * Z = &m_handleZ[0];
+	const taucsType * L = &lambda[0];
+#pragma omp parallel for schedule(static) if (n > 4096)
+	for (int i = 0; i < n; ++i) {
+		const taucsType * z = Z + (size_t)i*k;
+		for (int c = 0; c < numRhs; ++c) {
+			const taucsType * l = L + (size_t)c*k;
+			taucsType v = 0;
+			for (int p = 0; p < k; ++p)
+				v += z[p] * l[p];
+			x[(size_t)c*n + i] = x0[(size_t)c*n + i] + v;
+		}
+	}
+	return true;
+}
+
+// Sets the memory budget of the factorization and the policy when it is exceeded
+void SparseSolver::SetMemoryBudget(const double bytes, const int policy) {
+	m_memoryBudget = (bytes > 0)? bytes : 0;
+	m_budgetPolicy = policy;
+}
+
+// Symbolic analysis of the matrix to be factored, result in m_stats
+// returns true on success, false otherwise
+bool SparseSolver::AnalyzeFactor() {
+	taucs_ccs_matrix * M;
+	if (m_SPD) {
+		if (m_A == NULL)
+			CreateA();
+		M = m_A;
+	}
+	else {
+		if (m_ATA == NULL)
+			CreateATA();
+		M = m_ATA;
+	}
+	if (M == NULL)
+		return false;
+
+	// the same ordering taucs_linsolve uses for the factor
+	static char ordering[] = "metis";
+	int * perm = NULL;
+	int * invperm = NULL;
+	taucs_ccs_order(M, &perm, &invperm, ordering);
+	if (perm == NULL || invperm == NULL) {
+		free(perm);
+		free(invperm);
+		return false;
+	}
+
+	double nnzL, flops, maxColCount;
+	int rc = cholesky_analysis(M, perm, invperm, &nnzL, &flops, &maxColCount);
+	free(perm);
+	free(invperm);
+	if (rc != 0)
+		return false;
+
+	const double entryBytes = sizeof(taucsType) + sizeof(int);
+	m_stats.n				= M->n;
+	m_stats.nnzA			= M->colptr[M->n];
+	m_stats.predictedNnzL	= nnzL;
+	m_stats.predictedBytes	= nnzL * entryBytes;
+	// the factor, the permuted copy of M and the largest dense block
+	m_stats.peakWorkspace	= m_stats.predictedBytes + m_stats.nnzA * entryBytes
+							+ maxColCount * maxColCount * sizeof(taucsType);
+	m_stats.fillRatio		= (m_stats.nnzA > 0)? nnzL / m_stats.nnzA : 0;
+	m_stats.flops			= flops;
+	m_stats.actualNnzL		= 0;
+	m_stats.actualBytes		= 0;
+	m_stats.iterative		= false;
+	m_stats.outOfCore		= false;
+	m_statsValid = true;
+	return true;
+}
+
+// Checks the memory budget before a factorization
+// returns true if the factorization may proceed
+bool SparseSolver::AdmitFactor() {
+	m_iterative = false;
+	m_outOfCore = m_forceOutOfCore;
+	if (m_outOfCore)
+		return false;
+	if (m_memoryBudget <= 0)
+		return true;
+
+	// an analysis that cannot even be done certainly exceeds the budget
+	if ((m_statsValid || AnalyzeFactor()) && m_stats.peakWorkspace <= m_memoryBudget)
+		return true;
+
+	if (m_budgetPolicy == SOLVER_BUDGET_ITERATIVE)
+		m_iterative = true;
+	else if (m_budgetPolicy == SOLVER_BUDGET_OUT_OF_CORE)
+		m_outOfCore = true;
+	return false;
+}
+
+// Enables out-of-core factorization regardless of the memory budget
+void SparseSolver::SetOutOfCore(const bool enable, const std::string & scratchDir) {
+	m_forceOutOfCore = enable;
+	m_scratchDir = scratchDir;
+}
+
+// Factors the symmetric (lower) matrix M out of core
+// returns true on success, false otherwise
+bool SparseSolver::FactorOutOfCore(taucs_ccs_matrix * M) {
+	ClearOutOfCore();
+	if (M == NULL)
+		return false;
+
+	// the out-of-core factorization does not order the matrix itself
+	static char ordering[] = "metis";
+	int * perm = NULL;
+	int * invperm = NULL;
+	taucs_ccs_order(M, &perm, &invperm, ordering);
+	if (perm == NULL || invperm == NULL) {
+		free(perm);
+		free(invperm);
+		return false;
+	}
+	m_oocPerm.assign(perm, perm + M->n);
+	m_oocInvPerm.assign(invperm, invperm + M->n);
+	taucs_ccs_matrix * PAP = taucs_ccs_permute_symmetrically(M, perm, invperm);
+	free(perm);
+	free(invperm);
+	if (PAP == NULL)
+		return false;
+
+	// one scratch file per solver object
+	std::ostringstream name;
+	name << m_scratchDir;
+	if (!m_scratchDir.empty() && m_scratchDir[m_scratchDir.size() - 1] != '/' && m_scratchDir[m_scratchDir.size() - 1] != '\\')
+		name << '/';
+	name << "taucs_ooc_" << (const void *)this << ".L";
+	std::string fileName = name.str();
+	m_oocL = taucs_io_create_singlefile(&fileName[0]);
+	if (m_oocL == NULL) {
+		taucs_ccs_free(PAP);
+		return false;
+	}
+
+	// in-core memory the factorization may use while streaming supernodes out
+	double memory = (m_memoryBudget > 0)? m_memoryBudget : 0.5 * taucs_available_memory_size();
+	int rc = taucs_ooc_factor_llt(PAP, m_oocL, memory);
+	taucs_ccs_free(PAP);
+	if (rc != TAUCS_SUCCESS) {
+		ClearOutOfCore();
+		return false;
+	}
+	m_outOfCore = true;
+	return true;
+}
+
+// size of the reads of the prefetch
+static const int kPrefetchChunk = 1 << 20;
+
+// Best-effort read-ahead of the scratch file for the triangular solves of
+// SolveOutOfCore, one thread for all the right-hand sides until column turns
+// negative. The only progress it sees is the column being solved: for each one
+// the file is read once from the start, which the forward solve mostly streams
+// in that direction, then once from the end for the backward solve. Whether the
+// reads land ahead of the solve depends on the layout of the file, which the
+// TAUCS library keeps to itself, so this only warms the file cache.
+static void PrefetchSolve(const std::string fileName, const std::atomic<int> * column) {
+	std::ifstream file(fileName.c_str(), std::ios::binary | std::ios::ate);
+	if (!file)
+		return;
+	const long long size = (long long)file.tellg();
+	const long long chunks = (size + kPrefetchChunk - 1) / kPrefetchChunk;
+	std::vector<char> buffer(kPrefetchChunk);
+
+	int current = -1;
+	long long read = 0;		// chunks read for the current column, forward then backward
+	for (int c = column->load(); c >= 0; c = column->load()) {
+		if (c != current) {
+			current = c;
+			read = 0;
+		}
+		// both passes done, wait for the next column
+		if (read >= 2 * chunks) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		const long long chunk = (read < chunks)? read : 2 * chunks - 1 - read;
+		++read;
+		file.clear();
+		file.seekg(chunk * kPrefetchChunk);
+		file.read(&buffer[0], kPrefetchChunk);
+	}
+}
+
+// Solves with the out-of-core factor: x = P^T L^-T L^-1 P b
+// returns true on success, false otherwise
+bool SparseSolver::SolveOutOfCore(const int numRhs, taucsType * x, const taucsType * b) {
+	if (m_oocL == NULL)
+		return false;
+
+	const int n = (int)m_oocPerm.size();
+	std::vector<taucsType> PB(n), PX(n);
+
+	// one prefetch for all the columns, restarted by each of them
+	std::atomic<int> column(0);
+	std::thread prefetch(PrefetchSolve, std::string(taucs_io_get_basename(m_oocL)), &column);
+
+	bool ok = true;
+	for (int c = 0; c < numRhs && ok; ++c) {
+		column = c;
+
+		const taucsType * curB = b + (size_t)c*n;
+		for (int i = 0; i < n; ++i)
+			PB[i] = curB[m_oocPerm[i]];
+		ok = (taucs_ooc_solve_llt(m_oocL, &PX[0], &PB[0]) == TAUCS_SUCCESS);
+		taucsType * curX = x + (size_t)c*n;
+		for (int i = 0; i < n; ++i)
+			curX[i] = PX[m_oocInvPerm[i]];
+	}
+
+	column = -1;
+	prefetch.join();
+	return ok;
+}
+
+// releases the out-of-core factor and removes its scratch file
+void SparseSolver::ClearOutOfCore() {
+	if (m_oocL != NULL)
+		taucs_io_delete(m_oocL);
+	m_oocL = NULL;
+	m_oocPerm.clear();
+	m_oocInvPerm.clear();
+	m_outOfCore = false;
+}
+
+// Fills stats with the symbolic analysis and the size of the present factor
+// returns true on success, false otherwise
+bool SparseSolver::GetFactorStatistics(FactorStatistics & stats) {
+	if (!m_statsValid && !AnalyzeFactor())
+		return false;
+
+	stats = m_stats;
+	stats.iterative = m_iterative;
+	stats.outOfCore = (m_oocL != NULL);
+	void * factor = (m_SPD)? m_factorA : m_factorATA;
+	if (factor != NULL)
+		factor_statistics(factor, &stats.actualNnzL, &stats.actualBytes);
+	return true;
+}
+
+// Solves M x = b using factor, or iteratively if the factor was refused
+// returns true on success, false otherwise
+bool SparseSolver::SolveFactored(taucs_ccs_matrix * M, void ** factor, const int numRhs, taucsType * x, const taucsType * b) {
+	if (m_oocL != NULL)
+		return SolveOutOfCore(numRhs, x, b);
+	if (m_iterative)
+		return SolveIterative(M, numRhs, x, b);
+
+	int rc = taucs_linsolve(M, factor, numRhs, x, (void *)b, SIVANsolve, SIVANopt_arg);
+	return (rc == TAUCS_SUCCESS);
+}
+
+// Solves M x = b by Jacobi preconditioned conjugate gradients, starting from zero
+// returns true if all right-hand sides converged, false otherwise
+bool SparseSolver::SolveIterative(taucs_ccs_matrix * M, const int numRhs, taucsType * x, const taucsType * b) {
+	if (M == NULL || !(M->flags & TAUCS_SYMMETRIC))
+		return false;
+	if (m_rowsM == NULL)
+		m_rowsM = CreateRowCopy(M);
+	if (m_rowsM == NULL)
+		return false;
+
+	const int n = M->n;
+	std::vector<taucsType> invDiag(n, 1.0);
+	for (int col = 0; col < n; ++col) {
+		for (int p = M->colptr[col]; p < M->colptr[col+1]; ++p) {
+			if (M->rowind[p] == col && M->taucs_values[p] != 0)
+				invDiag[col] = 1.0 / M->taucs_values[p];
+		}
+	}
+
+	std::vector<taucsType> r(n), z(n), p(n), q(n);
+	bool converged = true;
+	for (int c = 0; c < numRhs; ++c) {
+		const taucsType * curB = b + (size_t)c*n;
+		taucsType * curX = x + (size_t)c*n;
+
+		double normB = 0;
+		for (int i = 0; i < n; ++i) {
+			curX[i] = 0;
+			r[i] = curB[i];
+			z[i] = invDiag[i] * r[i];
+			p[i] = z[i];
+			normB += curB[i] * curB[i];
+		}
+		if (normB == 0)
+			continue;
+
+		double rz = 0;
+		for (int i = 0; i < n; ++i)
+			rz += r[i] * z[i];
+
+		const double threshold = kIterativeTolerance * kIterativeTolerance * normB;
+		double normR = normB;
+		for (int iter = 0; iter < kIterativeMaxIterations && normR > threshold; ++iter) {
+			MulMatrixVectors(M, m_rowsM, &p[0], &q[0], 1);
+			double pq = 0;
+			for (int i = 0; i < n; ++i)
+				pq += p[i] * q[i];
+			if (pq <= 0)
+				break;
+
+			const double alpha = rz / pq;
+			double rzNew = 0;
+			normR = 0;
+			for (int i = 0; i < n; ++i) {
+				curX[i] += alpha * p[i];
+				r[i] -= alpha * q[i];
+				z[i] = invDiag[i] * r[i];
+				rzNew += r[i] * z[i];
+				normR += r[i] * r[i];
+			}
+
+			const double beta = rzNew / rz;
+			rz = rzNew;
+			for (int i = 0; i < n; ++i)
+				p[i] = z[i] + beta * p[i];
+		}
+		converged = converged && (normR <= threshold);
+	}
+	return converged;
+}
+
+void SparseSolver::MultiplyMatrixVector(const taucsType * v, taucsType * result, const int numCols) const {
+	FreezeA();
+
+	if (m_A == NULL || m_rowsA == NULL) {
+		memset(result, 0, m_numRows * numCols * sizeof(taucsType));
+		return;
+	}
+
+	MulMatrixVectors(m_A, m_rowsA, v, result, numCols);
+}
+
+// Creates the compressed copies of A used by the products, if they don't exist yet.
+// They are dropped (by ClearMatricesA) whenever the entries of A change.
+void SparseSolver::FreezeA() const {
+	// only caches data derived from m_colsA, so it is logically const
+	SparseSolver * self = const_cast<SparseSolver *>(this);
+	if (m_A == NULL)
+		self->CreateA();
+	if (m_rowsA == NULL && m_A != NULL)
+		self->m_rowsA = CreateRowCopy(m_A);
 }
 
 // Multiplies the matrix by diagonal matrix D from the left, stores the result
@@ -1,3 +1,4 @@
+#include <string>
 #include "taucsaddon.h"
 
 class SparseSolver {
@@ -5,6 +6,9 @@ protected:
 	taucs_ccs_matrix * m_A;
 	taucs_ccs_matrix * m_AT;
 	taucs_ccs_matrix * m_ATA;
+	// row-compressed copy of m_A (see CreateRowCopy), frozen once A is assembled
+	// and used for the matrix-vector products
+	taucs_ccs_matrix * m_rowsA;
 
 	// is set to true iff m_A is symmetric positive definite
 	bool  m_SPD;
@@ -24,12 +28,34 @@ protected:
 	int m_numRows;
 	int m_numCols; 
 
+	// handle (Schur complement) solve, see FactorHandles
+	std::vector<int>		m_handles;		// the k constrained unknowns
+	std::vector<taucsType>	m_handleZ;		// response operator M^-1 C^T, n x k, row by row
+	std::vector<taucsType>	m_handleS;		// Cholesky factor of C M^-1 C^T, k x k, row by row
+
+	// memory accounting and admission control, see SetMemoryBudget
+	double					m_memoryBudget;	// in bytes, 0 means unlimited
+	int						m_budgetPolicy;	// SolverBudgetPolicy
+	bool					m_iterative;	// the factor was refused, systems are solved by PCG
+	bool					m_statsValid;	// m_stats holds the analysis of the present matrix
+	FactorStatistics		m_stats;
+	taucs_ccs_matrix *		m_rowsM;		// row copy of the factored matrix, for PCG
+
+	// out-of-core factorization, see SetOutOfCore
+	bool					m_forceOutOfCore;	// always factor out of core
+	bool					m_outOfCore;		// the factor goes (went) to the scratch file
+	std::string				m_scratchDir;		// directory of the scratch file
+	taucs_io_handle *		m_oocL;				// the out-of-core factor of the permuted matrix
+	std::vector<int>		m_oocPerm;			// its ordering
+	std::vector<int>		m_oocInvPerm;
+
 public:
 
 	SparseSolver(int numRows, int numCols, bool isSPD = false) 
 		: m_A(NULL)
 		, m_AT(NULL)
 		, m_ATA(NULL)
+		, m_rowsA(NULL)
 		, m_ATb(NULL)
 		, m_factorATA(NULL)
 		, m_factorA(NULL)
@@ -38,6 +64,14 @@ public:
 		, m_numCols(numCols)
 		, m_colsA(numCols)
 		, m_SPD(isSPD)
+		, m_memoryBudget(0)
+		, m_budgetPolicy(SOLVER_BUDGET_REFUSE)
+		, m_iterative(false)
+		, m_statsValid(false)
+		, m_rowsM(NULL)
+		, m_forceOutOfCore(false)
+		, m_outOfCore(false)
+		, m_oocL(NULL)
 	{};
 
 	~SparseSolver() { ClearObject();}
@@ -67,6 +101,21 @@ public:
 	// a single solve.
 	void AddAnchor(const int i, const taucsType w);
 
+	// adds count anchored vertices at once; indices[k] is the anchored vertex and
+	// weights[k] its weight (see AddAnchor). If there was a factor it is modified
+	// by a single batched rank-count update, which visits every column on the union
+	// of the anchors' elimination tree paths only once.
+	// returns true on success, false otherwise (the factor is discarded on failure)
+	bool AddAnchors(const int * indices, const taucsType * weights, const int count);
+
+	// removes count anchors that were previously added with AddAnchor(s) with the
+	// same indices and weights. If there was a factor it is downdated in place.
+	// for a non-SPD matrix the last anchor row of the vertex with the given weight
+	// is emptied (the row itself stays, so right-hand sides keep their layout).
+	// returns true on success, false if an anchor was not found or the downdate
+	// failed (in the latter case the factor is discarded and will be recomputed)
+	bool RemoveAnchors(const int * indices, const taucsType * weights, const int count);
+
 	// Will create A^T A and its factorization, as well as store A^T
 	// returns true on success, false otherwise
 	bool FactorATA();
@@ -121,12 +170,53 @@ public:
 	bool SolveATA2(const taucsType * bx, const taucsType * by,
 						 taucsType * x,        taucsType * y);
 
+	// Precomputes what is needed to re-solve the system when only the values of
+	// some unknowns (the handles) change. M is the matrix that SolveATA actually
+	// factors (A^T A, or A itself when A is SPD) and C selects the handles.
+	// Stores the response operator Z = M^-1 C^T (one solve per handle) and the
+	// Cholesky factor of the k x k Schur complement S = C M^-1 C^T.
+	// Needs about m_numCols*count values of memory. The data is discarded with the factor.
+	// returns true on success, false otherwise
+	bool FactorHandles(const int * handles, const int count);
+
+	// Moves the handles of a solution: given x0 = M^-1 r for any right-hand side r,
+	// computes the least-squares solution for the same r constrained to x[handles] = u,
+	// namely x = x0 + Z S^-1 (u - C x0). This is a k x k dense solve and an
+	// n x k matrix-vector product per right-hand side, no sparse solve.
+	// x0 and x hold numRhs vectors of length m_numCols (x may be the same pointer as x0),
+	// u holds numRhs vectors of length k, in the order given to FactorHandles
+	// returns false if FactorHandles was not called (or its data was discarded)
+	bool SolveHandles(const taucsType * x0, const taucsType * u, taucsType * x, const int numRhs) const;
+
+	// returns true if the data of FactorHandles is available
+	bool HasHandles() const { return !m_handles.empty(); }
+
+	// Sets the memory budget of the factorization in bytes (0 means unlimited) and
+	// what happens when the predicted peak memory of the factorization exceeds it
+	// (see SolverBudgetPolicy). The budget is checked by the symbolic analysis
+	// before any numerical work, on the next factorization.
+	void SetMemoryBudget(const double bytes, const int policy);
+
+	// Enables (or disables) out-of-core factorization regardless of the memory budget.
+	// The factor of the permuted matrix is written supernode by supernode to a scratch
+	// file in scratchDir (the current directory if empty), which is removed together
+	// with the factor; solves stream it back while a helper thread reads ahead.
+	// The policy SOLVER_BUDGET_OUT_OF_CORE selects this mode when the budget is exceeded.
+	void SetOutOfCore(const bool enable, const std::string & scratchDir);
+
+	// Fills stats with the symbolic analysis of the matrix to be factored (A^T A, or A
+	// if A is SPD), computing it if needed, and with the size of the present factor.
+	// returns true on success, false otherwise
+	bool GetFactorStatistics(FactorStatistics & stats);
+
 // Matrix utility routines
 
 	// Stores the result of Matrix*v in result.
 	// v can have numCols columns; then the result is stored column-wise as well
 	// It is assumed space is allocaed in result!
 	// v cannot be the same pointer as result
+	// The product runs over a compressed copy of A which is created on the first call
+	// and kept until A is modified; for an SPD matrix the lower triangle is used.
 	void MultiplyMatrixVector(const taucsType * v, taucsType * result, const int numCols) const;
 
 	// Multiplies the matrix by diagonal matrix D from the left, stores the result
@@ -169,9 +259,31 @@ protected:
 	void CreateATA();
 	// Will create A matrix (in ccs format)
 	void CreateA();
+	// Will create A and its row-compressed copy if they don't exist
+	void FreezeA() const;
 
 	void ClearFactorATA();
 	void ClearFactorA();
+	void ClearHandles(); // clears the data of FactorHandles
+
+	// Symbolic analysis (ordering and elimination tree) of the matrix to be factored,
+	// stores the result in m_stats. returns true on success, false otherwise
+	bool AnalyzeFactor();
+	// Checks the memory budget before a factorization; returns true if the in-core
+	// factorization may proceed. Otherwise sets m_iterative or m_outOfCore according
+	// to the policy (or to SetOutOfCore).
+	bool AdmitFactor();
+	// returns true if the system can be solved without factoring first
+	bool IsFactored(const void * factor) const { return factor != NULL || m_iterative || m_oocL != NULL; }
+	// Factors the symmetric (lower) matrix M out of core. returns true on success
+	bool FactorOutOfCore(taucs_ccs_matrix * M);
+	// Solves with the out-of-core factor. returns true on success
+	bool SolveOutOfCore(const int numRhs, taucsType * x, const taucsType * b);
+	void ClearOutOfCore(); // releases the out-of-core factor and its scratch file
+	// Solves M x = b using factor, or iteratively if the factor was refused
+	bool SolveFactored(taucs_ccs_matrix * M, void ** factor, const int numRhs, taucsType * x, const taucsType * b);
+	// Solves M x = b by Jacobi preconditioned conjugate gradients (M symmetric, lower)
+	bool SolveIterative(taucs_ccs_matrix * M, const int numRhs, taucsType * x, const taucsType * b);
 	void ClearMatricesATA(); // clears m_A, m_ATA, m_AT
 	void ClearMatricesA(); // clears the m_A matrix
 };
@@ -1,10 +1,16 @@
 #include <math.h>
+#include <stdlib.h>
 #include "taucs.h"
 
 #define TAUCS_FACTORTYPE_NONE			0
 #define TAUCS_FACTORTYPE_LLT_SUPERNODAL		1
 #define TAUCS_FACTORTYPE_LLT_CCS		2
 
+// maximal number of rank-1 modifications applied in a single sweep over L.
+// larger batches are split into several sweeps, which bounds the work array
+// to (number of touched columns) x CHOL_UPDOWN_MAXRANK doubles.
+#define CHOL_UPDOWN_MAXRANK			8
+
 typedef struct {
   int  n;
   int  flags;
@@ -14,23 +20,24 @@ typedef struct {
   void* L;
 } taucs_factorization;
 
-void chol_update(void *vF, int index, double val,void**vetree){
+static int chol_updown_cmp(const void *a, const void *b){
+   int ia=*(const int *)a;
+   int ib=*(const int *)b;
+   return (ia<ib)?-1:((ia>ib)?1:0);
+}
+
+// makes sure the factor is stored as a CCS matrix (so it can be modified in place)
+// and that the elimination tree of L is available in *vetree.
+static taucs_ccs_matrix *chol_updown_prepare(taucs_factorization *F, void **vetree){
    taucs_ccs_matrix *L;
-   double *full_vec;
    int begin_of_col, end_of_col;
-   int k,i,min;
+   int i,k,min;
    int *parent;
-   double s,c;
-   double up_val, down_val, norm;
-   double tmp, *tmp_up_ptr, *tmp_down_ptr;  
-   taucs_factorization *F;
-
 
-   F=(taucs_factorization*)vF;
-   //parent=(int *)(*vetree);
-   
    if(F->type==TAUCS_FACTORTYPE_LLT_SUPERNODAL){
       L=taucs_supernodal_factor_to_ccs(F->L);
+      if(!L)
+         return NULL;
       F->type=TAUCS_FACTORTYPE_LLT_CCS;
       taucs_supernodal_factor_free(F->L);
       F->L=L;
@@ -39,47 +46,135 @@ void chol_update(void *vF, int index, double val,void**vetree){
 
    if(!(*vetree)){
       *vetree=malloc(L->n*sizeof(int));
+      if(!(*vetree))
+         return NULL;
       parent=(int *)(*vetree);
       for(i=0; i<L->n; i++){
          begin_of_col=L->colptr[i];
-   	     end_of_col=L->colptr[i+1];      
+         end_of_col=L->colptr[i+1];
          min=L->n;
          for(k=begin_of_col+1; k<end_of_col; k++)
             min=((L->rowind[k]<min)?(L->rowind[k]):min);
          parent[i]=min;
       }
-   }else{
-      parent=(int *)(*vetree);
    }
+   return L;
+}
+
+// applies count rank-1 modifications L*L^T +/- w_t*w_t^T, w_t = val[t]*e_index[t],
+// to the factor F. update!=0 adds the terms, update==0 removes them (downdate).
+// the modifications are applied in sweeps of at most CHOL_UPDOWN_MAXRANK columns:
+// every sweep visits each column on the union of the etree paths only once and
+// applies all the pending rotations to it, so the cost is proportional to the
+// size of the union instead of the sum of the individual paths.
+// index[] are indices in the original (unpermuted) ordering.
+// returns 0 on success, -1 on failure (out of memory, or the downdated matrix
+// is not positive definite anymore - the factor is invalid in that case).
+int chol_updown(void *vF, int count, const int *index, const double *val, int update, void **vetree){
+   taucs_ccs_matrix *L;
+   taucs_factorization *F;
+   int *parent, *mark, *cols, *start;
+   double *W;
+   double sigma;
+   int ncols, rank, first, t, r, j, k, i;
+   int begin_of_col, end_of_col;
+   double ljj, wj, rjj, c, s, lij, *w, *wi;
+   int rc=0;
+
+   if(count<=0)
+      return 0;
+
+   F=(taucs_factorization*)vF;
+   L=chol_updown_prepare(F, vetree);
+   if(!L)
+      return -1;
+   parent=(int *)(*vetree);
+   sigma=update?1.0:-1.0;
+
+   mark=(int *)malloc(L->n*sizeof(int));
+   cols=(int *)malloc(L->n*sizeof(int));
+   start=(int *)malloc(CHOL_UPDOWN_MAXRANK*sizeof(int));
+   W=NULL;
+   if(!mark || !cols || !start){
+      rc=-1;
+      goto cleanup;
+   }
+   for(i=0; i<L->n; i++)
+      mark[i]=-1;
+
+   for(first=0; first<count && rc==0; first+=rank){
+      rank=count-first;
+      if(rank>CHOL_UPDOWN_MAXRANK)
+         rank=CHOL_UPDOWN_MAXRANK;
 
-   index=F->colperm[index];
-/*
-   for(k=0; k<L->n; k++)
-      if(F->rowperm[k]==index){
-         index=k;  
+      // collect the union of the etree paths of this sweep
+      ncols=0;
+      for(t=0; t<rank; t++){
+         j=F->colperm[index[first+t]];
+         start[t]=j;
+         while(j<L->n && mark[j]<0){
+            mark[j]=0;
+            cols[ncols++]=j;
+            j=parent[j];
+         }
+      }
+      // parents always have larger indices, so ascending order is a valid
+      // elimination order for the sweep
+      qsort(cols, ncols, sizeof(int), chol_updown_cmp);
+      for(r=0; r<ncols; r++)
+         mark[cols[r]]=r;
+
+      W=(double *)calloc(ncols*CHOL_UPDOWN_MAXRANK, sizeof(double));
+      if(!W){
+         rc=-1;
          break;
       }
-*/   
-   full_vec=(double *)calloc(L->n,sizeof(double));
-   full_vec[index]=val;
-
-   while(index < L->n){
-      begin_of_col=L->colptr[index];
-      end_of_col=L->colptr[index+1];      
-      up_val=L->values.d[begin_of_col];
-      down_val=full_vec[index];
-      norm=sqrt(up_val*up_val+down_val*down_val);
-      s=down_val/norm;
-      c=up_val/norm;
-      for(k=begin_of_col; k<end_of_col; k++){
-         tmp_up_ptr=L->values.d+k;
-         tmp_down_ptr=full_vec+L->rowind[k];
-         tmp=*tmp_up_ptr;
-         *tmp_up_ptr=c*(*tmp_up_ptr)+s*(*tmp_down_ptr);
-         *tmp_down_ptr=c*(*tmp_down_ptr)-s*tmp;
+      for(t=0; t<rank; t++)
+         W[mark[start[t]]*CHOL_UPDOWN_MAXRANK+t]+=val[first+t];
+
+      for(r=0; r<ncols && rc==0; r++){
+         j=cols[r];
+         begin_of_col=L->colptr[j];
+         end_of_col=L->colptr[j+1];
+         w=W+r*CHOL_UPDOWN_MAXRANK;
+         for(t=0; t<rank; t++){
+            wj=w[t];
+            if(wj==0.0)
+               continue;
+            ljj=L->values.d[begin_of_col];
+            rjj=ljj*ljj+sigma*wj*wj;
+            if(rjj<=0.0){
+               rc=-1;
+               break;
+            }
+            rjj=sqrt(rjj);
+            c=rjj/ljj;
+            s=wj/ljj;
+            L->values.d[begin_of_col]=rjj;
+            for(k=begin_of_col+1; k<end_of_col; k++){
+               wi=W+mark[L->rowind[k]]*CHOL_UPDOWN_MAXRANK+t;
+               lij=(L->values.d[k]+sigma*s*(*wi))/c;
+               L->values.d[k]=lij;
+               *wi=c*(*wi)-s*lij;
+            }
+         }
       }
-      index=parent[index];
+
+      for(r=0; r<ncols; r++)
+         mark[cols[r]]=-1;
+      free(W);
+      W=NULL;
    }
-   free(full_vec);
 
+cleanup:
+   free(W);
+   free(start);
+   free(cols);
+   free(mark);
+   return rc;
+}
+
+// rank-1 update of the factor, kept for the existing callers
+void chol_update(void *vF, int index, double val,void**vetree){
+   chol_updown(vF, 1, &index, &val, 1, vetree);
 }
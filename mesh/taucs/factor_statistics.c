@@ -0,0 +1,117 @@
+#include <stdlib.h>
+#include "taucs.h"
+
+#define TAUCS_FACTORTYPE_NONE			0
+#define TAUCS_FACTORTYPE_LLT_SUPERNODAL		1
+#define TAUCS_FACTORTYPE_LLT_CCS		2
+
+typedef struct {
+  int  n;
+  int  flags;
+  int  type;
+  int* rowperm;
+  int* colperm;
+  void* L;
+} taucs_factorization;
+
+// symbolic analysis of the Cholesky factor of the symmetric (lower) matrix A
+// in the ordering perm/invperm (as returned by taucs_ccs_order).
+// computes the column counts of L from the elimination tree of PAP^T, without
+// any numerical work, and returns nnz(L), the factorization flops and the
+// largest column count (the order of the largest dense block).
+// returns 0 on success, -1 on failure
+int cholesky_analysis(taucs_ccs_matrix *A, int *perm, int *invperm,
+                      double *nnzL, double *flops, double *maxColCount){
+   taucs_ccs_matrix *PAP;
+   int *parent, *colcount, *rowcount;
+   int nnz, j;
+   int rc=-1;
+
+   PAP=taucs_ccs_permute_symmetrically(A, perm, invperm);
+   if(!PAP)
+      return -1;
+
+   parent=(int *)malloc((A->n+1)*sizeof(int));
+   colcount=(int *)malloc((A->n+1)*sizeof(int));
+   rowcount=(int *)malloc((A->n+1)*sizeof(int));
+   if(parent && colcount && rowcount &&
+      taucs_ccs_etree(PAP, parent, colcount, rowcount, &nnz)==0){
+      *nnzL=0;
+      *flops=0;
+      *maxColCount=0;
+      // summed in double, the int total of taucs_ccs_etree overflows first
+      for(j=0; j<A->n; j++){
+         *nnzL+=(double)colcount[j];
+         *flops+=(double)colcount[j]*(double)colcount[j];
+         if(colcount[j]>*maxColCount)
+            *maxColCount=colcount[j];
+      }
+      rc=0;
+   }
+
+   free(rowcount);
+   free(colcount);
+   free(parent);
+   taucs_ccs_free(PAP);
+   return rc;
+}
+
+// storage of a supernodal factor, as laid out by taucs_sn_llt.c
+typedef struct {
+  int     flags;
+  char    uplo;
+  int     n;
+  int     n_sn;
+
+  int*    parent;
+  int*    first_child;
+  int*    next_child;
+
+  int*    sn_size;
+  int*    sn_up_size;
+  int**   sn_struct;
+
+  int*    sn_blocks_ld;
+  taucs_double** sn_blocks;
+
+  int*    up_blocks_ld;
+  taucs_double** up_blocks;
+} supernodal_factor_matrix;
+
+// statistics of the factor vF computed by taucs_linsolve, measured on its storage:
+// a factor that was converted to ccs (by chol_update) by its column pointers, a
+// supernodal one by the sizes of its supernodes. every supernode keeps a dense
+// diagonal block (its lower triangle is part of L) and a dense block below it.
+// returns 0 on success, -1 if vF is not a Cholesky factor
+int factor_statistics(void *vF, double *nnzL, double *bytes){
+   taucs_factorization *F;
+   taucs_ccs_matrix *L;
+   supernodal_factor_matrix *S;
+   double size, below;
+   int sn;
+
+   F=(taucs_factorization*)vF;
+   if(!F)
+      return -1;
+
+   if(F->type==TAUCS_FACTORTYPE_LLT_CCS){
+      L=(taucs_ccs_matrix *)F->L;
+      *nnzL=(double)L->colptr[L->n];
+      *bytes=(*nnzL)*(sizeof(taucs_double)+sizeof(int))+(L->n+1)*sizeof(int);
+      return 0;
+   }
+   if(F->type==TAUCS_FACTORTYPE_LLT_SUPERNODAL){
+      S=(supernodal_factor_matrix *)F->L;
+      *nnzL=0;
+      *bytes=0;
+      for(sn=0; sn<S->n_sn; sn++){
+         size=(double)S->sn_size[sn];
+         below=(double)(S->sn_up_size[sn]-S->sn_size[sn]);
+         *nnzL+=size*(size+1)/2+below*size;
+         *bytes+=((double)S->sn_blocks_ld[sn]*size+(double)S->up_blocks_ld[sn]*size)*sizeof(taucs_double)
+                 +(double)S->sn_up_size[sn]*sizeof(int);
+      }
+      return 0;
+   }
+   return -1;
+}
@@ -4,6 +4,14 @@
 #include <algorithm>
 #include <vector>
 
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#include <emmintrin.h>
+#define TAUCS_ADDON_SSE2
+#endif
+
+// below this many rows the products are not worth spreading over threads
+#define TAUCS_ADDON_PARALLEL_ROWS 4096
+
 typedef std::map<std::pair<int,int>, taucsType> Pos2ValueMap;
 inline std::pair<int,int> GetPos(int i, int j);
 
@@ -290,6 +298,105 @@ void MulMatrixVector(const taucs_ccs_matrix *matA,
 }
 
 
+taucs_ccs_matrix * CreateRowCopy(const taucs_ccs_matrix *matA) {
+	const bool symmetric = (matA->flags & TAUCS_SYMMETRIC) != 0;
+
+	// count the entries of every row
+	std::vector<int> rowCount(matA->m + 1, 0);
+	for (int col = 0; col < matA->n; ++col) {
+		for (int p = matA->colptr[col]; p < matA->colptr[col+1]; ++p) {
+			if (!symmetric || matA->rowind[p] > col)
+				rowCount[matA->rowind[p] + 1]++;
+		}
+	}
+	for (int r = 0; r < matA->m; ++r)
+		rowCount[r+1] += rowCount[r];
+
+	taucs_ccs_matrix* ret = taucs_ccs_create(matA->n, matA->m, rowCount[matA->m], TAUCS_DOUBLE);
+	if (! ret)
+		return NULL;
+
+	memcpy(ret->colptr, &rowCount[0], sizeof(int) * (matA->m + 1));
+	// columns are visited in increasing order, so every row ends up sorted
+	for (int col = 0; col < matA->n; ++col) {
+		for (int p = matA->colptr[col]; p < matA->colptr[col+1]; ++p) {
+			const int row = matA->rowind[p];
+			if (!symmetric || row > col) {
+				ret->rowind[rowCount[row]] = col;
+				ret->taucs_values[rowCount[row]] = matA->taucs_values[p];
+				rowCount[row]++;
+			}
+		}
+	}
+
+	return ret;
+}
+
+// dot product of the sparse vector (ind, val) of length len with x
+static inline taucsType SparseDot(const int * ind, const taucsType * val, const int len, const taucsType * x) {
+	int p = 0;
+	taucsType sum = 0;
+#ifdef TAUCS_ADDON_SSE2
+	__m128d acc0 = _mm_setzero_pd();
+	__m128d acc1 = _mm_setzero_pd();
+	for (; p + 4 <= len; p += 4) {
+		acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(val + p), _mm_set_pd(x[ind[p+1]], x[ind[p]])));
+		acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(val + p + 2), _mm_set_pd(x[ind[p+3]], x[ind[p+2]])));
+	}
+	acc0 = _mm_add_pd(acc0, acc1);
+	acc0 = _mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0));
+	sum = _mm_cvtsd_f64(acc0);
+#endif
+	for (; p < len; ++p)
+		sum += val[p] * x[ind[p]];
+	return sum;
+}
+
+// b[col] (+)= dot(column col of mat, x) for every column, for numRhs vectors
+static void GatherColumns(const taucs_ccs_matrix *mat,
+						  const taucsType * x, const int ldx,
+						  taucsType * b, const int ldb,
+						  const int numRhs, const bool accumulate) {
+	const int n = mat->n;
+#pragma omp parallel for schedule(static) if (n > TAUCS_ADDON_PARALLEL_ROWS)
+	for (int col = 0; col < n; ++col) {
+		const int begin = mat->colptr[col];
+		const int len = mat->colptr[col+1] - begin;
+		const int * ind = mat->rowind + begin;
+		const taucsType * val = mat->taucs_values + begin;
+		for (int c = 0; c < numRhs; ++c) {
+			const taucsType dot = SparseDot(ind, val, len, x + c*ldx);
+			if (accumulate)
+				b[col + c*ldb] += dot;
+			else
+				b[col + c*ldb] = dot;
+		}
+	}
+}
+
+void MulMatrixVectors(const taucs_ccs_matrix *matA,
+					  const taucs_ccs_matrix *rowsA,
+					  const taucsType * x,
+					  taucsType * b,
+					  const int numRhs) {
+	if (matA->flags & TAUCS_SYMMETRIC) {
+		// the columns of the lower triangle are the rows of the upper one
+		// (diagonal included), the rest comes from the strictly lower rows
+		GatherColumns(matA, x, matA->n, b, matA->n, numRhs, false);
+		GatherColumns(rowsA, x, matA->n, b, matA->n, numRhs, true);
+	}
+	else {
+		GatherColumns(rowsA, x, matA->n, b, matA->m, numRhs, false);
+	}
+}
+
+void MulTransposeMatrixVectors(const taucs_ccs_matrix *matA,
+							   const taucsType * x,
+							   taucsType * b,
+							   const int numRhs) {
+	GatherColumns(matA, x, matA->m, b, matA->n, numRhs, false);
+}
+
 taucs_ccs_matrix * MatrixCopy(const taucs_ccs_matrix *mat) {
 	taucs_ccs_matrix* ret;
 	ret = taucs_ccs_create(mat->m, mat->n, mat->colptr[mat->n], mat->flags);
@@ -35,6 +35,23 @@ public:
 
 static std::vector<FactorEntry> factorArray;
 
+// memory budget given to new matrices
+static double	defaultMemoryBudget = 0;
+static int		defaultBudgetPolicy = SOLVER_BUDGET_REFUSE;
+
+// a negative budget means "most of the available memory"
+static double ResolveMemoryBudget(const double bytes) {
+	if (bytes >= 0)
+		return bytes;
+
+	double available = 0.75 * taucs_available_memory_size();
+	// the address space of a 32 bit process is the real limit there
+	const double maxAddressable = 1.5 * 1024.0 * 1024.0 * 1024.0;
+	if (sizeof(void *) == 4 && available > maxAddressable)
+		available = maxAddressable;
+	return available;
+}
+
 // has to be called in the beginning before starting to work with the library
 void InitTaucsInterface(bool enableLog) {
 	if (enableLog)
@@ -47,6 +64,7 @@ void InitTaucsInterface(bool enableLog) {
 // (so there is no need to fill in the lower triangle, but it is possible)
 int  CreateMatrix(const int numRows, const int numCols, const bool isSPD) {
 	SparseSolver * newMatObjectPtr = new SparseSolver(numRows, numCols, isSPD);
+	newMatObjectPtr->SetMemoryBudget(defaultMemoryBudget, defaultBudgetPolicy);
 
 	int id = 0;
 	for (int id = 0; id < (int)matrixArray.size(); id++) {
@@ -114,6 +132,26 @@ void AddAnchor(const int id, const int i, const taucsType w){
 	return matrixArray[id]->AddAnchor(i, w);
 }
 
+// adds count anchored vertices at once (indices[k] with weight weights[k], see AddAnchor)
+// if there was a factor, it is modified by one batched rank-count update
+// returns true on success, false otherwise
+bool AddAnchors(const int id, const int * indices, const taucsType * weights, const int count) {
+	if (id >= (int)matrixArray.size() || id < 0)
+		return false;
+
+	return matrixArray[id]->AddAnchors(indices, weights, count);
+}
+
+// removes count anchors previously added with the same indices and weights
+// if there was a factor, it is downdated in place
+// returns true on success, false otherwise
+bool RemoveAnchors(const int id, const int * indices, const taucsType * weights, const int count) {
+	if (id >= (int)matrixArray.size() || id < 0)
+		return false;
+
+	return matrixArray[id]->RemoveAnchors(indices, weights, count);
+}
+
 
 // Will create A^T A and its factorization, as well as store A^T
 // returns true on success, false otherwise
@@ -263,6 +301,24 @@ void ReleaseFactor(const int factorId) {
 	factorArray[factorId].Clear();
 }
 
+// precomputes the response operator and the Schur complement for the handles
+// returns true on success, false otherwise
+bool FactorHandles(const int id, const int * handles, const int count) {
+	if (id >= (int)matrixArray.size() || id < 0)
+		return false;
+
+	return matrixArray[id]->FactorHandles(handles, count);
+}
+
+// moves the handles of the solution x0 to the values u, result in x
+// returns true on success, false otherwise
+bool SolveHandles(const int id, const taucsType * x0, const taucsType * u, taucsType * x, const int numRhs) {
+	if (id >= (int)matrixArray.size() || id < 0)
+		return false;
+
+	return matrixArray[id]->SolveHandles(x0, u, x, numRhs);
+}
+
 // VectorAdd stores the result of v1 + v2 in result; assumes all the three vectors
 // have allocated size of length elements
 // result may be the same pointer as v1 or v2
@@ -386,3 +442,37 @@ bool SetSPD(const int id, const bool isSPD) {
 	matrixArray[id]->SetSPD(isSPD);
 	return true;
 }
+
+// sets the memory budget of the factorization of the matrix and the policy when it is exceeded
+bool SetMemoryBudget(const int id, const double bytes, const int policy) {
+	if (id >= (int)matrixArray.size() || id < 0)
+		return false;
+
+	matrixArray[id]->SetMemoryBudget(ResolveMemoryBudget(bytes), policy);
+	return true;
+}
+
+// the budget and policy given to matrices created from now on
+void SetDefaultMemoryBudget(const double bytes, const int policy) {
+	defaultMemoryBudget = ResolveMemoryBudget(bytes);
+	defaultBudgetPolicy = policy;
+}
+
+// fills stats with the symbolic analysis and the size of the present factor
+// returns true on success, false otherwise
+bool GetFactorStatistics(const int id, FactorStatistics & stats) {
+	if (id >= (int)matrixArray.size() || id < 0)
+		return false;
+
+	return matrixArray[id]->GetFactorStatistics(stats);
+}
+
+// factors the matrix out of core, into a scratch file in scratchDir
+// returns true on success, false otherwise
+bool SetOutOfCore(const int id, const bool enable, const char * scratchDir) {
+	if (id >= (int)matrixArray.size() || id < 0)
+		return false;
+
+	matrixArray[id]->SetOutOfCore(enable, scratchDir? scratchDir : "");
+	return true;
+}
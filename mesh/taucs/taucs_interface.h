@@ -30,6 +30,28 @@ void AddToMatrixEntry(const int id, const int i, const int j, const taucsType v)
 // explicitly states that the matrix is spd or not
 bool SetSPD(const int id, const bool isSPD);
 
+// Memory accounting and admission control
+// sets the memory budget (in bytes) of the factorization of the matrix, and the policy
+// (SolverBudgetPolicy) applied when the peak memory predicted by the symbolic analysis
+// exceeds it; 0 means unlimited, a negative value picks 3/4 of the available memory
+// (at most 1.5 GB in a 32 bit process). The check is done before any numerical work.
+bool SetMemoryBudget(const int id, const double bytes, const int policy);
+
+// the budget and policy given to matrices created from now on (default: unlimited)
+void SetDefaultMemoryBudget(const double bytes, const int policy);
+
+// fills stats with the predicted nnz(L), factor size, peak workspace and ordering
+// quality of the matrix to be factored (running the symbolic analysis if needed),
+// and with the size of the present factor, if there is one
+// returns true on success, false otherwise
+bool GetFactorStatistics(const int id, FactorStatistics & stats);
+
+// factors the matrix out of core (regardless of the memory budget) if enable is set:
+// the factor is streamed to a scratch file in scratchDir (NULL: the current directory),
+// removed when the factor is released. SOLVER_BUDGET_OUT_OF_CORE picks this mode
+// automatically when the budget is exceeded.
+bool SetOutOfCore(const int id, const bool enable, const char * scratchDir = NULL);
+
 // allows to add an anchored vertex without destroying the factor, if there was one
 // i is the anchor's number (i.e. the index of the mesh vertex that is anchored is i)
 // w is the weight of the anchor in the original Ax=b system. HAS TO BE POSITIVE!!
@@ -38,6 +60,17 @@ bool SetSPD(const int id, const bool isSPD);
 // a single solve.
 void AddAnchor(const int id, const int i, const taucsType w);
 
+// adds count anchored vertices at once (indices[k] with weight weights[k], see AddAnchor)
+// if there was a factor, it is modified by one batched rank-count update instead
+// of count separate rank-1 updates
+// returns true on success, false otherwise (the factor is then recomputed on the next solve)
+bool AddAnchors(const int id, const int * indices, const taucsType * weights, const int count);
+
+// removes count anchors previously added with the same indices and weights
+// if there was a factor, it is downdated in place
+// returns true on success, false otherwise
+bool RemoveAnchors(const int id, const int * indices, const taucsType * weights, const int count);
+
 
 // Will create A^T A and its factorization, as well as store A^T
 // returns true on success, false otherwise
@@ -117,6 +150,21 @@ bool SolveATA_UseFactor(const int matrixId, const int factorId, const taucsType
 // will free the factor
 void ReleaseFactor(const int factorId);
 
+// Handle solve: when only the values of a few unknowns (the handles) change between
+// solves, the new solution can be obtained from a previous one without a sparse solve.
+// FactorHandles precomputes the response operator (one solve per handle) and the
+// Cholesky factor of the k x k Schur complement; it needs about numCols*count values of memory.
+// returns true on success, false otherwise
+bool FactorHandles(const int id, const int * handles, const int count);
+
+// given x0, a solution returned by SolveATA (for any right-hand side), computes the
+// solution for the same right-hand side with the handles constrained to the values u:
+// a k x k dense solve and an n x k matrix-vector product per right-hand side.
+// u holds numRhs vectors of count values, in the order given to FactorHandles;
+// x may be the same pointer as x0
+// returns false if there is no handle data (it is discarded whenever the factor is)
+bool SolveHandles(const int id, const taucsType * x0, const taucsType * u, taucsType * x, const int numRhs);
+
 
 // Vector functions
 
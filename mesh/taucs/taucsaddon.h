@@ -19,6 +19,30 @@ extern "C" {
 
 typedef double taucsType;
 
+// what a matrix does when the predicted memory of its factorization exceeds its budget
+enum SolverBudgetPolicy {
+	SOLVER_BUDGET_REFUSE = 0,		// the factorization (and any solve) fails
+	SOLVER_BUDGET_ITERATIVE = 1,	// the system is solved by preconditioned conjugate gradients
+	SOLVER_BUDGET_OUT_OF_CORE = 2	// the factor is computed and kept in a scratch file
+};
+
+// memory accounting of the Cholesky factorization of a matrix
+// (of A^T A, or of A itself if it is SPD); sizes are in bytes
+struct FactorStatistics {
+	int		n;				// dimension of the factored matrix
+	double	nnzA;			// entries in the lower triangle of the factored matrix
+	double	predictedNnzL;	// nnz(L) predicted by the symbolic analysis
+	double	predictedBytes;	// predicted size of the factor
+	double	peakWorkspace;	// predicted peak memory of the numerical factorization,
+							// factor and permuted matrix included
+	double	fillRatio;		// ordering quality, predictedNnzL / nnzA (lower is better)
+	double	flops;			// predicted factorization work
+	double	actualNnzL;		// nnz(L) counted on the factor that exists, 0 if there is none
+	double	actualBytes;	// storage of that factor, 0 if there is none
+	bool	iterative;		// the budget was exceeded and the matrix is solved iteratively
+	bool	outOfCore;		// the factor is kept in a scratch file (not counted in actual*)
+};
+
 extern char * SIVANfactor[];
 extern void * SIVANopt_arg[];
 extern char * SIVANsolve [];
@@ -63,6 +87,31 @@ void MulMatrixVector(const taucs_ccs_matrix *matA,
 					 const taucsType * x,
 					 taucsType * b);
 
+// Creates the row-compressed copy of matA, stored as the ccs matrix of its transpose.
+// For a symmetric (lower) matA only the strictly lower triangle is copied, since
+// its upper triangle and diagonal can be read row-wise from matA itself.
+// Returns NULL on failure.
+taucs_ccs_matrix * CreateRowCopy(const taucs_ccs_matrix *matA);
+
+// Multiplies matA by the numRhs vectors stored one after the other in x and
+// stores the results the same way in b (b cannot be the same pointer as x).
+// rowsA has to be CreateRowCopy(matA). Every entry of b is a dot product
+// of one row, so rows are split between threads without write conflicts.
+void MulMatrixVectors(const taucs_ccs_matrix *matA,
+					  const taucs_ccs_matrix *rowsA,
+					  const taucsType * x,
+					  taucsType * b,
+					  const int numRhs);
+
+// Multiplies the transpose of matA by the numRhs vectors stored one after
+// the other in x and stores the results in b; assumes matA is not symmetric.
+// Same as MulNonSymmMatrixVector with the transposed matrix, but needs no
+// transposed copy and runs in parallel.
+void MulTransposeMatrixVectors(const taucs_ccs_matrix *matA,
+							   const taucsType * x,
+							   taucsType * b,
+							   const int numRhs);
+
 taucs_ccs_matrix * MatrixCopy(const taucs_ccs_matrix *mat);
 
 bool SolveNormalEquation(const taucs_ccs_matrix * A, const taucsType * b, taucsType * x);